@@ -20,8 +20,8 @@ static constexpr auto opts = args::Opts(
             .parameter_name("processors")
             .description("Number of processors to use [Note: when set to 0, "
                          "all available processors will be used. Only the analysis of multiple "
-                         "transcripts can be parallelized; if analyzing a single transcript, "
-                         "setting this parameter to a value > 1 will not speed up the execution]")
+                         "transcripts is parallelized; to speed up the analysis of a single "
+                         "transcript, see --permutationThreads]")
             .DEFAULT_VALUE(0),
         ARG(std::string, whitelist)
             .optional()
@@ -32,7 +32,36 @@ static constexpr auto opts = args::Opts(
             .description(
                 "Enables spectral analysis on all four bases (default is only A/C bases) "
                 "[Note: this feature is highly experimental]")
-            .DEFAULT_VALUE(false)),
+            .DEFAULT_VALUE(false),
+        ARG(bool, memory_mapped_input)
+            .parameter_name("mmap")
+            .description("Memory-maps the input MM file and reads the mutations "
+                         "in place, avoiding intermediate copies")
+            .DEFAULT_VALUE(false),
+        ARG(bool, collapse_duplicate_reads)
+            .parameter_name("collapseReads")
+            .description("Collapses identical reads into weighted rows while loading, "
+                         "reducing memory and time on highly redundant data "
+                         "(reported read assignments refer to the unique reads)")
+            .DEFAULT_VALUE(false),
+        ARG(std::string, covariance_kernel)
+            .parameter_name("covarianceKernel")
+            .description("Kernel used to count the co-mutations between bases: "
+                         "auto (sparse or bitset, depending on the density), "
+                         "sparse (pairwise intersections), bitset (popcount) "
+                         "or gemm (BLAS products over blocks of reads)")
+            .DEFAULT_VALUE("auto"),
+        ARG(bool, sliding_comutations)
+            .parameter_name("slidingComutations")
+            .description("Updates the co-mutations incrementally while sliding "
+                         "the windows, instead of counting them for each window "
+                         "with the covariance kernel")
+            .DEFAULT_VALUE(false),
+        ARG(unsigned, memory_budget)
+            .parameter_name("memoryBudget")
+            .description("Maximum memory (in MB) for the transcripts being loaded "
+                         "and analyzed at the same time (0 = half of the physical memory)")
+            .DEFAULT_VALUE(0u)),
 
     args::Group("Mutation filtering",
         ARG(unsigned, minimum_base_coverage)
@@ -70,6 +99,30 @@ static constexpr auto opts = args::Opts(
             .parameter_name("maxPermutations")
             .description("Maximum number of permutations performed to build the null model")
             .DEFAULT_VALUE(400),
+        ARG(unsigned, permutation_threads)
+            .parameter_name("permutationThreads")
+            .description("Number of permutations of a window generated and decomposed in "
+                         "parallel, in batches, while building the null model [Note: when "
+                         "set to 0, all available processors will be used]")
+            .DEFAULT_VALUE(1),
+        ARG(bool, sequential_test)
+            .parameter_name("sequentialTest")
+            .description("Stops the permutations as soon as the eigengaps being tested cannot "
+                         "reach the alpha value anymore (Besag-Clifford sequential Monte Carlo "
+                         "test), instead of waiting for the maximum number of permutations")
+            .DEFAULT_VALUE(false),
+        ARG(bool, null_model_library)
+            .parameter_name("nullModelLibrary")
+            .description("Shares the null models between windows with a similar number of bases, "
+                         "reads and mutation frequency (post-filtering): the permutations of the "
+                         "previous windows are reused, once confirmed by \"--nullModelConfirmations\" "
+                         "permutations of the window [Note: the results depend on the order in which "
+                         "the windows are analyzed]")
+            .DEFAULT_VALUE(false),
+        ARG(unsigned, null_model_confirmations)
+            .parameter_name("nullModelConfirmations")
+            .description("Permutations drawn by each window to confirm the null models of the library")
+            .DEFAULT_VALUE(8),
         ARG(double, first_eigengap_threshold)
             .parameter_name("firstEigengapThresh")
             .description("Threshold to consider the first eigengap [Note: when this threshold "
@@ -126,7 +179,14 @@ static constexpr auto opts = args::Opts(
         ARG(std::string, eigengaps_plots_root_dir)
             .parameter_name("eigengapDataOut")
             .description("Eigengap data output folder")
-            .DEFAULT_VALUE("./eigengap_data")),
+            .DEFAULT_VALUE("./eigengap_data"),
+        ARG(std::string, ptba_cache_dir)
+            .optional()
+            .parameter_name("ptbaCache")
+            .description("Folder caching the spectral analysis of each window, reused by later runs "
+                         "on the same reads with the same spectral deconvolution and filtering "
+                         "parameters [Note: only the Graph-Cut and windowed analysis parameters "
+                         "can change between these runs]")),
 
     args::Group(
         "Graph-Cut",
@@ -13,6 +13,9 @@ public:
   template <typename T, typename Out = BinaryStream&>
   std::enable_if_t<system_is_big_endian::value, Out> operator>>(T& t);
 
+  template <typename T>
+  BinaryStream& operator<<(T t);
+
 private:
   Stream* stream;
 };
@@ -2,6 +2,7 @@
 
 #include "binary_stream.hpp"
 
+#include <array>
 #include <iomanip>
 
 template <typename Stream>
@@ -23,3 +24,13 @@ BinaryStream<Stream>::operator>>(T& t) {
   swapBytes(t);
   return *this;
 }
+
+template <typename Stream>
+template <typename T>
+BinaryStream<Stream>&
+BinaryStream<Stream>::operator<<(T t) {
+  std::array<char, sizeof(T)> buffer;
+  storeLittleEndian(buffer.data(), t);
+  stream->write(buffer.data(), buffer.size());
+  return *this;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <memory>
+
+/* Value wrapper that shares the wrapped object between copies until one of
+ * them is accessed through a non-const path. Const accesses never copy, so
+ * a copy that is only read, or that is replaced as a whole, never pays for a
+ * deep copy.
+ *
+ * Pointers and references obtained through the non-const accessors are only
+ * valid as long as the wrapper is not copied: a copy shares the storage
+ * again, and writes through stale pointers would leak into the copy. */
+template <typename T>
+class CopyOnWrite {
+public:
+  using value_type = T;
+
+  CopyOnWrite() = default;
+  explicit CopyOnWrite(T value) noexcept(false);
+
+  CopyOnWrite& operator=(T value) noexcept(false);
+
+  const T& operator*() const noexcept;
+  const T* operator->() const noexcept;
+  T& operator*() noexcept(false);
+  T* operator->() noexcept(false);
+
+  /* True when the storage is shared with at least another copy. */
+  bool isShared() const noexcept;
+  /* Makes the storage unique, copying it when it is shared. */
+  void detach() noexcept(false);
+
+private:
+  // Null until something is stored, an empty T is used for reading
+  std::shared_ptr<T> value;
+};
+
+#include "copy_on_write_impl.hpp"
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "copy_on_write.hpp"
+
+#include <utility>
+
+template <typename T>
+CopyOnWrite<T>::CopyOnWrite(T value) noexcept(false)
+    : value(std::make_shared<T>(std::move(value))) {}
+
+template <typename T>
+auto
+CopyOnWrite<T>::operator=(T newValue) noexcept(false) -> CopyOnWrite& {
+  value = std::make_shared<T>(std::move(newValue));
+  return *this;
+}
+
+template <typename T>
+const T& CopyOnWrite<T>::operator*() const noexcept {
+  static T const empty{};
+  if (value)
+    return *value;
+  else
+    return empty;
+}
+
+template <typename T>
+const T* CopyOnWrite<T>::operator->() const noexcept {
+  return &**this;
+}
+
+template <typename T>
+T& CopyOnWrite<T>::operator*() noexcept(false) {
+  detach();
+  return *value;
+}
+
+template <typename T>
+T* CopyOnWrite<T>::operator->() noexcept(false) {
+  detach();
+  return value.get();
+}
+
+template <typename T>
+bool
+CopyOnWrite<T>::isShared() const noexcept {
+  return value.use_count() > 1;
+}
+
+template <typename T>
+void
+CopyOnWrite<T>::detach() noexcept(false) {
+  if (not value)
+    value = std::make_shared<T>();
+  else if (value.use_count() > 1)
+    value = std::make_shared<T>(std::as_const(*value));
+}
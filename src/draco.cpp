@@ -1,18 +1,25 @@
 #include "args.hpp"
+#include "eigen_solver.hpp"
 #include "graph_cut.hpp"
 #include "mutation_map.hpp"
-#include "parallel/blocking_queue.hpp"
+#include "parallel/memory_budget.hpp"
 #include "ptba.hpp"
+#include "ptba_cache.hpp"
 #include "results/analysis.hpp"
 #include "results/transcript.hpp"
 #include "results/window.hpp"
 #include "ringmap_data.hpp"
+#include "ringmap_sliding_comutations.hpp"
+#include "ringmap_window_view.hpp"
 #include "windows_merger.hpp"
 
 #include "range/v3/algorithm.hpp"
 #include "range/v3/view.hpp"
+#include <atomic>
 #include <charconv>
 #include <iostream>
+#include <limits>
+#include <optional>
 #include <set>
 #include <sstream>
 #include <thread>
@@ -20,6 +27,7 @@
 #include <armadillo>
 
 #include <omp.h>
+#include <unistd.h>
 
 #if __has_include(<filesystem>)
 #include <filesystem>
@@ -445,577 +453,697 @@ set_uninformative_clusters_to_surrounding(
       [](auto&&, auto&&) { return true; }, [](auto&&) { return true; });
 }
 
-int
-main(int argc, char* argv[]) {
-  auto const args = Args(argc, argv);
-
-  std::cout << "\n[+] Starting DRACO analysis. This might take a while...\n";
+/* Permutations drawn for the null models of all the windows, the ones saved
+ * by the sequential test and the ones taken from the null model library */
+struct PermutationsStats {
+  std::atomic<std::size_t> drawn{0};
+  std::atomic<std::size_t> saved{0};
+  std::atomic<std::size_t> fromLibrary{0};
+};
 
-  // Disabling OMP, we parallelize a higher level
-  omp_set_num_threads(1);
+void
+analyze_transcript(MutationMapTranscript const& transcript,
+                   RingmapData& ringmapData, results::Analysis& analysisResult,
+                   PermutationsStats& permutationsStats,
+                   PtbaCache const* ptbaCache,
+                   NullModelLibrary* nullModelLibrary,
+                   Args const& args) noexcept(false) {
+  if (ringmapData.data().rows_size() == 0) {
+    std::cout << "\x1b[2K\r[+] Skipping transcript " << transcript.getId()
+              << " (no reads)" << std::endl;
+    return;
+  }
+  std::cout << "\x1b[2K\r[+] Analyzing transcript " << transcript.getId()
+            << std::flush;
+
+  results::Transcript transcriptResult;
+  transcriptResult.name = transcript.getId();
+  transcriptResult.reads = transcript.getReadsSize();
+  transcriptResult.sequence = transcript.getSequence();
+  assert(not transcriptResult.name.empty());
+
+  auto const median_read_size = [&] {
+    auto reads_sizes = ringmapData.data().rows() |
+                       ranges::view::transform([](auto&& row) {
+                         assert(row.end_index() >= row.begin_index());
+                         return static_cast<std::uint64_t>(
+                             row.end_index() - row.begin_index());
+                       }) |
+                       ranges::to_vector;
+
+    auto median_iter =
+        ranges::next(ranges::begin(reads_sizes), reads_sizes.size() / 2);
+    ranges::nth_element(reads_sizes, median_iter);
+    return *median_iter;
+  }();
 
-  MutationMap mutationMap(args.mm_filename());
-  results::Analysis analysisResult(args.output_filename());
+  std::size_t transcript_size = ringmapData.data().cols_size();
+  const auto window_size = [&] {
+    auto&& window_size = args.window_size();
+    if (window_size <= 0) {
+      window_size = static_cast<unsigned>(static_cast<double>(median_read_size) *
+                                   args.window_size_fraction());
+    }
 
-  analysisResult.filename = args.mm_filename();
+    return std::min(window_size, static_cast<unsigned>(transcript_size));
+  }();
+  const auto window_offset = [&] {
+    auto&& window_shift = args.window_shift();
+    if (window_shift > 0) {
+      return window_shift;
+    } else {
+      return static_cast<unsigned>(static_cast<double>(window_size) *
+                                   args.window_shift_fraction());
+    }
+  }();
 
-  if (args.create_eigengaps_plots()) {
-    fs::create_directory(fs::path(args.eigengaps_plots_root_dir()));
+  assert(window_size <= transcript_size);
+
+  std::size_t n_windows =
+      (transcript_size - window_size) / window_offset + 1;
+  if (n_windows * window_offset + window_size < transcript_size)
+    ++n_windows;
+
+  assert(n_windows > 0);
+  std::vector<Window> windows(n_windows);
+  auto const window_precise_offset =
+      static_cast<double>(transcript_size - window_size) /
+      static_cast<double>(n_windows - 1);
+  for (std::size_t window_index = 0; window_index < n_windows;
+       ++window_index) {
+    auto start_base = static_cast<std::size_t>(std::round(
+        static_cast<double>(window_index) * window_precise_offset));
+    if (start_base + window_size > transcript_size)
+      start_base = transcript_size - window_size;
+
+    windows[window_index].start_base =
+        static_cast<unsigned short>(start_base);
   }
 
-  parallel::blocking_queue<std::pair<MutationMapTranscript, RingmapData>> queue(
-      10);
-  std::thread reader([&] {
-    RingmapData::enqueueRingmapsFromMutationMap(mutationMap, queue, args);
-  });
-  /*
-  std::thread reader([&] {
-    auto transcriptIter = std::next(std::begin(mutationMap), 13);
-    queue.emplace(*transcriptIter, RingmapData(*transcriptIter, args));
-    ++transcriptIter;
-    queue.emplace(*transcriptIter, RingmapData(*transcriptIter, args));
-    queue.finish();
-  });
-  */
+  // Both window loops only need the reads covering each window
+  RingmapMatrixIntervalIndex const reads_index(ringmapData.data());
 
-  const auto nWorkers = [&] {
-    auto n_processors = args.n_processors();
-    if (n_processors == 0)
-      n_processors = std::thread::hardware_concurrency() - 1u;
+  /* Consecutive windows overlap almost entirely: when requested, the
+   * co-mutations are updated while sliding */
+  std::optional<RingmapSlidingComutations> window_comutations;
+  if (args.sliding_comutations())
+    window_comutations.emplace(ringmapData.data(), window_size);
 
-    return static_cast<std::size_t>(std::max(n_processors, 1u));
-  }();
+  // The eigensolves of each window start from the ones of the previous window
+  eigen_solver::EigenSubspace eigen_subspace;
 
-  std::vector<std::thread> workers;
-  workers.reserve(nWorkers);
-  for (std::size_t workerIndex = 0; workerIndex < nWorkers; ++workerIndex) {
-    workers.emplace_back([&queue, &analysisResult, &args] {
-      for (;;) {
-        auto poppedData = queue.pop();
-        if (not poppedData)
-          break;
-        auto const& transcript = std::get<0>(*poppedData);
-        auto& ringmapData = std::get<1>(*poppedData);
-        if (ringmapData.data().rows_size() == 0) {
-          std::cout << "\x1b[2K\r[+] Skipping transcript " << transcript.getId()
-                    << " (no reads)" << std::endl;
-          continue;
+  std::vector<unsigned> windows_n_clusters(windows.size());
+  {
+    auto windows_iter = std::cbegin(windows);
+    auto const windows_end = std::cend(windows);
+    auto&& windows_n_clusters_iter = std::begin(windows_n_clusters);
+
+    for (; windows_iter < windows_end;
+         ++windows_iter, ++windows_n_clusters_iter) {
+      auto&& window = *windows_iter;
+      auto&& window_n_clusters = *windows_n_clusters_iter;
+
+      RingmapWindowView const window_view(ringmapData, window.start_base,
+                                          window.start_base + window_size,
+                                          reads_index);
+      auto const result = [&] {
+        if (ptbaCache) {
+          if (auto cached = ptbaCache->load(window_view))
+            return std::move(*cached);
         }
-        std::cout << "\x1b[2K\r[+] Analyzing transcript " << transcript.getId()
-                  << std::flush;
-
-        results::Transcript transcriptResult;
-        transcriptResult.name = transcript.getId();
-        transcriptResult.reads = transcript.getReadsSize();
-        transcriptResult.sequence = transcript.getSequence();
-        assert(not transcriptResult.name.empty());
-
-        auto const median_read_size = [&] {
-          auto reads_sizes = ringmapData.data().rows() |
-                             ranges::view::transform([](auto&& row) {
-                               assert(row.end_index() >= row.begin_index());
-                               return static_cast<std::uint64_t>(
-                                   row.end_index() - row.begin_index());
-                             }) |
-                             ranges::to_vector;
-
-          auto median_iter =
-              ranges::next(ranges::begin(reads_sizes), reads_sizes.size() / 2);
-          ranges::nth_element(reads_sizes, median_iter);
-          return *median_iter;
-        }();
 
-        std::size_t transcript_size = ringmapData.data().cols_size();
-        const auto window_size = [&] {
-          auto&& window_size = args.window_size();
-          if (window_size <= 0) {
-            window_size = static_cast<unsigned>(static_cast<double>(median_read_size) *
-                                         args.window_size_fraction());
-          }
+        Ptba ptba(window_view, args);
+        ptba.setEigenSubspace(&eigen_subspace);
+        ptba.setNullModelLibrary(nullModelLibrary);
+        if (window_comutations) {
+          window_comutations->slideTo(window.start_base);
+          ptba.setWindowComutations(&*window_comutations);
+        }
 
-          return std::min(window_size, static_cast<unsigned>(transcript_size));
+        auto result = ptba.result_from_run();
+        if (ptbaCache)
+          ptbaCache->store(window_view, result);
+        return result;
+      }();
+      window_n_clusters = result.significantIndices.size();
+      permutationsStats.drawn += result.permutations;
+      permutationsStats.saved += result.savedPermutations;
+      permutationsStats.fromLibrary += result.libraryPermutations;
+
+      if (args.create_eigengaps_plots()) {
+        auto const [eigengaps_filename,
+                    perturbed_eigengaps_filename] = [&] {
+          std::array<std::string, 2> filenames;
+          auto const start_base = window.start_base + 1;
+          auto const end_base = window.start_base + window_size;
+          std::stringstream buf;
+          buf << "window_" << start_base << '-' << end_base
+              << "_eigengaps.txt";
+          filenames[0] = buf.str();
+
+          buf.str("");
+          buf << "window_" << start_base << '-' << end_base
+              << "_perturbed_eigengaps.txt";
+          filenames[1] = buf.str();
+
+          return filenames;
         }();
-        const auto window_offset = [&] {
-          auto&& window_shift = args.window_shift();
-          if (window_shift > 0) {
-            return window_shift;
+
+        auto const result_dir =
+            fs::path(args.eigengaps_plots_root_dir()) /
+            transcriptResult.name;
+        fs::create_directory(result_dir);
+        Ptba::dumpEigenGaps(result.eigenGaps,
+                            (result_dir / eigengaps_filename).c_str());
+        Ptba::dumpPerturbedEigenGaps(
+            result.perturbedEigenGaps,
+            (result_dir / perturbed_eigengaps_filename).c_str());
+      }
+    }
+  }
+
+  auto const pre_collapsing_clusters = std::move(windows_n_clusters);
+  windows_n_clusters.clear();
+  std::vector<std::optional<unsigned>> windows_max_clusters_constraints(
+      windows.size(), std::nullopt);
+
+  for (bool stop = false; not stop;) {
+    stop = true;
+    transcriptResult.windows = std::nullopt;
+
+    windows_n_clusters = pre_collapsing_clusters;
+    ranges::for_each(ranges::view::zip(windows_n_clusters,
+                                       windows_max_clusters_constraints),
+                     [](auto&& data) {
+                       auto&& [window_n_clusters, constraint] = data;
+                       if (constraint) {
+                         window_n_clusters =
+                             std::min(window_n_clusters, *constraint);
+                       }
+                     });
+
+    if (args.set_uninformative_clusters_to_surrounding()) {
+      set_uninformative_clusters_to_surrounding(
+          windows, windows_n_clusters, windows_max_clusters_constraints);
+
+      constexpr auto const zero_clusters = [](auto n_clusters) {
+        return n_clusters == 0;
+      };
+      assert(ranges::none_of(windows_n_clusters, zero_clusters) or
+             ranges::all_of(windows_n_clusters, zero_clusters));
+    }
+
+    if (args.max_collapsing_windows() > 0)
+      collapse_outlayer_clusters(windows, windows_n_clusters,
+                                 windows_max_clusters_constraints, args);
+
+    if (args.set_all_uninformative_to_one()) {
+      if (ranges::all_of(windows_n_clusters, [](auto n_clusters) {
+            return n_clusters == 0;
+          })) {
+        ranges::fill(windows_n_clusters, 1u);
+      }
+    }
+
+    std::vector<std::vector<unsigned>> windows_reads_indices;
+    windows_reads_indices.reserve(windows.size());
+
+    {
+      auto windows_iter = std::begin(windows);
+      auto const windows_end = std::end(windows);
+      auto windows_n_clusters_iter = std::cbegin(windows_n_clusters);
+
+      for (; windows_iter < windows_end;
+           ++windows_iter, ++windows_n_clusters_iter) {
+
+        auto&& window = *windows_iter;
+        auto n_clusters = *windows_n_clusters_iter;
+
+        // Only the filtered covariance is needed, the reads are not copied
+        RingmapWindowView window_view(ringmapData, window.start_base,
+                                      window.start_base + window_size,
+                                      reads_index);
+        auto const& window_reads_indices = window_view.getReadsIndices();
+
+        assert(std::is_sorted(std::begin(window_reads_indices),
+                              std::end(window_reads_indices)));
+        assert(std::adjacent_find(std::begin(window_reads_indices),
+                                  std::end(window_reads_indices)) ==
+               std::end(window_reads_indices));
+        window.coverages = window_view.getBaseCoverages();
+        windows_reads_indices.emplace_back(window_reads_indices);
+
+        window_view.filterBases();
+        window_view.filterReads();
+        window_view.filterBases();
+
+        typename RingmapData::clusters_pattern_type patterns;
+        for (;;) {
+          if (n_clusters > 1 and window_view.filteredRowsSize() > 0) {
+            arma::mat covariance;
+            if (window_comutations) {
+              window_comutations->slideTo(window.start_base);
+              covariance = window_comutations->covariance(window_view);
+            } else
+              covariance = window_view.covariance();
+            GraphCut graphCut(covariance);
+
+            auto graphCutResults = graphCut.run(n_clusters);
+            auto clusters =
+                window_view.getUnfilteredWeights(std::move(graphCutResults));
+
+            assert(clusters.getElementsSize() == window_size);
+            window.weights = std::move(clusters);
+            break;
           } else {
-            return static_cast<unsigned>(static_cast<double>(window_size) *
-                                         args.window_shift_fraction());
+            window.weights = WeightedClusters(window_size, n_clusters);
+            break;
           }
-        }();
-
-        assert(window_size <= transcript_size);
-
-        std::size_t n_windows =
-            (transcript_size - window_size) / window_offset + 1;
-        if (n_windows * window_offset + window_size < transcript_size)
-          ++n_windows;
-
-        assert(n_windows > 0);
-        std::vector<Window> windows(n_windows);
-        auto const window_precise_offset =
-            static_cast<double>(transcript_size - window_size) /
-            static_cast<double>(n_windows - 1);
-        for (std::size_t window_index = 0; window_index < n_windows;
-             ++window_index) {
-          auto start_base = static_cast<std::size_t>(std::round(
-              static_cast<double>(window_index) * window_precise_offset));
-          if (start_base + window_size > transcript_size)
-            start_base = transcript_size - window_size;
-
-          windows[window_index].start_base =
-              static_cast<unsigned short>(start_base);
         }
+      }
+    }
 
-        std::vector<unsigned> windows_n_clusters(windows.size());
-        {
-          auto windows_iter = std::cbegin(windows);
-          auto const windows_end = std::cend(windows);
-          auto&& windows_n_clusters_iter = std::begin(windows_n_clusters);
-
-          for (; windows_iter < windows_end;
-               ++windows_iter, ++windows_n_clusters_iter) {
-            auto&& window = *windows_iter;
-            auto&& window_n_clusters = *windows_n_clusters_iter;
-
-            auto window_ringmap_data = ringmapData.get_new_range(
-                window.start_base, window.start_base + window_size);
-            Ptba ptba(window_ringmap_data, args);
-
-            if (args.create_eigengaps_plots()) {
-              auto const result = ptba.result_from_run();
-
-              window_n_clusters = result.significantIndices.size();
-              auto const [eigengaps_filename,
-                          perturbed_eigengaps_filename] = [&] {
-                std::array<std::string, 2> filenames;
-                auto const start_base = window.start_base + 1;
-                auto const end_base = window.start_base + window_size;
-                std::stringstream buf;
-                buf << "window_" << start_base << '-' << end_base
-                    << "_eigengaps.txt";
-                filenames[0] = buf.str();
-
-                buf.str("");
-                buf << "window_" << start_base << '-' << end_base
-                    << "_perturbed_eigengaps.txt";
-                filenames[1] = buf.str();
-
-                return filenames;
-              }();
-
-              auto const result_dir =
-                  fs::path(args.eigengaps_plots_root_dir()) /
-                  transcriptResult.name;
-              fs::create_directory(result_dir);
-              Ptba::dumpEigenGaps(result.eigenGaps,
-                                  (result_dir / eigengaps_filename).c_str());
-              Ptba::dumpPerturbedEigenGaps(
-                  result.perturbedEigenGaps,
-                  (result_dir / perturbed_eigengaps_filename).c_str());
-            } else {
-              window_n_clusters = ptba.run();
+    {
+      auto window_iter = std::begin(windows);
+      auto window_reads_indices_iter = std::begin(windows_reads_indices);
+      // std::ofstream merge_stream("merge.txt");
+      while (window_iter != std::end(windows)) {
+        unsigned const n_clusters =
+            window_iter->weights.getClustersSize();
+        auto last_window = std::find_if(
+            std::next(window_iter), std::end(windows),
+            [n_clusters](auto&& window) {
+              return window.weights.getClustersSize() != n_clusters;
+            });
+
+        auto const last_window_reads_indices =
+            std::next(window_reads_indices_iter,
+                      std::distance(window_iter, last_window));
+
+        auto const get_window_coverages = [&window_reads_indices_iter,
+                                           &last_window_reads_indices,
+                                           &ringmapData](
+                                              std::size_t begin_index,
+                                              std::size_t end_index) {
+          auto const window_size = end_index - begin_index;
+          std::vector<unsigned> coverages(window_size, 0u);
+          {
+            std::set<std::size_t> reads_indices;
+            std::for_each(window_reads_indices_iter,
+                          last_window_reads_indices,
+                          [&](auto const& indices) {
+                            reads_indices.insert(std::begin(indices),
+                                                 std::end(indices));
+                          });
+
+            auto&& data = ringmapData.data();
+            assert(std::all_of(
+                std::begin(reads_indices), std::end(reads_indices),
+                [nrows = data.rows_size()](auto const read_index) {
+                  return read_index < nrows;
+                }));
+
+            for (auto&& read_index : reads_indices) {
+              auto&& row = data.row(read_index);
+              auto const row_begin = std::max(
+                  row.begin_index(), static_cast<unsigned>(begin_index));
+              auto const row_end = std::min(
+                  row.end_index(), static_cast<unsigned>(end_index));
+              auto const row_size = static_cast<unsigned>(std::max(
+                  static_cast<int>(row_end) - static_cast<int>(row_begin),
+                  0));
+
+              ranges::for_each(
+                  coverages |
+                      ranges::view::drop(row_begin - begin_index) |
+                      ranges::view::take(row_size),
+                  [multiplicity = row.multiplicity()](auto&& coverage) {
+                    coverage += multiplicity;
+                  });
             }
           }
-        }
-
-        auto const pre_collapsing_clusters = std::move(windows_n_clusters);
-        windows_n_clusters.clear();
-        std::vector<std::optional<unsigned>> windows_max_clusters_constraints(
-            windows.size(), std::nullopt);
-
-        for (bool stop = false; not stop;) {
-          stop = true;
-          transcriptResult.windows = std::nullopt;
-
-          windows_n_clusters = pre_collapsing_clusters;
-          ranges::for_each(ranges::view::zip(windows_n_clusters,
-                                             windows_max_clusters_constraints),
-                           [](auto&& data) {
-                             auto&& [window_n_clusters, constraint] = data;
-                             if (constraint) {
-                               window_n_clusters =
-                                   std::min(window_n_clusters, *constraint);
-                             }
-                           });
-
-          if (args.set_uninformative_clusters_to_surrounding()) {
-            set_uninformative_clusters_to_surrounding(
-                windows, windows_n_clusters, windows_max_clusters_constraints);
-
-            constexpr auto const zero_clusters = [](auto n_clusters) {
-              return n_clusters == 0;
+          return coverages;
+        };
+
+        auto const add_result_window =
+            [&transcriptResult](results::Window&& result_window) {
+              if (transcriptResult.windows)
+                transcriptResult.windows->emplace_back(
+                    std::move(result_window));
+              else
+                transcriptResult.windows.emplace(
+                    {std::move(result_window)});
             };
-            assert(ranges::none_of(windows_n_clusters, zero_clusters) or
-                   ranges::all_of(windows_n_clusters, zero_clusters));
-          }
 
-          if (args.max_collapsing_windows() > 0)
-            collapse_outlayer_clusters(windows, windows_n_clusters,
-                                       windows_max_clusters_constraints, args);
+        if (n_clusters == 0) {
+          if (args.report_uninformative()) {
+            std::for_each(window_iter, last_window, [&](auto&& window) {
+              auto const coverages = get_window_coverages(
+                  window.start_base,
+                  window.start_base + window.coverages.size());
+              auto result_window = results::Window(
+                  window.start_base, window.weights, coverages);
 
-          if (args.set_all_uninformative_to_one()) {
-            if (ranges::all_of(windows_n_clusters, [](auto n_clusters) {
-                  return n_clusters == 0;
-                })) {
-              ranges::fill(windows_n_clusters, 1u);
-            }
+              add_result_window(std::move(result_window));
+            });
           }
 
-          std::vector<std::vector<unsigned>> windows_reads_indices;
-          windows_reads_indices.reserve(windows.size());
+          window_iter = last_window;
+          window_reads_indices_iter = last_window_reads_indices;
+          continue;
+        }
 
-          {
-            auto windows_iter = std::begin(windows);
-            auto const windows_end = std::end(windows);
-            auto windows_n_clusters_iter = std::cbegin(windows_n_clusters);
-
-            for (; windows_iter < windows_end;
-                 ++windows_iter, ++windows_n_clusters_iter) {
-
-              auto&& window = *windows_iter;
-              auto n_clusters = *windows_n_clusters_iter;
-
-              std::vector<unsigned> window_reads_indices;
-              auto window_ringmap_data = ringmapData.get_new_range(
-                  window.start_base, window.start_base + window_size,
-                  &window_reads_indices);
-
-              assert(window_reads_indices.size() ==
-                     window_ringmap_data.data().rows_size());
-              assert(std::is_sorted(std::begin(window_reads_indices),
-                                    std::end(window_reads_indices)));
-              assert(std::unique(std::begin(window_reads_indices),
-                                 std::end(window_reads_indices)) ==
-                     std::end(window_reads_indices));
-              window.coverages = window_ringmap_data.getBaseCoverages();
-
-              assert(window_reads_indices.size() ==
-                     window_ringmap_data.data().rows_size());
-              windows_reads_indices.emplace_back(
-                  std::move(window_reads_indices));
-
-              auto filtered_data = window_ringmap_data;
-              filtered_data.filterBases();
-              filtered_data.filterReads();
-              filtered_data.filterBases();
-
-              typename RingmapData::clusters_pattern_type patterns;
-              for (;;) {
-                if (n_clusters > 1 and filtered_data.data().rows_size() > 0) {
-                  auto covariance = filtered_data.data().covariance(
-                      filtered_data.getBaseWeights());
-                  GraphCut graphCut(covariance);
-
-                  auto graphCutResults = graphCut.run(n_clusters);
-                  auto clusters = filtered_data.getUnfilteredWeights(
-                      std::move(graphCutResults));
-
-                  assert(clusters.getElementsSize() == window_size);
-                  window.weights = std::move(clusters);
-                  break;
-                } else {
-                  window.weights = WeightedClusters(window_size, n_clusters);
-                  break;
-                }
-              }
+        windows_merger::WindowsMerger windows_merger(n_clusters);
+        std::for_each(window_iter, last_window, [&](auto&& window) {
+          windows_merger.add_window(window.start_base, window.weights,
+                                    window.coverages);
+        });
+
+        auto const merged_window = windows_merger.merge();
+        auto const coverages = get_window_coverages(
+            merged_window.begin_index(), merged_window.end_index());
+        auto result_window = results::Window(merged_window, coverages);
+        add_result_window(std::move(result_window));
+
+        window_iter = last_window;
+        window_reads_indices_iter = last_window_reads_indices;
+      }
+    }
+
+    if (transcriptResult.windows) {
+      auto& result_windows = *transcriptResult.windows;
+      auto splitted_ringmaps =
+          RingmapData(ringmapData).split_into_windows(result_windows);
+
+      assert(splitted_ringmaps.size() == result_windows.size());
+
+      auto windows_iter = std::begin(result_windows);
+      auto const windows_end = std::end(result_windows);
+      auto splitted_ringmaps_iter = std::begin(splitted_ringmaps);
+      for (; windows_iter < windows_end;
+           ++windows_iter, ++splitted_ringmaps_iter) {
+        auto& window = *windows_iter;
+        if (window.weighted_clusters.getClustersSize() == 0) {
+          continue;
+        }
+
+        auto& ringmap = *splitted_ringmaps_iter;
+
+        window.assignments.resize(ringmap.data().rows_size());
+        ranges::fill(window.assignments, std::int8_t(-1));
+
+        auto filteredRingmap = ringmap;
+        filteredRingmap.filterBases();
+        filteredRingmap.filterReads();
+        filteredRingmap.filterBases();
+
+        auto&& fractions_result = filteredRingmap.fractionReadsByWeights(
+            window.weighted_clusters);
+        std::tie(window.fractions, window.patterns, std::ignore) =
+            std::move(fractions_result);
+        assert(window.fractions.size() > 1 or window.fractions.empty() or
+               window.fractions[0] >= 0.01);
+
+        bool const redundandPatterns = [&] {
+          auto patterns_iter = std::cbegin(*window.patterns);
+          auto const patterns_end = std::cend(*window.patterns);
+
+          for (; patterns_iter < patterns_end; ++patterns_iter) {
+            auto&& cur_pattern = *patterns_iter;
+            auto const begin_cur_pattern = std::cbegin(cur_pattern);
+            auto const end_cur_pattern = std::cend(cur_pattern);
+
+            if (std::any_of(std::next(patterns_iter), patterns_end,
+                            [&](auto&& next_pattern) {
+                              return std::equal(begin_cur_pattern,
+                                                end_cur_pattern,
+                                                std::cbegin(next_pattern),
+                                                std::cend(next_pattern));
+                            })) {
+              return true;
             }
           }
 
-          {
-            auto window_iter = std::begin(windows);
-            auto window_reads_indices_iter = std::begin(windows_reads_indices);
-            // std::ofstream merge_stream("merge.txt");
-            while (window_iter != std::end(windows)) {
-              unsigned const n_clusters =
-                  window_iter->weights.getClustersSize();
-              auto last_window = std::find_if(
-                  std::next(window_iter), std::end(windows),
-                  [n_clusters](auto&& window) {
-                    return window.weights.getClustersSize() != n_clusters;
-                  });
+          return false;
+        }();
 
-              auto const last_window_reads_indices =
-                  std::next(window_reads_indices_iter,
-                            std::distance(window_iter, last_window));
-
-              auto const get_window_coverages = [&window_reads_indices_iter,
-                                                 &last_window_reads_indices,
-                                                 &ringmapData](
-                                                    std::size_t begin_index,
-                                                    std::size_t end_index) {
-                auto const window_size = end_index - begin_index;
-                std::vector<unsigned> coverages(window_size, 0u);
-                {
-                  std::set<std::size_t> reads_indices;
-                  std::for_each(window_reads_indices_iter,
-                                last_window_reads_indices,
-                                [&](auto const& indices) {
-                                  reads_indices.insert(std::begin(indices),
-                                                       std::end(indices));
-                                });
-
-                  auto&& data = ringmapData.data();
-                  assert(std::all_of(
-                      std::begin(reads_indices), std::end(reads_indices),
-                      [nrows = data.rows_size()](auto const read_index) {
-                        return read_index < nrows;
-                      }));
-
-                  for (auto&& read_index : reads_indices) {
-                    auto&& row = data.row(read_index);
-                    auto const row_begin = std::max(
-                        row.begin_index(), static_cast<unsigned>(begin_index));
-                    auto const row_end = std::min(
-                        row.end_index(), static_cast<unsigned>(end_index));
-                    auto const row_size = static_cast<unsigned>(std::max(
-                        static_cast<int>(row_end) - static_cast<int>(row_begin),
-                        0));
-
-                    ranges::for_each(
-                        coverages |
-                            ranges::view::drop(row_begin - begin_index) |
-                            ranges::view::take(row_size),
-                        [](auto&& coverage) { ++coverage; });
-                  }
-                }
-                return coverages;
-              };
-
-              auto const add_result_window =
-                  [&transcriptResult](results::Window&& result_window) {
-                    if (transcriptResult.windows)
-                      transcriptResult.windows->emplace_back(
-                          std::move(result_window));
-                    else
-                      transcriptResult.windows.emplace(
-                          {std::move(result_window)});
-                  };
-
-              if (n_clusters == 0) {
-                if (args.report_uninformative()) {
-                  std::for_each(window_iter, last_window, [&](auto&& window) {
-                    auto const coverages = get_window_coverages(
-                        window.start_base,
-                        window.start_base + window.coverages.size());
-                    auto result_window = results::Window(
-                        window.start_base, window.weights, coverages);
-
-                    add_result_window(std::move(result_window));
-                  });
+        if (redundandPatterns or
+            ranges::any_of(
+                window.fractions,
+                [min_cluster_fraction =
+                     args.minimum_cluster_fraction()](auto&& fraction) {
+                  return fraction < min_cluster_fraction;
+                })) {
+          stop = false;
+          auto const result_window_begin = window.begin_index;
+          auto const result_window_end = window.end_index;
+          assert(window.fractions.size() > 1);
+          auto const new_clusters_constraint =
+              static_cast<unsigned>(window.fractions.size() - 1);
+
+          ranges::for_each(
+              ranges::view::zip(windows,
+                                windows_max_clusters_constraints),
+              [&](auto&& data) {
+                auto&& [window, window_constraint] = data;
+                if (window.start_base >= result_window_begin and
+                    window.start_base + window_size <=
+                        result_window_end) {
+
+                  window_constraint = new_clusters_constraint;
                 }
+              });
+        }
 
-                window_iter = last_window;
-                window_reads_indices_iter = last_window_reads_indices;
-                continue;
-              }
+        if (not stop)
+          continue;
 
-              windows_merger::WindowsMerger windows_merger(n_clusters);
-              std::for_each(window_iter, last_window, [&](auto&& window) {
-                windows_merger.add_window(window.start_base, window.weights,
-                                          window.coverages);
-              });
+        *window.patterns =
+            filteredRingmap.remapPatterns(*window.patterns);
 
-              auto const merged_window = windows_merger.merge();
-              auto const coverages = get_window_coverages(
-                  merged_window.begin_index(), merged_window.end_index());
-              auto result_window = results::Window(merged_window, coverages);
-              add_result_window(std::move(result_window));
+        {
+          std::vector assignments(std::move_iterator(std::begin(
+                                      std::get<2>(fractions_result))),
+                                  std::move_iterator(std::end(
+                                      std::get<2>(fractions_result))));
+          assert(ranges::is_sorted(
+              assignments, {},
+              [](auto&& pair) -> decltype(auto) { return pair.first; }));
+
+          if (not window.bases_coverages) {
+            window.bases_coverages = std::vector<std::vector<unsigned>>{};
+          }
+          auto& bases_coverages = *window.bases_coverages;
+          bases_coverages.resize(
+              window.weighted_clusters.getClustersSize(),
+              std::vector<unsigned>(window.end_index - window.begin_index,
+                                    0));
+
+          auto&& original_data = std::as_const(ringmap).data();
+          auto&& rows = std::as_const(filteredRingmap).data().rows();
+          auto&& rows_iter = ranges::cbegin(rows);
+          auto const rows_end = ranges::cend(rows);
+          auto&& original_indices_iter =
+              ranges::begin(filteredRingmap.getReadsMap());
+          for (; rows_iter < rows_end;
+               ++rows_iter, ++original_indices_iter) {
+            auto const original_index = *original_indices_iter;
+            auto&& row = *rows_iter;
+
+            auto assignment_iter_range = ranges::equal_range(
+                assignments, row,
+                [](auto&& a, auto&& b) { return a < b; },
+                [](auto&& pair) -> decltype(auto) { return pair.first; });
+            assert(assignment_iter_range.begin() !=
+                   ranges::end(assignments));
+            assert(assignment_iter_range.end() ==
+                   ranges::next(assignment_iter_range.begin()));
+
+            auto&& clusters_assignments =
+                assignment_iter_range.begin()->second;
+            auto const first_usable_cluster_iter =
+                ranges::find_if(clusters_assignments,
+                                [](auto count) { return count != 0; });
+            if (first_usable_cluster_iter ==
+                ranges::end(clusters_assignments))
+              continue;
+
+            window.assignments[original_index] =
+                ranges::distance(ranges::begin(clusters_assignments),
+                                 first_usable_cluster_iter);
+
+            auto&& original_row = original_data.row(original_index);
+            auto const begin_index =
+                std::max(original_row.begin_index(),
+                         static_cast<unsigned>(window.begin_index));
+            auto const end_index =
+                std::min(original_row.end_index(),
+                         static_cast<unsigned>(window.end_index));
+
+            /* The copies of a collapsed read can be split between the
+             * clusters, each one only covers the bases for its share */
+            auto remaining = row.multiplicity();
+            for (auto cluster_iter = first_usable_cluster_iter;
+                 remaining > 0 and
+                 cluster_iter != ranges::end(clusters_assignments);
+                 ++cluster_iter) {
+              if (*cluster_iter == 0)
+                continue;
 
-              window_iter = last_window;
-              window_reads_indices_iter = last_window_reads_indices;
+              auto const take = static_cast<unsigned>(
+                  std::min<std::size_t>(remaining, *cluster_iter));
+              *cluster_iter -= take;
+              remaining -= take;
+
+              auto const assignment = static_cast<std::size_t>(
+                  ranges::distance(ranges::begin(clusters_assignments),
+                                   cluster_iter));
+              assert(assignment < bases_coverages.size());
+              auto&& cluster_bases_coverages = bases_coverages[assignment];
+              assert(cluster_bases_coverages.size() >=
+                     end_index - begin_index);
+              ranges::for_each(cluster_bases_coverages |
+                                   ranges::view::slice(
+                                       begin_index - window.begin_index,
+                                       end_index - window.begin_index),
+                               [take](auto&& coverage) { coverage += take; });
             }
           }
+        }
 
-          if (transcriptResult.windows) {
-            auto& result_windows = *transcriptResult.windows;
-            auto splitted_ringmaps =
-                RingmapData(ringmapData).split_into_windows(result_windows);
+        if (std::all_of(std::cbegin(*window.patterns),
+                        std::cend(*window.patterns), [](auto&& pattern) {
+                          return std::all_of(
+                              std::cbegin(pattern), std::cend(pattern),
+                              [](auto&& value) { return value == 0; });
+                        })) {
+          window.patterns = std::nullopt;
+          window.bases_coverages = std::nullopt;
+        }
+      }
+    }
+  }
 
-            assert(splitted_ringmaps.size() == result_windows.size());
+  analysisResult.addTranscript(std::move(transcriptResult));
+}
 
-            auto windows_iter = std::begin(result_windows);
-            auto const windows_end = std::end(result_windows);
-            auto splitted_ringmaps_iter = std::begin(splitted_ringmaps);
-            for (; windows_iter < windows_end;
-                 ++windows_iter, ++splitted_ringmaps_iter) {
-              auto& window = *windows_iter;
-              if (window.weighted_clusters.getClustersSize() == 0) {
-                continue;
-              }
+static std::size_t
+get_memory_budget(Args const& args) {
+  if (auto const budget = args.memory_budget(); budget != 0)
+    return static_cast<std::size_t>(budget) * 1024 * 1024;
 
-              auto& ringmap = *splitted_ringmaps_iter;
-
-              window.assignments.resize(ringmap.data().rows_size());
-              ranges::fill(window.assignments, std::int8_t(-1));
-
-              auto filteredRingmap = ringmap;
-              filteredRingmap.filterBases();
-              filteredRingmap.filterReads();
-              filteredRingmap.filterBases();
-
-              auto&& fractions_result = filteredRingmap.fractionReadsByWeights(
-                  window.weighted_clusters);
-              std::tie(window.fractions, window.patterns, std::ignore) =
-                  std::move(fractions_result);
-              assert(window.fractions.size() > 1 or window.fractions.empty() or
-                     window.fractions[0] >= 0.01);
-
-              bool const redundandPatterns = [&] {
-                auto patterns_iter = std::cbegin(*window.patterns);
-                auto const patterns_end = std::cend(*window.patterns);
-
-                for (; patterns_iter < patterns_end; ++patterns_iter) {
-                  auto&& cur_pattern = *patterns_iter;
-                  auto const begin_cur_pattern = std::cbegin(cur_pattern);
-                  auto const end_cur_pattern = std::cend(cur_pattern);
-
-                  if (std::any_of(std::next(patterns_iter), patterns_end,
-                                  [&](auto&& next_pattern) {
-                                    return std::equal(begin_cur_pattern,
-                                                      end_cur_pattern,
-                                                      std::cbegin(next_pattern),
-                                                      std::cend(next_pattern));
-                                  })) {
-                    return true;
-                  }
-                }
+  auto const pages = sysconf(_SC_PHYS_PAGES);
+  auto const pageSize = sysconf(_SC_PAGE_SIZE);
+  if (pages <= 0 or pageSize <= 0)
+    return std::numeric_limits<std::size_t>::max();
 
-                return false;
-              }();
-
-              if (redundandPatterns or
-                  ranges::any_of(
-                      window.fractions,
-                      [min_cluster_fraction =
-                           args.minimum_cluster_fraction()](auto&& fraction) {
-                        return fraction < min_cluster_fraction;
-                      })) {
-                stop = false;
-                auto const result_window_begin = window.begin_index;
-                auto const result_window_end = window.end_index;
-                assert(window.fractions.size() > 1);
-                auto const new_clusters_constraint =
-                    static_cast<unsigned>(window.fractions.size() - 1);
-
-                ranges::for_each(
-                    ranges::view::zip(windows,
-                                      windows_max_clusters_constraints),
-                    [&](auto&& data) {
-                      auto&& [window, window_constraint] = data;
-                      if (window.start_base >= result_window_begin and
-                          window.start_base + window_size <=
-                              result_window_end) {
-
-                        window_constraint = new_clusters_constraint;
-                      }
-                    });
-              }
+  return static_cast<std::size_t>(pages) * static_cast<std::size_t>(pageSize) /
+         2;
+}
 
-              if (not stop)
-                continue;
+int
+main(int argc, char* argv[]) {
+  auto const args = Args(argc, argv);
 
-              *window.patterns =
-                  filteredRingmap.remapPatterns(*window.patterns);
+  std::cout << "\n[+] Starting DRACO analysis. This might take a while...\n";
 
-              {
-                std::vector assignments(std::move_iterator(std::begin(
-                                            std::get<2>(fractions_result))),
-                                        std::move_iterator(std::end(
-                                            std::get<2>(fractions_result))));
-                assert(ranges::is_sorted(
-                    assignments, {},
-                    [](auto&& pair) -> decltype(auto) { return pair.first; }));
+  // Disabling OMP, we parallelize a higher level
+  omp_set_num_threads(1);
 
-                if (not window.bases_coverages) {
-                  window.bases_coverages = std::vector<std::vector<unsigned>>{};
-                }
-                auto& bases_coverages = *window.bases_coverages;
-                bases_coverages.resize(
-                    window.weighted_clusters.getClustersSize(),
-                    std::vector<unsigned>(window.end_index - window.begin_index,
-                                          0));
-
-                auto&& original_data = std::as_const(ringmap).data();
-                auto&& rows = std::as_const(filteredRingmap).data().rows();
-                auto&& rows_iter = ranges::cbegin(rows);
-                auto const rows_end = ranges::cend(rows);
-                auto&& original_indices_iter =
-                    ranges::begin(filteredRingmap.getReadsMap());
-                for (; rows_iter < rows_end;
-                     ++rows_iter, ++original_indices_iter) {
-                  auto const original_index = *original_indices_iter;
-                  auto&& row = *rows_iter;
-
-                  auto assignment_iter_range = ranges::equal_range(
-                      assignments, row,
-                      [](auto&& a, auto&& b) { return a < b; },
-                      [](auto&& pair) -> decltype(auto) { return pair.first; });
-                  assert(assignment_iter_range.begin() !=
-                         ranges::end(assignments));
-                  assert(assignment_iter_range.end() ==
-                         ranges::next(assignment_iter_range.begin()));
-
-                  auto&& clusters_assignments =
-                      assignment_iter_range.begin()->second;
-                  auto const first_usable_cluster_iter =
-                      ranges::find_if(clusters_assignments,
-                                      [](auto count) { return count != 0; });
-
-                  if (first_usable_cluster_iter !=
-                      ranges::end(clusters_assignments)) {
-
-                    auto const assignment =
-                        ranges::distance(ranges::begin(clusters_assignments),
-                                         first_usable_cluster_iter);
-                    window.assignments[original_index] = assignment;
-                    --*first_usable_cluster_iter;
-
-                    auto&& original_row = original_data.row(original_index);
-                    auto const begin_index =
-                        std::max(original_row.begin_index(),
-                                 static_cast<unsigned>(window.begin_index));
-                    auto const end_index =
-                        std::min(original_row.end_index(),
-                                 static_cast<unsigned>(window.end_index));
-
-                    assert(static_cast<std::size_t>(assignment) <
-                           bases_coverages.size());
-                    auto&& cluster_bases_coverages =
-                        bases_coverages[assignment];
-                    assert(cluster_bases_coverages.size() >=
-                           end_index - begin_index);
-                    ranges::for_each(cluster_bases_coverages |
-                                         ranges::view::slice(
-                                             begin_index - window.begin_index,
-                                             end_index - window.begin_index),
-                                     [](auto&& coverage) { ++coverage; });
-                  }
-                }
-              }
+  // Fail early on an invalid kernel instead of inside the workers
+  ringmap_matrix::parseCovarianceKernel(args.covariance_kernel());
 
-              if (std::all_of(std::cbegin(*window.patterns),
-                              std::cend(*window.patterns), [](auto&& pattern) {
-                                return std::all_of(
-                                    std::cbegin(pattern), std::cend(pattern),
-                                    [](auto&& value) { return value == 0; });
-                              })) {
-                window.patterns = std::nullopt;
-                window.bases_coverages = std::nullopt;
-              }
-            }
-          }
-        }
+  MutationMap mutationMap(args.mm_filename(), args.memory_mapped_input());
+  results::Analysis analysisResult(args.output_filename());
+
+  analysisResult.filename = args.mm_filename();
+
+  if (args.create_eigengaps_plots()) {
+    fs::create_directory(fs::path(args.eigengaps_plots_root_dir()));
+  }
 
-        analysisResult.addTranscript(std::move(transcriptResult));
+  /* The MM file is always indexed (in memory when the index cannot be
+   * written), so each worker claims the next transcript offset and decodes it
+   * on its own */
+  auto const indexedEntries =
+      RingmapData::getIndexedTranscriptsEntries(mutationMap, args);
+  std::atomic<std::size_t> nextIndexedEntry(0);
+
+  /* The work in flight is bounded by its estimated memory rather than by the
+   * number of transcripts */
+  parallel::memory_budget memoryBudget(get_memory_budget(args));
+
+  const auto nWorkers = [&] {
+    auto n_processors = args.n_processors();
+    if (n_processors == 0)
+      n_processors = std::thread::hardware_concurrency() - 1u;
+
+    return static_cast<std::size_t>(std::max(n_processors, 1u));
+  }();
+
+  /* With fewer indexed transcripts than workers (e.g. single amplicon runs)
+   * the spare threads help decoding the reads of each transcript. */
+  auto const decodingThreads = static_cast<unsigned>(
+      indexedEntries.empty()
+          ? 1
+          : std::max<std::size_t>(nWorkers / indexedEntries.size(), 1));
+
+  std::optional<PtbaCache> ptbaCacheStorage;
+  if (auto const& ptba_cache_dir = args.ptba_cache_dir();
+      not ptba_cache_dir.empty())
+    ptbaCacheStorage.emplace(ptba_cache_dir, args);
+  PtbaCache const* const ptbaCache =
+      ptbaCacheStorage ? &*ptbaCacheStorage : nullptr;
+
+  std::optional<NullModelLibrary> nullModelLibraryStorage;
+  if (args.null_model_library())
+    nullModelLibraryStorage.emplace();
+  NullModelLibrary* const nullModelLibrary =
+      nullModelLibraryStorage ? &*nullModelLibraryStorage : nullptr;
+
+  PermutationsStats permutationsStats;
+  std::vector<std::thread> workers;
+  workers.reserve(nWorkers);
+  for (std::size_t workerIndex = 0; workerIndex < nWorkers; ++workerIndex) {
+    workers.emplace_back([&] {
+      for (;;) {
+        auto const entryIndex =
+            nextIndexedEntry.fetch_add(1, std::memory_order_relaxed);
+        if (entryIndex >= indexedEntries.size())
+          break;
+
+        auto const& entry = *indexedEntries[entryIndex];
+        auto const estimatedMemory = RingmapData::estimateMemoryUsage(
+            entry, mutationMap.getFormatVersion());
+        parallel::memory_budget_guard budgetGuard(memoryBudget,
+                                                  estimatedMemory);
+        MutationMapTranscript transcript(mutationMap, entry);
+        RingmapData ringmapData(transcript, args, decodingThreads);
+        analyze_transcript(transcript, ringmapData, analysisResult,
+                           permutationsStats, ptbaCache, nullModelLibrary,
+                           args);
       }
     });
   }
 
-  reader.join();
   for (auto& worker : workers)
     worker.join();
 
+  if (args.sequential_test()) {
+    std::cout << "\n[+] Sequential test saved " << permutationsStats.saved
+              << " of " << permutationsStats.drawn + permutationsStats.saved
+              << " permutations";
+  }
+  if (nullModelLibrary) {
+    std::cout << "\n[+] Null model library provided "
+              << permutationsStats.fromLibrary << " of "
+              << permutationsStats.drawn + permutationsStats.fromLibrary
+              << " permutations";
+  }
+  if (ptbaCache) {
+    std::cout << "\n[+] Reused " << ptbaCache->hits() << " of "
+              << ptbaCache->hits() + ptbaCache->misses()
+              << " window analyses from the PTBA cache";
+  }
   std::cout << "\n[+] All done.\n\n";
 }
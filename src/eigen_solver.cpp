@@ -0,0 +1,167 @@
+#include "eigen_solver.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <random>
+#include <stdexcept>
+
+namespace eigen_solver {
+
+namespace {
+
+/* Each LOBPCG iteration multiplies the matrix by a basis of three blocks: when
+ * the basis is not much smaller than the matrix, the dense decomposition is
+ * cheaper */
+constexpr arma::uword minRowsPerBasisColumn = 4;
+
+// A few more columns than needed speed up the convergence of the last ones
+arma::uword
+lobpcgBlockSize(arma::uword nValues) noexcept {
+  return nValues + std::max(nValues / 2, arma::uword(2));
+}
+
+Decomposition
+denseSmallest(const arma::mat& matrix, arma::uword nEigen,
+              bool eigenVectors) noexcept(false) {
+  Decomposition out;
+  out.dense = true;
+
+  bool decomposed;
+  if (eigenVectors) {
+    decomposed = arma::eig_sym(out.eigenValues, out.eigenVecs, matrix);
+    out.eigenVecs = out.eigenVecs.head_cols(nEigen);
+  } else
+    decomposed = arma::eig_sym(out.eigenValues, matrix);
+
+  if (not decomposed)
+    throw std::runtime_error("eigendecomposition failed");
+  out.eigenValues = out.eigenValues.head(nEigen);
+  return out;
+}
+
+/* Orthonormal basis of the columns, completed with random ones up to the
+ * given size. The generator has a fixed seed, so that the solutions do not
+ * depend on the thread computing them. */
+arma::mat
+orthonormalBasis(const arma::mat& columns, arma::uword size) noexcept(false) {
+  std::mt19937 generator(static_cast<std::mt19937::result_type>(columns.n_rows));
+  std::uniform_real_distribution<double> distribution(-1., 1.);
+
+  arma::mat basis(columns.n_rows, 0);
+  if (columns.n_cols > 0)
+    basis = arma::orth(columns);
+  for (unsigned attempt = 0; attempt < 3 and basis.n_cols < size; ++attempt) {
+    arma::mat random(columns.n_rows, size - basis.n_cols);
+    random.imbue([&] { return distribution(generator); });
+    basis = arma::orth(arma::join_rows(basis, random));
+  }
+
+  return basis;
+}
+
+} // namespace
+
+arma::mat
+EigenSubspace::on(const std::vector<unsigned>& otherBases) const
+    noexcept(false) {
+  assert(vectors.n_rows == bases.size());
+  assert(std::is_sorted(std::begin(bases), std::end(bases)));
+  assert(std::is_sorted(std::begin(otherBases), std::end(otherBases)));
+
+  arma::mat out(otherBases.size(), vectors.n_cols, arma::fill::zeros);
+  auto basesIter = std::begin(bases);
+  auto const basesEnd = std::end(bases);
+  for (arma::uword row = 0; row < otherBases.size(); ++row) {
+    basesIter = std::lower_bound(basesIter, basesEnd, otherBases[row]);
+    if (basesIter == basesEnd)
+      break;
+    if (*basesIter == otherBases[row])
+      out.row(row) = vectors.row(
+          static_cast<arma::uword>(std::distance(std::begin(bases), basesIter)));
+  }
+
+  return out;
+}
+
+bool
+usesLobpcg(arma::uword size, unsigned nEigen) noexcept {
+  auto const nValues = std::min(static_cast<arma::uword>(nEigen), size);
+  return nValues > 0 and
+         lobpcgBlockSize(nValues) * 3 * minRowsPerBasisColumn <= size;
+}
+
+Decomposition
+smallest(const arma::mat& matrix, unsigned nEigen,
+         const arma::mat& initialSubspace, bool eigenVectors,
+         unsigned maxIterations, double tolerance) noexcept(false) {
+  assert(matrix.n_rows == matrix.n_cols);
+  assert(not matrix.has_nan());
+
+  auto const size = matrix.n_rows;
+  auto const nValues = std::min(static_cast<arma::uword>(nEigen), size);
+  if (nValues == 0)
+    return {};
+
+  if (not usesLobpcg(size, nEigen))
+    return denseSmallest(matrix, nValues, eigenVectors);
+  auto const blockSize = lobpcgBlockSize(nValues);
+
+  arma::mat block;
+  if (initialSubspace.n_rows == size)
+    block = orthonormalBasis(
+        initialSubspace.head_cols(std::min(blockSize, initialSubspace.n_cols)),
+        blockSize);
+  else
+    block = orthonormalBasis(arma::mat(size, 0), blockSize);
+  if (block.n_cols < blockSize)
+    return denseSmallest(matrix, nValues, eigenVectors);
+
+  arma::mat product = matrix * block;
+  arma::vec values;
+  {
+    arma::mat ritzVecs;
+    if (not arma::eig_sym(values, ritzVecs, arma::symmatu(block.t() * product)))
+      return denseSmallest(matrix, nValues, eigenVectors);
+    block = block * ritzVecs;
+    product = product * ritzVecs;
+  }
+
+  arma::mat directions(size, 0);
+  for (unsigned iteration = 1; iteration <= maxIterations; ++iteration) {
+    arma::mat const residuals = product - block * arma::diagmat(values);
+    arma::rowvec const residualNorms =
+        arma::sqrt(arma::sum(arma::square(residuals), 0));
+    if (residualNorms.head(nValues).max() < tolerance) {
+      Decomposition out;
+      out.eigenVecs = block.head_cols(nValues);
+      out.eigenValues = values.head(nValues);
+      out.subspace = std::move(block);
+      out.iterations = iteration;
+      return out;
+    }
+
+    // Rayleigh-Ritz on the block, the residuals and the previous directions
+    arma::mat const basis =
+        arma::orth(arma::join_rows(arma::join_rows(block, residuals), directions));
+    if (basis.n_cols < blockSize)
+      break;
+
+    arma::mat const basisProduct = matrix * basis;
+    arma::vec basisValues;
+    arma::mat ritzVecs;
+    if (not arma::eig_sym(basisValues, ritzVecs,
+                          arma::symmatu(basis.t() * basisProduct)))
+      break;
+
+    arma::mat nextBlock = basis * ritzVecs.head_cols(blockSize);
+    directions = nextBlock - block * (block.t() * nextBlock);
+    block = std::move(nextBlock);
+    product = basisProduct * ritzVecs.head_cols(blockSize);
+    values = basisValues.head(blockSize);
+  }
+
+  // Stalled
+  return denseSmallest(matrix, nValues, eigenVectors);
+}
+
+} // namespace eigen_solver
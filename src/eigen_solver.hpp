@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include <armadillo>
+
+namespace eigen_solver {
+
+struct Decomposition {
+  arma::mat eigenVecs;
+  arma::vec eigenValues;
+  /* Whole LOBPCG block, including the extra vectors that speed up the
+   * convergence: it is the best starting subspace for a similar matrix */
+  arma::mat subspace;
+  /* Number of LOBPCG iterations, zero when the dense solver was used */
+  unsigned iterations = 0;
+  bool dense = false;
+};
+
+/* Eigenvectors of a previous solution, kept to start the next one. Each row
+ * refers to a base of the transcript, so that windows with different bases can
+ * share it. */
+struct EigenSubspace {
+  arma::mat vectors;
+  std::vector<unsigned> bases;
+
+  /* Rows of the subspace for the given sorted bases, zero for the bases that
+   * are not in it */
+  arma::mat on(const std::vector<unsigned>& otherBases) const noexcept(false);
+};
+
+/* Whether smallest() runs LOBPCG on a matrix of the given size, which is the
+ * only case in which the initial subspace is used. The dense solver is chosen
+ * whenever nEigen is not much smaller than the size, as it happens when all
+ * the eigengaps of a window are tested. */
+bool usesLobpcg(arma::uword size, unsigned nEigen) noexcept;
+
+/* The nEigen smallest eigenpairs of a symmetric matrix, by increasing
+ * eigenvalue. They are computed with LOBPCG starting from the columns of
+ * initialSubspace, which can be empty or have less columns than needed; it
+ * converges in a few iterations when the subspace comes from a spectrally
+ * similar matrix. The dense eig_sym is used when the block would be too large
+ * for the size of the matrix, and when LOBPCG stalls. In that case the
+ * eigenvectors are only computed if requested, LOBPCG always returns them. */
+Decomposition smallest(const arma::mat& matrix, unsigned nEigen,
+                       const arma::mat& initialSubspace = {},
+                       bool eigenVectors = true,
+                       unsigned maxIterations = 100,
+                       double tolerance = 1e-6) noexcept(false);
+
+} // namespace eigen_solver
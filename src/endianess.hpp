@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
 #include <type_traits>
 
 enum class Endianess { little, big };
@@ -36,3 +37,21 @@ constexpr void
 swapBytes(T& t) {
   t = detail::swapBytes<sizeof(T) / 2>(t);
 }
+
+template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+inline T
+loadLittleEndian(const char* data) noexcept {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  if constexpr (system_is_big_endian::value)
+    swapBytes(value);
+  return value;
+}
+
+template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+inline void
+storeLittleEndian(char* data, T value) noexcept {
+  if constexpr (system_is_big_endian::value)
+    swapBytes(value);
+  std::memcpy(data, &value, sizeof(T));
+}
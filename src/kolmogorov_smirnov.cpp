@@ -1,9 +1,14 @@
 #include "kolmogorov_smirnov.hpp"
 #include "kolmogorov_smirnov_general.hpp"
+#include <algorithm>
 #include <armadillo>
+#include <array>
 #include <cmath>
 #include <cstdlib>
-#include <map>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <mutex>
 #include <vector>
 
 constexpr int nExact = 500;
@@ -588,14 +593,54 @@ mPower(std::vector<double> const& A, int eA, std::vector<double>& V, int* eV,
     renormalize(V, m, eV);
 }
 
+namespace {
+
+constexpr unsigned kolmogorov_smirnov_max_tabulated_n = 50;
+
+/* Critical values for a sample size, one for each alpha multiple of
+ * 1 / kolmogorov_smirnov_table_size. They are built the first time the size is
+ * needed, once for the whole process. */
+struct KolmogorovSmirnovCriticalValues {
+  std::once_flag built;
+  std::vector<double> values;
+};
+
+std::vector<double>
+make_critical_values(unsigned n) {
+  std::vector<double> fbars(kolmogorov_smirnov_table_size);
+  for (std::size_t index = 0; index < kolmogorov_smirnov_table_size; ++index) {
+    double x = static_cast<double>(index + 1) /
+               static_cast<double>(kolmogorov_smirnov_table_size);
+    fbars[index] = KSfbar(static_cast<int>(n), x);
+  }
+
+  std::vector<double> critical_values(kolmogorov_smirnov_table_size + 1);
+  for (std::size_t index = 0; index <= kolmogorov_smirnov_table_size;
+       ++index) {
+    double const alpha = static_cast<double>(index) /
+                         static_cast<double>(kolmogorov_smirnov_table_size);
+    auto const value_iter = std::upper_bound(
+        std::begin(fbars), std::end(fbars), alpha, std::greater<double>());
+    critical_values[index] =
+        static_cast<double>(std::distance(std::begin(fbars), value_iter)) /
+        static_cast<double>(kolmogorov_smirnov_table_size);
+  }
+
+  return critical_values;
+}
+
+} // namespace
+
 double
 kolmogorov_smirnov_critical_value(unsigned n, double alpha) {
-  thread_local std::map<int, std::vector<double>> cached_probabilities;
+  static std::array<KolmogorovSmirnovCriticalValues,
+                    kolmogorov_smirnov_max_tabulated_n + 1>
+      tables;
 
   if (alpha <= 0. or alpha > 1.)
     return std::numeric_limits<double>::quiet_NaN();
 
-  if (n > 50) {
+  if (n > kolmogorov_smirnov_max_tabulated_n) {
     auto const value_iter =
         std::upper_bound(std::begin(kolmogorov_smirnov_general_table),
                          std::end(kolmogorov_smirnov_general_table), alpha,
@@ -607,24 +652,16 @@ kolmogorov_smirnov_critical_value(unsigned n, double alpha) {
            std::sqrt(static_cast<double>(n));
   }
 
-  auto const& table = [&]() -> decltype(auto) {
-    if (auto table_iter = cached_probabilities.find(n);
-        table_iter == std::end(cached_probabilities)) {
-      std::vector<double> fbars(kolmogorov_smirnov_table_size);
-      for (std::size_t index = 0; index < kolmogorov_smirnov_table_size;
-           ++index) {
-        double x = static_cast<double>(index + 1) /
-                   static_cast<double>(kolmogorov_smirnov_table_size);
-        fbars[index] = KSfbar(n, x);
-      }
-      return cached_probabilities.emplace(n, std::move(fbars)).first->second;
-    } else {
-      return table_iter->second;
-    }
-  }();
-
-  auto const value_iter = std::upper_bound(std::begin(table), std::end(table),
-                                           alpha, std::greater<double>());
-  return static_cast<double>(std::distance(std::begin(table), value_iter)) /
-         static_cast<double>(kolmogorov_smirnov_table_size);
+  auto& table = tables[n];
+  std::call_once(table.built,
+                 [&] { table.values = make_critical_values(n); });
+
+  // Linear interpolation between the two closest tabulated alphas
+  double const position =
+      alpha * static_cast<double>(kolmogorov_smirnov_table_size);
+  auto const lower_index = std::min(static_cast<std::size_t>(position),
+                                    kolmogorov_smirnov_table_size - 1);
+  double const weight = position - static_cast<double>(lower_index);
+  return table.values[lower_index] * (1. - weight) +
+         table.values[lower_index + 1] * weight;
 }
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "endianess.hpp"
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+/* Non-owning view over a packed array of little-endian integers, as they are
+ * stored on disk. Elements are loaded on access, therefore the underlying
+ * buffer does not need to be aligned. */
+template <typename T>
+class LittleEndianSpan {
+public:
+  static_assert(std::is_integral_v<T>);
+
+  class iterator {
+  public:
+    using value_type = T;
+    using reference = T;
+    using pointer = void;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::random_access_iterator_tag;
+
+    iterator() = default;
+    explicit iterator(const char* data) noexcept : data(data) {}
+
+    T operator*() const noexcept { return loadLittleEndian<T>(data); }
+    T operator[](difference_type offset) const noexcept {
+      return loadLittleEndian<T>(data + offset * difference_type(sizeof(T)));
+    }
+
+    iterator&
+    operator++() noexcept {
+      data += sizeof(T);
+      return *this;
+    }
+
+    iterator
+    operator++(int) noexcept {
+      auto copy = *this;
+      data += sizeof(T);
+      return copy;
+    }
+
+    iterator&
+    operator--() noexcept {
+      data -= sizeof(T);
+      return *this;
+    }
+
+    iterator
+    operator--(int) noexcept {
+      auto copy = *this;
+      data -= sizeof(T);
+      return copy;
+    }
+
+    iterator&
+    operator+=(difference_type offset) noexcept {
+      data += offset * difference_type(sizeof(T));
+      return *this;
+    }
+
+    iterator&
+    operator-=(difference_type offset) noexcept {
+      data -= offset * difference_type(sizeof(T));
+      return *this;
+    }
+
+    iterator
+    operator+(difference_type offset) const noexcept {
+      return iterator(data + offset * difference_type(sizeof(T)));
+    }
+
+    friend iterator
+    operator+(difference_type offset, iterator const& iter) noexcept {
+      return iter + offset;
+    }
+
+    iterator
+    operator-(difference_type offset) const noexcept {
+      return iterator(data - offset * difference_type(sizeof(T)));
+    }
+
+    difference_type
+    operator-(iterator const& other) const noexcept {
+      return (data - other.data) / difference_type(sizeof(T));
+    }
+
+    bool operator==(iterator const& other) const noexcept {
+      return data == other.data;
+    }
+    bool operator!=(iterator const& other) const noexcept {
+      return data != other.data;
+    }
+    bool operator<(iterator const& other) const noexcept {
+      return data < other.data;
+    }
+    bool operator<=(iterator const& other) const noexcept {
+      return data <= other.data;
+    }
+    bool operator>(iterator const& other) const noexcept {
+      return data > other.data;
+    }
+    bool operator>=(iterator const& other) const noexcept {
+      return data >= other.data;
+    }
+
+  private:
+    const char* data = nullptr;
+  };
+
+  using value_type = T;
+  using const_iterator = iterator;
+
+  LittleEndianSpan() = default;
+  LittleEndianSpan(const char* data, std::size_t size) noexcept
+      : first(data), count(size) {}
+
+  iterator begin() const noexcept { return iterator(first); }
+  iterator end() const noexcept {
+    return iterator(first + count * sizeof(T));
+  }
+
+  std::size_t size() const noexcept { return count; }
+  bool empty() const noexcept { return count == 0; }
+  T operator[](std::size_t index) const noexcept {
+    return loadLittleEndian<T>(first + index * sizeof(T));
+  }
+
+  const char* data() const noexcept { return first; }
+
+private:
+  const char* first = nullptr;
+  std::size_t count = 0;
+};
@@ -0,0 +1,88 @@
+#include "mapped_file.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& filename) noexcept(false) {
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("cannot open '" + filename +
+                             "': " + std::strerror(errno));
+
+  struct stat fileStat;
+  if (::fstat(fd, &fileStat) != 0) {
+    auto const error = errno;
+    ::close(fd);
+    throw std::runtime_error("cannot stat '" + filename +
+                             "': " + std::strerror(error));
+  }
+
+  mappedSize = static_cast<std::size_t>(fileStat.st_size);
+  if (mappedSize != 0) {
+    void* address =
+        ::mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+      auto const error = errno;
+      ::close(fd);
+      mappedSize = 0;
+      throw std::runtime_error("cannot memory-map '" + filename +
+                               "': " + std::strerror(error));
+    }
+
+    // Reads are mostly consumed front to back, let the kernel read ahead
+    ::madvise(address, mappedSize, MADV_SEQUENTIAL);
+    mappedData = static_cast<const char*>(address);
+  }
+
+  ::close(fd);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : mappedData(std::exchange(other.mappedData, nullptr)),
+      mappedSize(std::exchange(other.mappedSize, 0)) {}
+
+MappedFile&
+MappedFile::operator=(MappedFile&& other) noexcept {
+  unmap();
+  mappedData = std::exchange(other.mappedData, nullptr);
+  mappedSize = std::exchange(other.mappedSize, 0);
+  return *this;
+}
+
+MappedFile::~MappedFile() noexcept { unmap(); }
+
+void
+MappedFile::unmap() noexcept {
+  if (mappedData != nullptr)
+    ::munmap(const_cast<char*>(mappedData), mappedSize);
+
+  mappedData = nullptr;
+  mappedSize = 0;
+}
+
+const char*
+MappedFile::data() const noexcept {
+  return mappedData;
+}
+
+std::size_t
+MappedFile::size() const noexcept {
+  return mappedSize;
+}
+
+std::string_view
+MappedFile::content() const noexcept {
+  return {mappedData, mappedSize};
+}
+
+bool
+MappedFile::is_open() const noexcept {
+  return mappedData != nullptr;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+class MappedFile {
+public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string& filename) noexcept(false);
+  MappedFile(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  ~MappedFile() noexcept;
+
+  const char* data() const noexcept;
+  std::size_t size() const noexcept;
+  std::string_view content() const noexcept;
+  bool is_open() const noexcept;
+
+private:
+  void unmap() noexcept;
+
+  const char* mappedData = nullptr;
+  std::size_t mappedSize = 0;
+};
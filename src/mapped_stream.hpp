@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstring>
+#include <ios>
+#include <string_view>
+
+/* A minimal input stream over an in-memory buffer, exposing the subset of the
+ * std::istream interface used by BinaryStream and the mutation map parsers.
+ * Unlike std::istringstream it never copies the underlying buffer. */
+class MappedStream {
+public:
+  MappedStream() = default;
+  explicit MappedStream(std::string_view buffer) noexcept
+      : buffer(buffer), position(0) {}
+
+  MappedStream&
+  read(char* out, std::streamsize count) noexcept {
+    auto const size = static_cast<std::size_t>(count);
+    if (failed or position + size > buffer.size()) {
+      failed = true;
+      return *this;
+    }
+
+    std::memcpy(out, buffer.data() + position, size);
+    position += size;
+    return *this;
+  }
+
+  int
+  get() noexcept {
+    if (failed or position >= buffer.size()) {
+      failed = true;
+      return -1;
+    }
+
+    return static_cast<unsigned char>(buffer[position++]);
+  }
+
+  MappedStream&
+  seekg(std::streampos offset) noexcept {
+    position = static_cast<std::size_t>(static_cast<std::streamoff>(offset));
+    return *this;
+  }
+
+  MappedStream&
+  seekg(std::streamoff offset, std::ios_base::seekdir direction) noexcept {
+    switch (direction) {
+    case std::ios_base::beg:
+      position = static_cast<std::size_t>(offset);
+      break;
+    case std::ios_base::cur:
+      position = static_cast<std::size_t>(
+          static_cast<std::streamoff>(position) + offset);
+      break;
+    default:
+      position = static_cast<std::size_t>(
+          static_cast<std::streamoff>(buffer.size()) + offset);
+      break;
+    }
+
+    return *this;
+  }
+
+  std::streampos
+  tellg() const noexcept {
+    return static_cast<std::streamoff>(position);
+  }
+
+  const char*
+  current() const noexcept {
+    return buffer.data() + position;
+  }
+
+  std::size_t
+  remaining() const noexcept {
+    return position < buffer.size() ? buffer.size() - position : 0;
+  }
+
+  explicit operator bool() const noexcept { return not failed; }
+  bool operator not() const noexcept { return failed; }
+
+private:
+  std::string_view buffer;
+  std::size_t position = 0;
+  bool failed = false;
+};
@@ -0,0 +1,69 @@
+#include "mutation_map.hpp"
+#include "mutation_map_codec.hpp"
+#include "mutation_map_writer.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include "cxxopts.hpp"
+
+int
+main(int argc, char* argv[]) {
+  cxxopts::Options opts(argv[0],
+                        "\n DRACO mutation map converter (v1.0)\n\n"
+                        " Converts MM files between the original format (v1) "
+                        "and the block-compressed one (v2)\n");
+  // clang-format off
+  opts.add_options()
+    ("input", "Input mutation map (MM) file", cxxopts::value<std::string>())
+    ("output", "Output mutation map (MM) file", cxxopts::value<std::string>())
+    ("format", "Output format version (1 or 2)",
+     cxxopts::value<unsigned>()->default_value("2"))
+    ("blockReads", "Maximum number of reads per block (v2 only)",
+     cxxopts::value<std::uint32_t>()->default_value(
+         std::to_string(mutation_map_codec::defaultBlockReads)))
+    ("help", "Displays this help");
+  // clang-format on
+  opts.parse_positional({"input", "output"});
+  opts.positional_help("<input> <output>");
+
+  auto const args = [&] {
+    try {
+      return opts.parse(argc, argv);
+    } catch (std::exception& e) {
+      std::cerr << "[!] Error: " << e.what() << '\n';
+      std::exit(2);
+    }
+  }();
+
+  if (args.count("help")) {
+    std::cout << opts.help();
+    return 0;
+  }
+
+  if (not args.count("input") or not args.count("output")) {
+    std::cerr << "[!] Error: input and output files must be specified\n";
+    return 2;
+  }
+
+  try {
+    auto const& inputFilename = args["input"].as<std::string>();
+    auto const& outputFilename = args["output"].as<std::string>();
+    if (inputFilename == outputFilename) {
+      std::cerr << "[!] Error: input and output files must be different\n";
+      return 2;
+    }
+
+    MutationMap mutationMap(inputFilename);
+    MutationMapWriter writer(outputFilename, args["format"].as<unsigned>(),
+                             args["blockReads"].as<std::uint32_t>());
+    for (auto&& transcript : mutationMap)
+      writer.addTranscript(transcript);
+    writer.finish();
+  } catch (std::exception& e) {
+    std::cerr << "[!] Error: " << e.what() << '\n';
+    return 1;
+  }
+}
@@ -1,22 +1,97 @@
 #include "mutation_map.hpp"
 
+#include "endianess.hpp"
+#include "mapped_file.hpp"
+#include "mutation_map_codec.hpp"
 #include "mutation_map_index.hpp"
-#include "ringmap_data.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <fstream>
+#include <iostream>
+#include <optional>
 #include <range/v3/algorithm.hpp>
-#include <range/v3/iterator/insert_iterators.hpp>
+#include <sstream>
 #include <string_view>
+#include <thread>
+#include <unistd.h>
+
+#if __has_include(<filesystem>)
+#include <filesystem>
+#elif __has_include(<experimental/filesystem>)
+#include <experimental/filesystem>
+#else
+#error "Missing filesystem header"
+#endif
 
 constexpr std::array<std::uint8_t, 7> MutationMap::eofMarker;
 
-MutationMap::MutationMap(std::string_view filename) : filename(filename) {
+MutationMap::MutationMap(std::string_view filename, bool memoryMapped)
+    : filename(filename) {
+  if (memoryMapped)
+    mappedFile = std::make_shared<const MappedFile>(this->filename);
+
   checkEofMarker();
+  checkFormat();
   loadIndexFile();
 }
 
+void
+MutationMap::checkFormat() noexcept(false) {
+  std::array<char, mutation_map_codec::headerSize> header;
+  std::size_t headerBytes;
+  if (mappedFile) {
+    auto const content = mappedFile->content();
+    headerBytes = std::min(header.size(), content.size());
+    std::copy_n(std::begin(content), headerBytes, std::begin(header));
+  } else {
+    std::ifstream fileStream(filename, std::ios::binary bitor std::ios::in);
+    fileStream.read(header.data(), header.size());
+    headerBytes = static_cast<std::size_t>(fileStream.gcount());
+  }
+
+  // A v1 file cannot start with an empty transcript id
+  if (headerBytes < sizeof(std::uint16_t) or
+      loadLittleEndian<std::uint16_t>(header.data()) != 0) {
+    formatVersion = 1;
+    streamBeginPos = 0;
+    return;
+  }
+
+  auto const magicBegin = std::next(std::begin(header), sizeof(std::uint16_t));
+  if (headerBytes < header.size() or
+      not std::equal(std::begin(mutation_map_codec::magic),
+                     std::end(mutation_map_codec::magic), magicBegin))
+    throw std::runtime_error("unknown mutation map format");
+
+  auto headerIter = std::next(magicBegin, mutation_map_codec::magic.size());
+  formatVersion = loadLittleEndian<std::uint16_t>(&*headerIter);
+  if (formatVersion != mutation_map_codec::version)
+    throw std::runtime_error("unsupported mutation map format version");
+
+  std::advance(headerIter, sizeof(std::uint16_t));
+  blockReads = loadLittleEndian<std::uint32_t>(&*headerIter);
+  streamBeginPos = static_cast<std::streamoff>(header.size());
+}
+
 void
 MutationMap::checkEofMarker() noexcept(false) {
+  if (mappedFile) {
+    auto const content = mappedFile->content();
+    if (content.size() < eofMarker.size() or
+        not std::equal(std::begin(eofMarker), std::end(eofMarker),
+                       std::prev(std::end(content), eofMarker.size()),
+                       [](std::uint8_t marker, char c) {
+                         return marker == static_cast<std::uint8_t>(c);
+                       }))
+      throw std::runtime_error("end-of-file magic marker not found");
+
+    streamEndPos =
+        static_cast<std::streamoff>(content.size() - eofMarker.size());
+    return;
+  }
+
   std::ifstream fileStream(filename, std::ios::binary bitor std::ios::in);
   fileStream.seekg(-static_cast<std::ptrdiff_t>(eofMarker.size()),
                    std::ios::end);
@@ -36,13 +111,22 @@ MutationMap::checkEofMarker() noexcept(false) {
 
 unsigned
 MutationMap::loadOtherTranscripts(unsigned n) noexcept(false) {
+  if (not indexEntries.empty()) {
+    unsigned transcriptIndex = 0;
+    for (; transcriptIndex < n and transcripts.size() < indexEntries.size();
+         ++transcriptIndex)
+      transcripts.emplace_back(*this, indexEntries[transcripts.size()].offset);
+
+    return transcriptIndex;
+  }
+
   std::streampos offset;
   if (transcripts.size() > 0) {
     auto& transcript = transcripts.back();
     transcript.skip();
     offset = transcript.getEndOffset();
   } else
-    offset = 0;
+    offset = streamBeginPos;
 
   unsigned transcriptIndex = 0;
   for (; transcriptIndex < n and offset < streamEndPos; ++transcriptIndex) {
@@ -89,27 +173,180 @@ MutationMap::getFilename() const noexcept {
   return filename;
 }
 
+unsigned
+MutationMap::getFormatVersion() const noexcept {
+  return formatVersion;
+}
+
+std::streampos
+MutationMap::getDataBeginOffset() const noexcept {
+  return streamBeginPos;
+}
+
+std::uint32_t
+MutationMap::getBlockReads() const noexcept {
+  return blockReads;
+}
+
+bool
+MutationMap::isMemoryMapped() const noexcept {
+  return static_cast<bool>(mappedFile);
+}
+
+std::string_view
+MutationMap::getMappedContent() const noexcept {
+  if (mappedFile)
+    return mappedFile->content();
+  else
+    return {};
+}
+
 void
 MutationMap::loadIndexFile() noexcept(false) {
+#if __has_include(<filesystem>)
+  namespace fs = std::filesystem;
+#else
+  namespace fs = std::experimental::filesystem;
+#endif
+
   std::string_view filename(this->filename);
-  if (filename.substr(std::size(filename) - 3) != ".mm")
-    return;
+  bool const hasIndexFile =
+      filename.size() > 3 and filename.substr(std::size(filename) - 3) == ".mm";
 
   std::string indexFilename = [&] {
     std::stringstream ss;
     ss << filename << 'i';
     return ss.str();
   }();
+  // RNA Framework cannot parse the extended index, which is kept aside
+  auto const extendedIndexFilename = indexFilename + ".draco";
 
-  MutationMapIndex mutationMapIndex(indexFilename);
-  auto& entries = mutationMapIndex.entries;
-  if (entries.empty())
-    return;
+  auto const mutationMapSize =
+      static_cast<std::uint64_t>(fs::file_size(this->filename));
+  auto const mutationMapTime = static_cast<std::int64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          fs::last_write_time(this->filename).time_since_epoch())
+          .count());
+
+  // Headers are scanned in memory, even when the map is read through streams
+  std::optional<MappedFile> localMappedFile;
+  auto const getContent = [&] {
+    if (mappedFile)
+      return mappedFile->content();
+
+    if (not localMappedFile)
+      localMappedFile.emplace(this->filename);
+    return localMappedFile->content();
+  };
+  auto const dataSize =
+      static_cast<std::size_t>(static_cast<std::streamoff>(streamEndPos));
+
+  auto const readIndexFile =
+      [](const std::string& name) -> std::optional<MutationMapIndex> {
+    if (not fs::exists(name))
+      return std::nullopt;
+    try {
+      return MutationMapIndex(name);
+    } catch (const std::runtime_error&) {
+      return std::nullopt;
+    }
+  };
+
+  if (hasIndexFile) {
+    if (auto mutationMapIndex = readIndexFile(extendedIndexFilename);
+        mutationMapIndex and
+        mutationMapIndex->isUpToDate(mutationMapSize, mutationMapTime)) {
+      indexEntries = std::move(mutationMapIndex->entries);
+      buildIdsLookup();
+      return;
+    }
+
+    if (auto mutationMapIndex = readIndexFile(indexFilename);
+        mutationMapIndex and not mutationMapIndex->extended and
+        not mutationMapIndex->entries.empty() and
+        fs::last_write_time(indexFilename) >=
+            fs::last_write_time(this->filename)) {
+      /* Index written by RNA Framework: it is left untouched, but the
+       * per-transcript statistics are recovered from the headers */
+      mutationMapIndex->completeEntries(getContent(), dataSize);
+      indexEntries = std::move(mutationMapIndex->entries);
+      buildIdsLookup();
+      return;
+    }
+  }
+
+  auto mutationMapIndex = MutationMapIndex::build(
+      getContent(),
+      static_cast<std::size_t>(static_cast<std::streamoff>(streamBeginPos)),
+      dataSize, formatVersion);
+  mutationMapIndex.mutationMapSize = mutationMapSize;
+  mutationMapIndex.mutationMapTime = mutationMapTime;
+
+  /* The index is only kept in memory when it cannot be written next to the
+   * map, which is not worth a warning on every run */
+  auto indexDirectory = fs::path(extendedIndexFilename).parent_path();
+  if (indexDirectory.empty())
+    indexDirectory = ".";
+  if (hasIndexFile and ::access(indexDirectory.c_str(), W_OK) == 0) {
+    // Write and rename, so concurrent runs never see a partial index
+    std::ostringstream temporaryIndexFilename;
+    temporaryIndexFilename << extendedIndexFilename << '.' << ::getpid() << '.'
+                           << std::this_thread::get_id() << ".tmp";
+    try {
+      mutationMapIndex.write(temporaryIndexFilename.str());
+      fs::rename(temporaryIndexFilename.str(), extendedIndexFilename);
+    } catch (const std::exception& e) {
+      std::error_code error;
+      fs::remove(temporaryIndexFilename.str(), error);
+      std::cerr << "WARNING: index file '" << extendedIndexFilename
+                << "' cannot be written (" << e.what() << ")\n";
+    }
+  }
 
-  ranges::transform(entries, ranges::back_inserter(transcripts),
-                    [this](auto& entry) {
-                      return MutationMapTranscript(*this, entry.offset);
-                    });
+  indexEntries = std::move(mutationMapIndex.entries);
+  buildIdsLookup();
+}
+
+static std::string
+to_lower(std::string_view value) noexcept(false) {
+  std::string out(value);
+  ranges::transform(out, ranges::begin(out), [](char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  return out;
+}
+
+void
+MutationMap::buildIdsLookup() noexcept(false) {
+  idsLookup.clear();
+  idsLookup.reserve(indexEntries.size());
+
+  std::size_t entryIndex = 0;
+  for (auto&& entry : indexEntries)
+    idsLookup[to_lower(entry.transcriptId)].push_back(entryIndex++);
+}
+
+std::vector<const MutationMapIndexEntry*>
+MutationMap::findIndexEntries(std::string_view transcriptId) const
+    noexcept(false) {
+  std::vector<const MutationMapIndexEntry*> out;
+  if (auto iter = idsLookup.find(to_lower(transcriptId));
+      iter != std::end(idsLookup)) {
+    out.reserve(iter->second.size());
+    for (auto entryIndex : iter->second)
+      out.push_back(&indexEntries[entryIndex]);
+  }
+  return out;
+}
+
+bool
+MutationMap::isIndexed() const noexcept {
+  return not indexEntries.empty();
+}
+
+auto
+MutationMap::getIndexEntries() const noexcept -> const index_entries_type& {
+  return indexEntries;
 }
 
 static_assert(ranges::InputIterator<MutationMap::iterator>);
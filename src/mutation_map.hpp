@@ -1,13 +1,19 @@
 #pragma once
 
+#include "mutation_map_index_entry.hpp"
 #include "mutation_map_iterator.hpp"
 #include "mutation_map_transcript.hpp"
 #include "nostd/type_traits.hpp"
 
 #include <array>
 #include <deque>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
+class MappedFile;
 class MutationMapTranscriptHelper;
 
 class MutationMap {
@@ -17,11 +23,16 @@ class MutationMap {
 
 public:
   using transcripts_type = std::deque<MutationMapTranscript>;
+  using index_entries_type = std::vector<MutationMapIndexEntry>;
   using iterator = MutationMapIterator<MutationMap>;
   using const_iterator = MutationMapIterator<const MutationMap>;
 
+  static constexpr std::array<std::uint8_t, 7> eofMarker{
+      '\x5b', '\x6d', '\x6d', '\x65', '\x6f', '\x66', '\x5d'};
+
   MutationMap() = default;
-  MutationMap(std::string_view filename) noexcept(false);
+  MutationMap(std::string_view filename,
+              bool memoryMapped = false) noexcept(false);
 
   iterator begin() noexcept;
   iterator end() noexcept;
@@ -30,15 +41,32 @@ public:
   void load() noexcept(false);
 
   const std::string& getFilename() const noexcept;
+  bool isMemoryMapped() const noexcept;
+  std::string_view getMappedContent() const noexcept;
+  unsigned getFormatVersion() const noexcept;
+  std::streampos getDataBeginOffset() const noexcept;
+  std::uint32_t getBlockReads() const noexcept;
   void loadIndexFile() noexcept(false);
+  bool isIndexed() const noexcept;
+  const index_entries_type& getIndexEntries() const noexcept;
+  /* All the entries with the given id, ignoring the case, in file order */
+  std::vector<const MutationMapIndexEntry*>
+  findIndexEntries(std::string_view transcriptId) const noexcept(false);
 
 private:
   void checkEofMarker() noexcept(false);
+  void checkFormat() noexcept(false);
   unsigned loadOtherTranscripts(unsigned n) noexcept(false);
+  void buildIdsLookup() noexcept(false);
 
-  static constexpr std::array<std::uint8_t, 7> eofMarker{
-      '\x5b', '\x6d', '\x6d', '\x65', '\x6f', '\x66', '\x5d'};
   std::string filename;
+  std::shared_ptr<const MappedFile> mappedFile;
+  std::streampos streamBeginPos = 0;
   std::streampos streamEndPos;
+  unsigned formatVersion = 1;
+  std::uint32_t blockReads = 0;
   transcripts_type transcripts;
+  index_entries_type indexEntries;
+  // Lower-case transcript id to positions in indexEntries
+  std::unordered_map<std::string, std::vector<std::size_t>> idsLookup;
 };
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "endianess.hpp"
+#include "mutation_map_transcript_read.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+/* Encoding of the reads in the version 2 of the mutation map format.
+ *
+ * A v2 file starts with a zero id length (which cannot appear in a v1 file),
+ * followed by a magic string, the format version and the maximum number of
+ * reads per block. Transcripts are stored as in v1 up to the number of reads,
+ * which is followed by the number of blocks, the byte size of each block and
+ * then the blocks themselves. The file still ends with the EOF marker.
+ *
+ * Every block can be decoded independently: it starts with the number of
+ * reads it contains, then for each read it stores the zigzag varint delta of
+ * the begin index from the previous read, the zigzag varint of the inclusive
+ * end minus the begin, the varint number of mutations, the zigzag varint delta
+ * of the first mutation from the begin and the varint deltas between the
+ * following (sorted) mutations. */
+namespace mutation_map_codec {
+
+static constexpr std::array<char, 6> magic{'[', 'm', 'm', 'v', '2', ']'};
+static constexpr std::uint16_t version = 2;
+static constexpr std::size_t headerSize =
+    sizeof(std::uint16_t) + magic.size() + sizeof(std::uint16_t) +
+    sizeof(std::uint32_t);
+static constexpr std::uint32_t defaultBlockReads = 4096;
+
+constexpr std::uint64_t
+zigzagEncode(std::int64_t value) noexcept {
+  return (static_cast<std::uint64_t>(value) << 1) ^
+         static_cast<std::uint64_t>(value >> 63);
+}
+
+constexpr std::int64_t
+zigzagDecode(std::uint64_t value) noexcept {
+  return static_cast<std::int64_t>(value >> 1) ^
+         -static_cast<std::int64_t>(value & 1);
+}
+
+inline void
+appendVarint(std::vector<char>& out, std::uint64_t value) noexcept(false) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+inline std::uint64_t
+readVarint(const char*& data, const char* end) noexcept(false) {
+  std::uint64_t value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (data == end)
+      throw std::runtime_error("truncated mutation map block");
+
+    auto const byte = static_cast<std::uint8_t>(*data++);
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return value;
+  }
+
+  throw std::runtime_error("invalid varint in mutation map block");
+}
+
+inline std::uint32_t
+readVarint32(const char*& data, const char* end) noexcept(false) {
+  auto const value = readVarint(data, end);
+  if (value > std::numeric_limits<std::uint32_t>::max())
+    throw std::runtime_error("out of range value in mutation map block");
+  return static_cast<std::uint32_t>(value);
+}
+
+inline std::uint32_t
+readZigzag32(const char*& data, const char* end,
+             std::int64_t base) noexcept(false) {
+  auto const value = base + zigzagDecode(readVarint(data, end));
+  if (value < 0 or value > std::numeric_limits<std::uint32_t>::max())
+    throw std::runtime_error("out of range value in mutation map block");
+  return static_cast<std::uint32_t>(value);
+}
+
+/* Encodes the reads in [begin, end) as a block. Reads follow the in-memory
+ * convention of MutationMapTranscriptRead, with an exclusive end. */
+template <typename Iter>
+void
+encodeBlock(std::vector<char>& out, Iter begin, Iter end) noexcept(false) {
+  std::vector<char> block;
+  appendVarint(block,
+               static_cast<std::uint64_t>(std::distance(begin, end)));
+
+  std::int64_t previousBegin = 0;
+  for (; begin != end; ++begin) {
+    auto&& read = *begin;
+    assert(read.end > read.begin);
+    auto const readBegin = static_cast<std::int64_t>(read.begin);
+    auto const readEnd = static_cast<std::int64_t>(read.end) - 1;
+
+    appendVarint(block, zigzagEncode(readBegin - previousBegin));
+    appendVarint(block, zigzagEncode(readEnd - readBegin));
+    previousBegin = readBegin;
+
+    auto&& indices = read.indices;
+    appendVarint(block, static_cast<std::uint64_t>(std::size(indices)));
+    std::int64_t previousIndex = readBegin;
+    bool first = true;
+    for (auto&& index : indices) {
+      auto const currentIndex = static_cast<std::int64_t>(index);
+      if (first) {
+        appendVarint(block, zigzagEncode(currentIndex - previousIndex));
+        first = false;
+      } else {
+        assert(currentIndex >= previousIndex);
+        appendVarint(block,
+                     static_cast<std::uint64_t>(currentIndex - previousIndex));
+      }
+      previousIndex = currentIndex;
+    }
+  }
+
+  out.insert(std::end(out), std::begin(block), std::end(block));
+}
+
+/* Sequentially decodes the reads of a single block */
+class BlockDecoder {
+public:
+  BlockDecoder() = default;
+  BlockDecoder(const char* data, std::size_t size) noexcept(false)
+      : position(data), end(data + size) {
+    reads = readVarint32(position, end);
+  }
+
+  unsigned
+  remainingReads() const noexcept {
+    return reads;
+  }
+
+  template <typename Read>
+  void
+  decodeRead(Read& read) noexcept(false) {
+    assert(reads > 0);
+    --reads;
+
+    auto const readBegin = readZigzag32(position, end, previousBegin);
+    auto const readEnd = readZigzag32(position, end, readBegin);
+    previousBegin = readBegin;
+    read.begin = readBegin;
+    read.end = readEnd + 1;
+
+    auto const nIndices = readVarint32(position, end);
+    read.indices.resize(nIndices);
+    std::int64_t previousIndex = readBegin;
+    for (std::uint32_t index = 0; index < nIndices; ++index) {
+      if (index == 0)
+        previousIndex = readZigzag32(position, end, previousIndex);
+      else
+        previousIndex += readVarint32(position, end);
+
+      if (previousIndex > std::numeric_limits<std::uint32_t>::max())
+        throw std::runtime_error("out of range value in mutation map block");
+      read.indices[index] = static_cast<unsigned>(previousIndex);
+    }
+  }
+
+  bool
+  finished() const noexcept {
+    return reads == 0 and position == end;
+  }
+
+private:
+  const char* position = nullptr;
+  const char* end = nullptr;
+  unsigned reads = 0;
+  std::int64_t previousBegin = 0;
+};
+
+} // namespace mutation_map_codec
@@ -2,19 +2,50 @@
 
 #include "mutation_map_index_entry.hpp"
 
+#include <array>
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <vector>
 
+/* Index of the transcripts inside a mutation map file.
+ *
+ * Two on-disk formats are handled. The legacy one, written by RNA Framework,
+ * is a plain sequence of (id, offset) pairs. The extended one starts with a
+ * zero id length (which cannot appear in a legacy index), followed by a magic
+ * string, a version, the size and modification time of the indexed MM file
+ * and the per-transcript read counts, sequence lengths, byte sizes and, for v1
+ * maps, the offsets of the chunks of reads decoded concurrently. It is
+ * written to a separate .mmi.draco file, so that the .mmi files of RNA
+ * Framework stay readable by it. */
 struct MutationMapIndex {
   using entries_type = std::vector<MutationMapIndexEntry>;
 
-  MutationMapIndex(std::string_view filename);
+  MutationMapIndex() = default;
+  MutationMapIndex(std::string_view filename) noexcept(false);
+
+  static MutationMapIndex build(std::string_view content,
+                                std::size_t dataBegin, std::size_t dataSize,
+                                unsigned formatVersion = 1) noexcept(false);
+  void completeEntries(std::string_view content, std::size_t dataSize) noexcept(
+      false);
+  void write(const std::string& filename) const noexcept(false);
+  bool isUpToDate(std::uint64_t mutationMapSize,
+                  std::int64_t mutationMapTime) const noexcept;
 
   entries_type entries;
+  bool extended = false;
+  std::uint64_t mutationMapSize = 0;
+  std::int64_t mutationMapTime = 0;
+
+  static constexpr std::array<char, 7> magic{'[', 'd', 'r', 'm', 'm', 'i',
+                                             ']'};
+  static constexpr std::uint16_t version = 2;
+  /* Number of reads between two chunk offsets of v1 maps */
+  static constexpr std::uint32_t chunkReads = 16384;
 
 private:
-  static entries_type readEntries(std::string_view filename);
+  void readEntries(std::string_view filename) noexcept(false);
 };
 
 #include "mutation_map_index_impl.hpp"
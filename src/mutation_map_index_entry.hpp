@@ -1,9 +1,18 @@
 #pragma once
 
+#include <cstdint>
 #include <ios>
 #include <string>
+#include <vector>
 
 struct MutationMapIndexEntry {
   std::string transcriptId;
   std::streampos offset;
+  unsigned reads = 0;
+  unsigned sequenceLength = 0;
+  // Size in bytes of the whole transcript record, header included
+  std::uint64_t size = 0;
+  /* Offsets of the reads starting a chunk of MutationMapIndex::chunkReads
+   * reads, the first one excluded. Only available for v1 maps. */
+  std::vector<std::uint64_t> chunkOffsets;
 };
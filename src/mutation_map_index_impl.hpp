@@ -3,8 +3,12 @@
 #include "mutation_map_index.hpp"
 
 #include "binary_stream.hpp"
+#include "endianess.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <numeric>
+#include <stdexcept>
 
 #if __has_include(<filesystem>)
 #include <filesystem>
@@ -15,29 +19,122 @@
 #endif
 #include <fstream>
 
-MutationMapIndex::MutationMapIndex(std::string_view filename)
-    : entries(readEntries(std::move(filename))) {}
+namespace detail {
 
-auto
-MutationMapIndex::readEntries(std::string_view filename) -> entries_type {
+struct MutationMapTranscriptHeader {
+  std::string_view id;
+  std::uint32_t sequenceLength;
+  std::uint32_t reads;
+  std::size_t readsOffset;
+};
+
+inline MutationMapTranscriptHeader
+readMutationMapTranscriptHeader(std::string_view content,
+                                std::size_t offset) noexcept(false) {
+  auto const checkSize = [&](std::size_t needed) {
+    if (offset + needed > content.size())
+      throw std::runtime_error("unexpected end of mutation map file");
+  };
+
+  MutationMapTranscriptHeader header;
+  checkSize(sizeof(std::uint16_t));
+  auto const idSizeWithTermination =
+      loadLittleEndian<std::uint16_t>(content.data() + offset);
+  if (idSizeWithTermination == 0)
+    throw std::runtime_error("invalid transcript id in mutation map file");
+  offset += sizeof(std::uint16_t);
+
+  checkSize(idSizeWithTermination + sizeof(std::uint32_t));
+  header.id = content.substr(offset, idSizeWithTermination - 1u);
+  offset += idSizeWithTermination;
+
+  header.sequenceLength =
+      loadLittleEndian<std::uint32_t>(content.data() + offset);
+  offset += sizeof(std::uint32_t) + (header.sequenceLength + 1u) / 2;
+
+  checkSize(sizeof(std::uint32_t));
+  header.reads = loadLittleEndian<std::uint32_t>(content.data() + offset);
+  header.readsOffset = offset + sizeof(std::uint32_t);
+
+  return header;
+}
+
+} // namespace detail
+
+inline MutationMapIndex::MutationMapIndex(std::string_view filename) noexcept(
+    false) {
+  readEntries(filename);
+}
+
+inline void
+MutationMapIndex::readEntries(std::string_view filename) noexcept(false) {
 #if __has_include(<filesystem>)
   namespace fs = std::filesystem;
 #else
   namespace fs = std::experimental::filesystem;
 #endif
 
-  std::ifstream indexStream{fs::path(filename)};
+  std::ifstream indexStream{fs::path(filename), std::ios::binary};
   BinaryStream<std::ifstream> binaryStream(indexStream);
-  entries_type entries;
+  entries.clear();
 
-  for (;;) {
-    std::uint16_t transcriptIdSize;
-    binaryStream >> transcriptIdSize;
-    if (not indexStream)
-      break;
+  std::uint16_t transcriptIdSize;
+  binaryStream >> transcriptIdSize;
+  if (not indexStream)
+    return;
 
+  if (transcriptIdSize == 0) {
+    std::decay_t<decltype(magic)> fileMagic;
+    indexStream.read(fileMagic.data(), fileMagic.size());
+    std::uint16_t fileVersion;
+    binaryStream >> fileVersion;
+    if (not indexStream or fileMagic != magic or fileVersion != version)
+      throw std::runtime_error("invalid mutation map index file");
+
+    std::uint64_t time;
+    std::uint64_t nEntries;
+    binaryStream >> mutationMapSize >> time >> nEntries;
+    mutationMapTime = static_cast<std::int64_t>(time);
+    extended = true;
+
+    entries.reserve(nEntries);
+    for (std::uint64_t entryIndex = 0; entryIndex < nEntries; ++entryIndex) {
+      binaryStream >> transcriptIdSize;
+      if (not indexStream or transcriptIdSize == 0)
+        throw std::runtime_error("truncated mutation map index file");
+
+      MutationMapIndexEntry entry;
+      entry.transcriptId.resize(transcriptIdSize - 1u);
+      indexStream.read(entry.transcriptId.data(), transcriptIdSize - 1);
+      indexStream.get();
+
+      std::uint64_t offset;
+      std::uint32_t reads;
+      std::uint32_t sequenceLength;
+      std::uint32_t nChunkOffsets;
+      binaryStream >> offset >> reads >> sequenceLength >> entry.size >>
+          nChunkOffsets;
+      if (not indexStream or nChunkOffsets > reads / chunkReads)
+        throw std::runtime_error("truncated mutation map index file");
+
+      entry.chunkOffsets.resize(nChunkOffsets);
+      for (auto& chunkOffset : entry.chunkOffsets)
+        binaryStream >> chunkOffset;
+      if (not indexStream)
+        throw std::runtime_error("truncated mutation map index file");
+
+      entry.offset = static_cast<std::streamoff>(offset);
+      entry.reads = reads;
+      entry.sequenceLength = sequenceLength;
+      entries.emplace_back(std::move(entry));
+    }
+
+    return;
+  }
+
+  for (;;) {
     MutationMapIndexEntry entry;
-    entry.transcriptId.resize(transcriptIdSize - 1);
+    entry.transcriptId.resize(transcriptIdSize - 1u);
     indexStream.read(entry.transcriptId.data(), transcriptIdSize - 1);
 
     {
@@ -49,7 +146,149 @@ MutationMapIndex::readEntries(std::string_view filename) -> entries_type {
     binaryStream >> offset;
     entry.offset = static_cast<std::streamoff>(offset);
     entries.emplace_back(std::move(entry));
+
+    binaryStream >> transcriptIdSize;
+    if (not indexStream)
+      break;
   }
+}
+
+inline MutationMapIndex
+MutationMapIndex::build(std::string_view content, std::size_t dataBegin,
+                        std::size_t dataSize,
+                        unsigned formatVersion) noexcept(false) {
+  assert(dataSize <= content.size());
+  content = content.substr(0, dataSize);
+
+  MutationMapIndex index;
+  std::size_t offset = dataBegin;
+  while (offset < content.size()) {
+    auto const header =
+        detail::readMutationMapTranscriptHeader(content, offset);
+
+    auto readOffset = header.readsOffset;
+    std::vector<std::uint64_t> chunkOffsets;
+    if (formatVersion == 1) {
+      chunkOffsets.reserve(header.reads == 0 ? 0
+                                              : (header.reads - 1) /
+                                                    chunkReads);
+      for (std::uint32_t readIndex = 0; readIndex < header.reads;
+           ++readIndex) {
+        if (readIndex != 0 and readIndex % chunkReads == 0)
+          chunkOffsets.push_back(readOffset);
+
+        readOffset += sizeof(std::uint32_t) * 2;
+        if (readOffset + sizeof(std::uint32_t) > content.size())
+          throw std::runtime_error("unexpected end of mutation map file");
+
+        auto const mutations =
+            loadLittleEndian<std::uint32_t>(content.data() + readOffset);
+        readOffset += sizeof(std::uint32_t) * (std::size_t(mutations) + 1);
+      }
+    } else {
+      if (readOffset + sizeof(std::uint32_t) > content.size())
+        throw std::runtime_error("unexpected end of mutation map file");
+
+      auto const nBlocks =
+          loadLittleEndian<std::uint32_t>(content.data() + readOffset);
+      readOffset += sizeof(std::uint32_t);
+      if (readOffset + sizeof(std::uint32_t) * nBlocks > content.size())
+        throw std::runtime_error("unexpected end of mutation map file");
+
+      std::size_t blocksSize = 0;
+      for (std::uint32_t blockIndex = 0; blockIndex < nBlocks; ++blockIndex) {
+        blocksSize +=
+            loadLittleEndian<std::uint32_t>(content.data() + readOffset);
+        readOffset += sizeof(std::uint32_t);
+      }
+      readOffset += blocksSize;
+    }
+    if (readOffset > content.size())
+      throw std::runtime_error("unexpected end of mutation map file");
+
+    MutationMapIndexEntry entry;
+    entry.transcriptId = std::string(header.id);
+    entry.offset = static_cast<std::streamoff>(offset);
+    entry.reads = header.reads;
+    entry.sequenceLength = header.sequenceLength;
+    entry.size = readOffset - offset;
+    entry.chunkOffsets = std::move(chunkOffsets);
+    index.entries.emplace_back(std::move(entry));
+
+    offset = readOffset;
+  }
+
+  index.extended = true;
+  return index;
+}
+
+inline void
+MutationMapIndex::completeEntries(std::string_view content,
+                                  std::size_t dataSize) noexcept(false) {
+  assert(dataSize <= content.size());
+  content = content.substr(0, dataSize);
+
+  std::vector<std::size_t> sortedIndices(entries.size());
+  std::iota(std::begin(sortedIndices), std::end(sortedIndices), 0);
+  std::sort(std::begin(sortedIndices), std::end(sortedIndices),
+            [&](std::size_t a, std::size_t b) {
+              return entries[a].offset < entries[b].offset;
+            });
+
+  for (std::size_t index = 0; index < sortedIndices.size(); ++index) {
+    auto& entry = entries[sortedIndices[index]];
+    auto const offset =
+        static_cast<std::size_t>(static_cast<std::streamoff>(entry.offset));
+    auto const header = detail::readMutationMapTranscriptHeader(content, offset);
+    entry.reads = header.reads;
+    entry.sequenceLength = header.sequenceLength;
+
+    auto const nextOffset =
+        index + 1 < sortedIndices.size()
+            ? static_cast<std::size_t>(static_cast<std::streamoff>(
+                  entries[sortedIndices[index + 1]].offset))
+            : content.size();
+    entry.size = nextOffset - offset;
+  }
+}
+
+inline void
+MutationMapIndex::write(const std::string& filename) const noexcept(false) {
+  assert(extended);
+
+  std::ofstream indexStream(filename, std::ios::binary | std::ios::trunc);
+  if (not indexStream)
+    throw std::runtime_error("cannot open '" + filename + "' for writing");
+
+  BinaryStream<std::ofstream> binaryStream(indexStream);
+  binaryStream << std::uint16_t(0);
+  indexStream.write(magic.data(), magic.size());
+  binaryStream << version << mutationMapSize
+               << static_cast<std::uint64_t>(mutationMapTime)
+               << static_cast<std::uint64_t>(entries.size());
+
+  for (auto&& entry : entries) {
+    binaryStream << static_cast<std::uint16_t>(entry.transcriptId.size() + 1);
+    indexStream.write(entry.transcriptId.data(),
+                      static_cast<std::streamsize>(entry.transcriptId.size()));
+    indexStream.put('\0');
+    binaryStream << static_cast<std::uint64_t>(
+                        static_cast<std::streamoff>(entry.offset))
+                 << static_cast<std::uint32_t>(entry.reads)
+                 << static_cast<std::uint32_t>(entry.sequenceLength)
+                 << entry.size
+                 << static_cast<std::uint32_t>(entry.chunkOffsets.size());
+    for (auto chunkOffset : entry.chunkOffsets)
+      binaryStream << chunkOffset;
+  }
+
+  if (not indexStream.flush())
+    throw std::runtime_error("cannot write '" + filename + "'");
+}
 
-  return entries;
+inline bool
+MutationMapIndex::isUpToDate(std::uint64_t mutationMapSize,
+                             std::int64_t mutationMapTime) const noexcept {
+  return extended and this->mutationMapSize == mutationMapSize and
+         this->mutationMapTime == mutationMapTime;
 }
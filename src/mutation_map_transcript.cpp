@@ -1,39 +1,68 @@
 #include "mutation_map_transcript.hpp"
+#include "mapped_stream.hpp"
 #include "mutation_map.hpp"
+#include "mutation_map_index.hpp"
 
 #include <range/v3/algorithm.hpp>
 #include <range/v3/view.hpp>
 
+#include <algorithm>
 #include <cassert>
 
 MutationMapTranscript::MutationMapTranscript(
     const MutationMap& mutationMap, std::streampos offset) noexcept(false)
-    : mutationMap(&mutationMap), endOffset(-1),
-      iteratorStream(mutationMap.getFilename()) {
+    : mutationMap(&mutationMap), endOffset(-1) {
   assert(offset >= 0);
-  iteratorStream.seekg(offset);
-  BinaryStream<std::ifstream> binaryStream(iteratorStream);
+  if (mutationMap.isMemoryMapped()) {
+    MappedStream mappedStream(mutationMap.getMappedContent());
+    mappedStream.seekg(offset);
+    readHeader(mappedStream);
+    startOffset = mappedStream.tellg();
+  } else {
+    iteratorStream.open(mutationMap.getFilename());
+    iteratorStream.seekg(offset);
+    readHeader(iteratorStream);
+    startOffset = iteratorStream.tellg();
+    iteratorStream.close();
+  }
+}
+
+MutationMapTranscript::MutationMapTranscript(
+    const MutationMap& mutationMap,
+    const MutationMapIndexEntry& indexEntry) noexcept(false)
+    : MutationMapTranscript(mutationMap, indexEntry.offset) {
+  this->indexEntry = &indexEntry;
+}
+
+template <typename Stream>
+void
+MutationMapTranscript::readHeader(Stream& stream) noexcept(false) {
+  BinaryStream<Stream> binaryStream(stream);
   {
-    std::uint16_t idSizeWithTermination;
+    std::uint16_t idSizeWithTermination = 0;
     binaryStream >> idSizeWithTermination;
+    if (not stream)
+      throw std::runtime_error("unexpected end of mutation map file");
     assert(idSizeWithTermination > 0);
 
     id.resize(idSizeWithTermination - 1);
-    iteratorStream.read(id.data(), idSizeWithTermination - 1);
+    stream.read(id.data(), idSizeWithTermination - 1);
     {
-      [[maybe_unused]] int c = iteratorStream.get();
+      [[maybe_unused]] int c = stream.get();
       assert(c == 0);
     }
   }
 
   {
-    std::uint32_t nBases;
+    std::uint32_t nBases = 0;
     binaryStream >> nBases;
+    if (not stream)
+      throw std::runtime_error("unexpected end of mutation map file");
     assert(nBases > 0);
 
     sequence.resize(nBases);
     std::vector<char> rawSequence((nBases + 1) / 2);
-    iteratorStream.read(rawSequence.data(), (nBases + 1) / 2);
+    stream.read(rawSequence.data(), (nBases + 1) / 2);
 
     auto baseIter = ranges::begin(sequence);
     for (unsigned baseIndex = 0; baseIndex < (nBases + 1) / 2; ++baseIndex) {
@@ -60,13 +89,12 @@ MutationMapTranscript::MutationMapTranscript(
   }
 
   {
-    std::uint32_t nReads;
+    std::uint32_t nReads = 0;
     binaryStream >> nReads;
+    if (not stream)
+      throw std::runtime_error("unexpected end of mutation map file");
     reads = nReads;
   }
-
-  startOffset = iteratorStream.tellg();
-  iteratorStream.close();
 }
 
 MutationMapTranscript::MutationMapTranscript(
@@ -77,7 +105,8 @@ MutationMapTranscript::MutationMapTranscript(
 
 MutationMapTranscript::MutationMapTranscript(
     const MutationMapTranscript& other) noexcept
-    : mutationMap(other.mutationMap), id(other.id), sequence(other.sequence),
+    : mutationMap(other.mutationMap), indexEntry(other.indexEntry),
+      id(other.id), sequence(other.sequence),
       reads(other.reads), startOffset(other.startOffset),
       endOffset(other.endOffset) {}
 
@@ -96,6 +125,7 @@ operator=(const MutationMapTranscript& other) noexcept(false) {
     iteratorStream.close();
 
   mutationMap = other.mutationMap;
+  indexEntry = other.indexEntry;
   id = other.id;
   sequence = other.sequence;
   reads = other.reads;
@@ -167,6 +197,28 @@ MutationMapTranscript::getFilename() const noexcept {
   return mutationMap->getFilename();
 }
 
+bool
+MutationMapTranscript::isMemoryMapped() const noexcept {
+  return mutationMap != nullptr and mutationMap->isMemoryMapped();
+}
+
+std::string_view
+MutationMapTranscript::getMappedContent() const noexcept {
+  assert(mutationMap);
+  return mutationMap->getMappedContent();
+}
+
+unsigned
+MutationMapTranscript::getFormatVersion() const noexcept {
+  assert(mutationMap);
+  return mutationMap->getFormatVersion();
+}
+
+bool
+MutationMapTranscript::hasReadViews() const noexcept {
+  return isMemoryMapped() and getFormatVersion() == 1;
+}
+
 auto
 MutationMapTranscript::begin() const noexcept(false) -> const_iterator {
   return const_iterator(*this);
@@ -177,6 +229,17 @@ MutationMapTranscript::end() const noexcept -> const_iterator {
   return const_iterator(*this, MutationMapTranscriptEndTag{});
 }
 
+auto
+MutationMapTranscript::views() const noexcept(false)
+    -> ranges::subrange<view_iterator> {
+  if (not hasReadViews())
+    throw std::runtime_error("read views are only available for "
+                             "memory-mapped v1 mutation maps");
+
+  return {view_iterator(*this),
+          view_iterator(*this, MutationMapTranscriptEndTag{})};
+}
+
 void
 MutationMapTranscript::reopenStream() const noexcept(false) {
   if (not iteratorStream.is_open()) {
@@ -196,22 +259,171 @@ MutationMapTranscript::skip() const noexcept(false) {
   if (endOffset != -1) {
     if (iteratorStream.is_open())
       iteratorStream.close();
+  } else if (isMemoryMapped()) {
+    auto const content = getMappedContent();
+    auto position = static_cast<std::size_t>(
+        static_cast<std::streamoff>(startOffset));
+    if (getFormatVersion() == 1) {
+      for (unsigned readIndex = 0; readIndex < reads; ++readIndex) {
+        position += sizeof(std::uint32_t) * 2;
+        if (position + sizeof(std::uint32_t) > content.size())
+          throw std::runtime_error("unexpected end of mutation map file");
+        auto const mutations =
+            loadLittleEndian<std::uint32_t>(content.data() + position);
+        position += sizeof(std::uint32_t) * (mutations + 1);
+        if (position > content.size())
+          throw std::runtime_error("unexpected end of mutation map file");
+      }
+    } else {
+      if (position + sizeof(std::uint32_t) > content.size())
+        throw std::runtime_error("unexpected end of mutation map file");
+      auto const nBlocks =
+          loadLittleEndian<std::uint32_t>(content.data() + position);
+      position += sizeof(std::uint32_t);
+      if (position + sizeof(std::uint32_t) * nBlocks > content.size())
+        throw std::runtime_error("unexpected end of mutation map file");
+
+      std::size_t blocksSize = 0;
+      for (std::uint32_t blockIndex = 0; blockIndex < nBlocks; ++blockIndex) {
+        blocksSize +=
+            loadLittleEndian<std::uint32_t>(content.data() + position);
+        position += sizeof(std::uint32_t);
+      }
+      position += blocksSize;
+    }
+    if (position > content.size())
+      throw std::runtime_error("unexpected end of mutation map file");
+    endOffset = static_cast<std::streamoff>(position);
   } else {
     reopenStream();
     iteratorStream.seekg(startOffset);
     BinaryStream<std::decay_t<decltype(iteratorStream)>> binaryStream(
         iteratorStream);
-    for (unsigned readIndex = 0; readIndex < reads; ++readIndex) {
-      iteratorStream.seekg(sizeof(std::uint32_t) * 2, std::ios::cur);
-      std::uint32_t mutations;
-      binaryStream >> mutations;
-      iteratorStream.seekg(sizeof(std::uint32_t) * mutations, std::ios::cur);
+    if (getFormatVersion() == 1) {
+      for (unsigned readIndex = 0; readIndex < reads; ++readIndex) {
+        iteratorStream.seekg(sizeof(std::uint32_t) * 2, std::ios::cur);
+        std::uint32_t mutations;
+        binaryStream >> mutations;
+        iteratorStream.seekg(sizeof(std::uint32_t) * mutations,
+                             std::ios::cur);
+      }
+    } else {
+      std::uint32_t nBlocks;
+      binaryStream >> nBlocks;
+      std::streamoff blocksSize = 0;
+      for (std::uint32_t blockIndex = 0; blockIndex < nBlocks; ++blockIndex) {
+        std::uint32_t blockSize;
+        binaryStream >> blockSize;
+        blocksSize += blockSize;
+      }
+      iteratorStream.seekg(blocksSize, std::ios::cur);
     }
     endOffset = iteratorStream.tellg();
     iteratorStream.close();
   }
 }
 
+std::vector<MutationMapTranscriptChunk>
+MutationMapTranscript::chunks(unsigned readsPerChunk) const noexcept(false) {
+  if (not isMemoryMapped())
+    throw std::runtime_error("read chunks are only available for "
+                             "memory-mapped mutation maps");
+  assert(readsPerChunk > 0);
+
+  auto const content = getMappedContent();
+  auto position =
+      static_cast<std::size_t>(static_cast<std::streamoff>(startOffset));
+  std::vector<MutationMapTranscriptChunk> out;
+
+  auto const indexedChunks = [&] {
+    return indexEntry != nullptr and
+           readsPerChunk % MutationMapIndex::chunkReads == 0 and
+           indexEntry->chunkOffsets.size() ==
+               (reads == 0 ? 0 : (reads - 1) / MutationMapIndex::chunkReads);
+  };
+
+  if (getFormatVersion() == 1 and indexedChunks()) {
+    auto const transcriptEnd =
+        static_cast<std::size_t>(
+            static_cast<std::streamoff>(indexEntry->offset)) +
+        static_cast<std::size_t>(indexEntry->size);
+    auto const readOffset = [&](unsigned readIndex) -> std::size_t {
+      if (readIndex == 0)
+        return position;
+      else if (readIndex >= reads)
+        return transcriptEnd;
+      else
+        return static_cast<std::size_t>(
+            indexEntry->chunkOffsets[readIndex / MutationMapIndex::chunkReads -
+                                     1]);
+    };
+
+    out.reserve((reads + readsPerChunk - 1) / readsPerChunk);
+    for (unsigned readIndex = 0; readIndex < reads;
+         readIndex += readsPerChunk) {
+      auto const chunkReads = std::min(readsPerChunk, reads - readIndex);
+      auto const chunkBegin = readOffset(readIndex);
+      auto const chunkEnd = readOffset(readIndex + chunkReads);
+      if (chunkBegin > chunkEnd or chunkEnd > content.size())
+        throw std::runtime_error("invalid mutation map index file");
+      out.push_back({chunkBegin, chunkEnd - chunkBegin, readIndex, chunkReads});
+    }
+    position = transcriptEnd;
+  } else if (getFormatVersion() == 1) {
+    out.reserve((reads + readsPerChunk - 1) / readsPerChunk);
+    for (unsigned readIndex = 0; readIndex < reads;) {
+      MutationMapTranscriptChunk chunk{position, 0, readIndex,
+                                       std::min(readsPerChunk,
+                                                reads - readIndex)};
+      for (unsigned chunkRead = 0; chunkRead < chunk.reads; ++chunkRead) {
+        position += sizeof(std::uint32_t) * 2;
+        if (position + sizeof(std::uint32_t) > content.size())
+          throw std::runtime_error("unexpected end of mutation map file");
+        auto const mutations =
+            loadLittleEndian<std::uint32_t>(content.data() + position);
+        position += sizeof(std::uint32_t) * (mutations + 1);
+        if (position > content.size())
+          throw std::runtime_error("unexpected end of mutation map file");
+      }
+      chunk.size = position - chunk.offset;
+      readIndex += chunk.reads;
+      out.push_back(chunk);
+    }
+  } else {
+    if (position + sizeof(std::uint32_t) > content.size())
+      throw std::runtime_error("unexpected end of mutation map file");
+    auto const nBlocks =
+        loadLittleEndian<std::uint32_t>(content.data() + position);
+    position += sizeof(std::uint32_t);
+    if (position + sizeof(std::uint32_t) * nBlocks > content.size())
+      throw std::runtime_error("unexpected end of mutation map file");
+
+    auto blockOffset = position + sizeof(std::uint32_t) * nBlocks;
+    auto const blockReads = mutationMap->getBlockReads();
+    /* A short block table would leave the last reads undecoded */
+    if (nBlocks != (std::uint64_t{reads} + blockReads - 1) / blockReads)
+      throw std::runtime_error("invalid mutation map block");
+
+    out.reserve(nBlocks);
+    for (std::uint32_t blockIndex = 0; blockIndex < nBlocks; ++blockIndex) {
+      auto const blockSize =
+          loadLittleEndian<std::uint32_t>(content.data() + position);
+      position += sizeof(std::uint32_t);
+
+      auto const firstRead = blockIndex * blockReads;
+      out.push_back({blockOffset, blockSize, firstRead,
+                     std::min(blockReads, reads - firstRead)});
+      blockOffset += blockSize;
+    }
+    position = blockOffset;
+  }
+
+  if (position > content.size())
+    throw std::runtime_error("unexpected end of mutation map file");
+  endOffset = static_cast<std::streamoff>(position);
+  return out;
+}
+
 std::array<std::vector<std::size_t>, 2>
 MutationMapTranscript::calculateMutationsAndCoverage() const noexcept(false) {
   const std::size_t sequenceSize = getSequence().size();
@@ -231,3 +443,4 @@ MutationMapTranscript::calculateMutationsAndCoverage() const noexcept(false) {
 }
 
 static_assert(ranges::InputIterator<MutationMapTranscript::const_iterator>);
+static_assert(ranges::ForwardIterator<MutationMapTranscript::view_iterator>);
@@ -1,17 +1,24 @@
 #pragma once
 
+#include "mutation_map_transcript_chunk.hpp"
 #include "mutation_map_transcript_iterator.hpp"
+#include "mutation_map_transcript_view_iterator.hpp"
 #include "nostd/type_traits.hpp"
 
 #include <fstream>
 #include <functional>
+#include <range/v3/view/subrange.hpp>
 #include <string>
+#include <string_view>
+#include <vector>
 
 class MutationMap;
+struct MutationMapIndexEntry;
 
 class MutationMapTranscript {
 public:
   using const_iterator = MutationMapTranscriptIterator<std::ifstream>;
+  using view_iterator = MutationMapTranscriptViewIterator;
 
   MutationMapTranscript() = default;
   MutationMapTranscript(const MutationMap& mutationMap, const std::string& id,
@@ -19,6 +26,10 @@ public:
   explicit MutationMapTranscript(
       const MutationMap& mutationMap,
       std::streampos startOffset = 0) noexcept(false);
+  /* The entry, which must outlive the transcript, provides the chunk offsets
+   */
+  MutationMapTranscript(const MutationMap& mutationMap,
+                        const MutationMapIndexEntry& indexEntry) noexcept(false);
 
   MutationMapTranscript(const MutationMapTranscript& other) noexcept;
   MutationMapTranscript(MutationMapTranscript&&) = default;
@@ -41,15 +52,32 @@ public:
   void setEndOffset(const std::streampos& value) const noexcept(false);
   std::streampos getEndOffset() const noexcept;
   const std::string& getFilename() const noexcept;
+  bool isMemoryMapped() const noexcept;
+  std::string_view getMappedContent() const noexcept;
+  unsigned getFormatVersion() const noexcept;
+  bool hasReadViews() const noexcept;
 
   void skip() const noexcept(false);
   std::ifstream& getStream() const noexcept(false);
 
   const_iterator begin() const noexcept(false);
   const_iterator end() const noexcept;
+  ranges::subrange<view_iterator> views() const noexcept(false);
+
+  /* Splits the reads of a memory-mapped transcript in chunks that can be
+   * decoded concurrently. v2 maps use their blocks, v1 maps are split every
+   * readsPerChunk reads, using the chunk offsets of the index entry when
+   * readsPerChunk is a multiple of MutationMapIndex::chunkReads and scanning
+   * the read headers otherwise. */
+  std::vector<MutationMapTranscriptChunk>
+  chunks(unsigned readsPerChunk) const noexcept(false);
+  template <typename Function>
+  void forEachChunkRead(const MutationMapTranscriptChunk& chunk,
+                        Function&& function) const noexcept(false);
 
 private:
   const MutationMap* mutationMap;
+  const MutationMapIndexEntry* indexEntry = nullptr;
   std::string id;
   std::string sequence;
   unsigned reads;
@@ -58,6 +86,10 @@ private:
   mutable std::ifstream iteratorStream;
 
   void reopenStream() const noexcept(false);
+  template <typename Stream>
+  void readHeader(Stream& stream) noexcept(false);
 };
 
+#include "mutation_map_transcript_impl.hpp"
 #include "mutation_map_transcript_iterator_impl.hpp"
+#include "mutation_map_transcript_view_iterator_impl.hpp"
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+/* A contiguous range of reads of a memory-mapped transcript that can be
+ * decoded independently from the others. The offset is relative to the
+ * beginning of the mapped file. */
+struct MutationMapTranscriptChunk {
+  std::size_t offset;
+  std::size_t size;
+  unsigned firstRead;
+  unsigned reads;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "mutation_map_codec.hpp"
+#include "mutation_map_transcript.hpp"
+#include "mutation_map_transcript_read.hpp"
+#include "mutation_map_transcript_read_view.hpp"
+#include "mutation_map_transcript_view_iterator_impl.hpp"
+
+#include <cassert>
+
+template <typename Function>
+void
+MutationMapTranscript::forEachChunkRead(const MutationMapTranscriptChunk& chunk,
+                                        Function&& function) const
+    noexcept(false) {
+  assert(isMemoryMapped());
+  auto const content = getMappedContent();
+  assert(chunk.offset + chunk.size <= content.size());
+  const char* position = content.data() + chunk.offset;
+  const char* const chunkEnd = position + chunk.size;
+
+  if (getFormatVersion() == 1) {
+    MutationMapTranscriptReadView read{};
+    for (unsigned readIndex = 0; readIndex < chunk.reads; ++readIndex) {
+      detail::loadMutationMapTranscriptReadView(position, chunkEnd, read);
+      function(chunk.firstRead + readIndex, read);
+    }
+    assert(position == chunkEnd);
+  } else {
+    mutation_map_codec::BlockDecoder decoder(position, chunk.size);
+    if (decoder.remainingReads() != chunk.reads)
+      throw std::runtime_error("invalid mutation map block");
+
+    MutationMapTranscriptRead read;
+    for (unsigned readIndex = 0; readIndex < chunk.reads; ++readIndex) {
+      decoder.decodeRead(read);
+      function(chunk.firstRead + readIndex, read);
+    }
+    if (not decoder.finished())
+      throw std::runtime_error("invalid mutation map block");
+  }
+}
@@ -2,11 +2,14 @@
 
 struct MutationMapTranscriptEndTag {};
 
+#include "mutation_map_codec.hpp"
 #include "mutation_map_transcript_read.hpp"
 
+#include <cstdint>
 #include <ios>
 #include <limits>
 #include <range/v3/core.hpp>
+#include <vector>
 
 class MutationMap;
 class MutationMapTranscript;
@@ -42,8 +45,15 @@ public:
 
 private:
   void nextRead() noexcept(false);
+  void nextBlockRead() noexcept(false);
 
   const MutationMapTranscript* mutationMapTranscript = nullptr;
   unsigned index = std::numeric_limits<unsigned>::max();
   value_type currentRead;
+
+  // Only used for block-compressed (v2) mutation maps
+  std::vector<std::uint32_t> blockSizes;
+  std::size_t blockIndex = 0;
+  std::vector<char> blockBuffer;
+  mutation_map_codec::BlockDecoder blockDecoder;
 };
@@ -6,6 +6,7 @@
 
 #include <cassert>
 #include <range/v3/algorithm.hpp>
+#include <stdexcept>
 
 template <typename Stream>
 MutationMapTranscriptIterator<Stream>::MutationMapTranscriptIterator(
@@ -26,15 +27,22 @@ MutationMapTranscriptIterator<Stream>::MutationMapTranscriptIterator(
     }
 
     nextRead();
-  } else {
+  } else if (this->mutationMapTranscript->getFormatVersion() == 1) {
     this->mutationMapTranscript->setEndOffset(
         this->mutationMapTranscript->getStream().tellg());
+  } else {
+    this->mutationMapTranscript->skip();
   }
 }
 
 template <typename Stream>
 void
 MutationMapTranscriptIterator<Stream>::nextRead() noexcept(false) {
+  if (mutationMapTranscript->getFormatVersion() != 1) {
+    nextBlockRead();
+    return;
+  }
+
   auto& stream = mutationMapTranscript->getStream();
   BinaryStream<Stream> binaryStream(stream);
   {
@@ -65,6 +73,41 @@ MutationMapTranscriptIterator<Stream>::nextRead() noexcept(false) {
   }
 }
 
+template <typename Stream>
+void
+MutationMapTranscriptIterator<Stream>::nextBlockRead() noexcept(false) {
+  if (blockDecoder.remainingReads() == 0) {
+    auto& stream = mutationMapTranscript->getStream();
+    BinaryStream<Stream> binaryStream(stream);
+    if (blockIndex == 0) {
+      std::uint32_t nBlocks;
+      binaryStream >> nBlocks;
+      blockSizes.resize(nBlocks);
+      for (auto& blockSize : blockSizes)
+        binaryStream >> blockSize;
+    }
+
+    do {
+      if (blockIndex >= blockSizes.size())
+        throw std::runtime_error(
+            "mutation map blocks contain less reads than expected");
+
+      auto const blockSize = blockSizes[blockIndex++];
+      blockBuffer.resize(blockSize);
+      stream.read(blockBuffer.data(), blockSize);
+      if (not stream)
+        throw std::runtime_error("unexpected end of mutation map file");
+      blockDecoder =
+          mutation_map_codec::BlockDecoder(blockBuffer.data(), blockSize);
+    } while (blockDecoder.remainingReads() == 0);
+  }
+
+  blockDecoder.decodeRead(currentRead);
+  assert(currentRead.begin <= mutationMapTranscript->getSequence().size());
+  assert(currentRead.end <= mutationMapTranscript->getSequence().size() + 1);
+  assert(ranges::is_sorted(currentRead.indices));
+}
+
 template <typename Stream>
 auto MutationMapTranscriptIterator<Stream>::operator*() const noexcept
     -> reference {
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "little_endian_span.hpp"
+#include "mutation_map_transcript_read.hpp"
+
+#include <cstdint>
+#include <type_traits>
+
+/* Non-owning counterpart of MutationMapTranscriptRead, pointing directly into
+ * a memory-mapped mutation map file */
+struct MutationMapTranscriptReadView {
+  unsigned begin;
+  unsigned end;
+  LittleEndianSpan<std::uint32_t> indices;
+};
+
+template <typename T>
+struct is_mutation_map_transcript_read : std::false_type {};
+
+template <>
+struct is_mutation_map_transcript_read<MutationMapTranscriptRead>
+    : std::true_type {};
+
+template <>
+struct is_mutation_map_transcript_read<MutationMapTranscriptReadView>
+    : std::true_type {};
+
+template <typename T>
+constexpr bool is_mutation_map_transcript_read_v =
+    is_mutation_map_transcript_read<std::decay_t<T>>::value;
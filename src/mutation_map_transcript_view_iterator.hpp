@@ -0,0 +1,47 @@
+#pragma once
+
+#include "mutation_map_transcript_iterator.hpp"
+#include "mutation_map_transcript_read_view.hpp"
+
+#include <cstddef>
+#include <limits>
+#include <range/v3/core.hpp>
+
+class MutationMapTranscript;
+
+/* Iterates the reads of a transcript from a memory-mapped mutation map without
+ * copying any data: each read exposes the mutated indices as a view over the
+ * mapped file. */
+class MutationMapTranscriptViewIterator {
+public:
+  using value_type = MutationMapTranscriptReadView;
+  using reference = value_type const&;
+  using pointer = value_type const*;
+  using iterator_category = ranges::forward_iterator_tag;
+  using difference_type = std::ptrdiff_t;
+
+  using self = MutationMapTranscriptViewIterator;
+
+  MutationMapTranscriptViewIterator() = default;
+  MutationMapTranscriptViewIterator(
+      const MutationMapTranscript& mutationMapTranscript,
+      MutationMapTranscriptEndTag) noexcept;
+  explicit MutationMapTranscriptViewIterator(
+      const MutationMapTranscript& mutationMapTranscript) noexcept(false);
+
+  reference operator*() const noexcept;
+  pointer operator->() const noexcept;
+  self& operator++() noexcept(false);
+  self operator++(int) noexcept(false);
+  difference_type operator-(const self& other) const noexcept;
+  bool operator==(const self& other) const noexcept;
+  bool operator!=(const self& other) const noexcept;
+
+private:
+  void nextRead() noexcept(false);
+
+  const MutationMapTranscript* mutationMapTranscript = nullptr;
+  const char* position = nullptr;
+  unsigned index = std::numeric_limits<unsigned>::max();
+  value_type currentRead{};
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "endianess.hpp"
+#include "mutation_map_transcript.hpp"
+#include "mutation_map_transcript_view_iterator.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <range/v3/algorithm.hpp>
+#include <stdexcept>
+
+inline MutationMapTranscriptViewIterator::MutationMapTranscriptViewIterator(
+    const MutationMapTranscript& mutationMapTranscript,
+    MutationMapTranscriptEndTag) noexcept
+    : mutationMapTranscript(&mutationMapTranscript),
+      index(mutationMapTranscript.getReadsSize()) {}
+
+inline MutationMapTranscriptViewIterator::MutationMapTranscriptViewIterator(
+    const MutationMapTranscript& mutationMapTranscript) noexcept(false)
+    : mutationMapTranscript(&mutationMapTranscript), index(0) {
+  auto const content = mutationMapTranscript.getMappedContent();
+  assert(content.data() != nullptr);
+  position = content.data() +
+             static_cast<std::streamoff>(mutationMapTranscript.getStartOffset());
+
+  if (index < mutationMapTranscript.getReadsSize())
+    nextRead();
+  else
+    mutationMapTranscript.setEndOffset(
+        static_cast<std::streamoff>(position - content.data()));
+}
+
+namespace detail {
+
+/* Loads the read starting at position, which is moved past it. Throws if the
+ * read does not end before contentEnd. */
+inline void
+loadMutationMapTranscriptReadView(const char*& position,
+                                  const char* contentEnd,
+                                  MutationMapTranscriptReadView& read) noexcept(
+    false) {
+  assert(position <= contentEnd);
+  if (static_cast<std::size_t>(contentEnd - position) <
+      sizeof(std::uint32_t) * 3)
+    throw std::runtime_error("unexpected end of mutation map file");
+
+  read.begin = loadLittleEndian<std::uint32_t>(position);
+  position += sizeof(std::uint32_t);
+
+  read.end = loadLittleEndian<std::uint32_t>(position) + 1;
+  position += sizeof(std::uint32_t);
+
+  auto const nIndices = loadLittleEndian<std::uint32_t>(position);
+  position += sizeof(std::uint32_t);
+  if (static_cast<std::size_t>(contentEnd - position) / sizeof(std::uint32_t) <
+      nIndices)
+    throw std::runtime_error("unexpected end of mutation map file");
+  read.indices = LittleEndianSpan<std::uint32_t>(position, nIndices);
+  position += sizeof(std::uint32_t) * nIndices;
+
+  assert(ranges::is_sorted(read.indices));
+}
+
+} // namespace detail
+
+inline void
+MutationMapTranscriptViewIterator::nextRead() noexcept(false) {
+  auto const content = mutationMapTranscript->getMappedContent();
+  detail::loadMutationMapTranscriptReadView(
+      position, content.data() + content.size(), currentRead);
+  assert(currentRead.begin <= mutationMapTranscript->getSequence().size());
+  assert(currentRead.end <= mutationMapTranscript->getSequence().size() + 1);
+}
+
+inline auto MutationMapTranscriptViewIterator::operator*() const noexcept
+    -> reference {
+  assert(index < mutationMapTranscript->getReadsSize());
+  return currentRead;
+}
+
+inline auto MutationMapTranscriptViewIterator::operator-> () const noexcept
+    -> pointer {
+  assert(index < mutationMapTranscript->getReadsSize());
+  return &currentRead;
+}
+
+inline auto
+MutationMapTranscriptViewIterator::operator++() noexcept(false) -> self& {
+  if (++index < mutationMapTranscript->getReadsSize())
+    nextRead();
+  else
+    mutationMapTranscript->setEndOffset(static_cast<std::streamoff>(
+        position - mutationMapTranscript->getMappedContent().data()));
+
+  return *this;
+}
+
+inline auto
+MutationMapTranscriptViewIterator::operator++(int) noexcept(false) -> self {
+  auto copy = *this;
+  operator++();
+  return copy;
+}
+
+inline auto
+MutationMapTranscriptViewIterator::operator-(const self& other) const noexcept
+    -> difference_type {
+  return static_cast<difference_type>(index) -
+         static_cast<difference_type>(other.index);
+}
+
+inline bool
+MutationMapTranscriptViewIterator::operator==(const self& other) const
+    noexcept {
+  return index == other.index;
+}
+
+inline bool
+MutationMapTranscriptViewIterator::operator!=(const self& other) const
+    noexcept {
+  return index != other.index;
+}
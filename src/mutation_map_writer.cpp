@@ -0,0 +1,136 @@
+#include "mutation_map_writer.hpp"
+
+#include "binary_stream.hpp"
+#include "mutation_map.hpp"
+#include "mutation_map_transcript.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+
+MutationMapWriter::MutationMapWriter(const std::string& filename,
+                                     unsigned formatVersion,
+                                     std::uint32_t blockReads) noexcept(false)
+    : filename(filename),
+      stream(filename, std::ios::binary bitor std::ios::trunc),
+      formatVersion(formatVersion), blockReads(blockReads) {
+  if (not stream)
+    throw std::runtime_error("cannot open '" + filename + "' for writing");
+  if (formatVersion != 1 and formatVersion != mutation_map_codec::version)
+    throw std::runtime_error("unsupported mutation map format version");
+  if (blockReads == 0)
+    throw std::runtime_error("the number of reads per block must be positive");
+
+  if (formatVersion == mutation_map_codec::version) {
+    BinaryStream<std::ofstream> binaryStream(stream);
+    binaryStream << std::uint16_t(0);
+    stream.write(mutation_map_codec::magic.data(),
+                 mutation_map_codec::magic.size());
+    binaryStream << mutation_map_codec::version << blockReads;
+  }
+}
+
+void
+MutationMapWriter::writeTranscriptHeader(
+    const MutationMapTranscript& transcript) noexcept(false) {
+  BinaryStream<std::ofstream> binaryStream(stream);
+  auto&& id = transcript.getId();
+  binaryStream << static_cast<std::uint16_t>(id.size() + 1);
+  stream.write(id.data(), static_cast<std::streamsize>(id.size()));
+  stream.put('\0');
+
+  auto&& sequence = transcript.getSequence();
+  binaryStream << static_cast<std::uint32_t>(sequence.size());
+  std::vector<char> rawSequence((sequence.size() + 1) / 2, 0);
+  for (std::size_t baseIndex = 0; baseIndex < sequence.size(); ++baseIndex) {
+    char code;
+    switch (sequence[baseIndex]) {
+    case 'A':
+      code = 0;
+      break;
+    case 'C':
+      code = 1;
+      break;
+    case 'G':
+      code = 2;
+      break;
+    case 'T':
+      code = 3;
+      break;
+    default:
+      code = 4;
+      break;
+    }
+
+    rawSequence[baseIndex / 2] = static_cast<char>(
+        rawSequence[baseIndex / 2] | (code << ((1 - baseIndex % 2) * 4)));
+  }
+  stream.write(rawSequence.data(),
+               static_cast<std::streamsize>(rawSequence.size()));
+
+  binaryStream << static_cast<std::uint32_t>(transcript.getReadsSize());
+}
+
+void
+MutationMapWriter::addTranscript(
+    const MutationMapTranscript& transcript) noexcept(false) {
+  assert(not finished);
+  writeTranscriptHeader(transcript);
+
+  BinaryStream<std::ofstream> binaryStream(stream);
+  if (formatVersion == 1) {
+    for (auto&& read : transcript) {
+      assert(read.end > read.begin);
+      binaryStream << static_cast<std::uint32_t>(read.begin)
+                   << static_cast<std::uint32_t>(read.end - 1)
+                   << static_cast<std::uint32_t>(read.indices.size());
+      for (auto index : read.indices)
+        binaryStream << static_cast<std::uint32_t>(index);
+    }
+  } else {
+    std::vector<std::uint32_t> blockSizes;
+    std::vector<char> blocks;
+    std::vector<MutationMapTranscriptRead> blockReadsBuffer;
+    blockReadsBuffer.reserve(
+        std::min<std::size_t>(blockReads, transcript.getReadsSize()));
+
+    auto const flushBlock = [&] {
+      auto const blockBegin = blocks.size();
+      mutation_map_codec::encodeBlock(blocks, std::begin(blockReadsBuffer),
+                                      std::end(blockReadsBuffer));
+      blockSizes.emplace_back(
+          static_cast<std::uint32_t>(blocks.size() - blockBegin));
+      blockReadsBuffer.clear();
+    };
+
+    for (auto&& read : transcript) {
+      blockReadsBuffer.emplace_back(read);
+      if (blockReadsBuffer.size() == blockReads)
+        flushBlock();
+    }
+    if (not blockReadsBuffer.empty())
+      flushBlock();
+
+    binaryStream << static_cast<std::uint32_t>(blockSizes.size());
+    for (auto blockSize : blockSizes)
+      binaryStream << blockSize;
+    stream.write(blocks.data(), static_cast<std::streamsize>(blocks.size()));
+  }
+
+  if (not stream)
+    throw std::runtime_error("cannot write '" + filename + "'");
+}
+
+void
+MutationMapWriter::finish() noexcept(false) {
+  if (finished)
+    return;
+
+  stream.write(reinterpret_cast<const char*>(MutationMap::eofMarker.data()),
+               MutationMap::eofMarker.size());
+  stream.close();
+  finished = true;
+  if (not stream)
+    throw std::runtime_error("cannot write '" + filename + "'");
+}
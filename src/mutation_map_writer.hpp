@@ -0,0 +1,34 @@
+#pragma once
+
+#include "mutation_map_codec.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+class MutationMapTranscript;
+
+/* Writes mutation map files, either in the original (v1) format or in the
+ * block-compressed v2 format. The EOF marker is written by finish(). */
+class MutationMapWriter {
+public:
+  explicit MutationMapWriter(
+      const std::string& filename, unsigned formatVersion = 1,
+      std::uint32_t blockReads =
+          mutation_map_codec::defaultBlockReads) noexcept(false);
+  MutationMapWriter(const MutationMapWriter&) = delete;
+  MutationMapWriter& operator=(const MutationMapWriter&) = delete;
+
+  void addTranscript(const MutationMapTranscript& transcript) noexcept(false);
+  void finish() noexcept(false);
+
+private:
+  void writeTranscriptHeader(const MutationMapTranscript& transcript) noexcept(
+      false);
+
+  std::string filename;
+  std::ofstream stream;
+  unsigned formatVersion;
+  std::uint32_t blockReads;
+  bool finished = false;
+};
@@ -0,0 +1,116 @@
+#include "null_model_library.hpp"
+
+#include "kolmogorov_smirnov.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <tuple>
+
+namespace {
+
+int
+logBin(double value) noexcept {
+  value = std::max(value, std::numeric_limits<double>::min());
+  return static_cast<int>(
+      std::lround(std::log2(value) * NullModelLibrary::binsPerOctave));
+}
+
+} // namespace
+
+bool
+NullModelLibrary::Key::operator<(const Key& other) const noexcept {
+  return std::tie(eigenGaps, basesBin, readsBin, mutationFrequencyBin) <
+         std::tie(other.eigenGaps, other.basesBin, other.readsBin,
+                  other.mutationFrequencyBin);
+}
+
+auto
+NullModelLibrary::makeKey(unsigned eigenGaps, unsigned bases, double reads,
+                          double mutationFrequency) noexcept -> Key {
+  return {eigenGaps, logBin(static_cast<double>(bases)), logBin(reads),
+          logBin(mutationFrequency)};
+}
+
+auto
+NullModelLibrary::find(const Key& key, std::size_t minSamples) const
+    noexcept(false) -> std::optional<Entry> {
+  std::lock_guard lock(mutex);
+  auto const entry_iter = entries.find(key);
+  if (entry_iter == std::end(entries))
+    return std::nullopt;
+
+  auto const& entry = entry_iter->second;
+  if (entry.samples.empty() or
+      entry.samples[0].size() < std::max<std::size_t>(minSamples, 1))
+    return std::nullopt;
+  return entry;
+}
+
+void
+NullModelLibrary::add(const Key& key, const PerturbedEigengaps& samples,
+                      std::size_t maxSamples) noexcept(false) {
+  assert(samples.size() == key.eigenGaps);
+  assert(std::all_of(std::begin(samples), std::end(samples),
+                     [&](auto&& sample) {
+                       return sample.size() == samples[0].size();
+                     }));
+  if (samples.empty())
+    return;
+
+  std::lock_guard lock(mutex);
+  auto& entry = entries[key];
+  if (entry.samples.empty())
+    entry.samples.resize(samples.size());
+
+  auto const available = maxSamples - std::min(maxSamples,
+                                               entry.samples[0].size());
+  auto const added = std::min(available, samples[0].size());
+  if (added == 0)
+    return;
+
+  entry.params.clear();
+  for (std::size_t index = 0; index < samples.size(); ++index) {
+    auto& entry_sample = entry.samples[index];
+    std::copy_n(std::begin(samples[index]), added,
+                std::back_inserter(entry_sample));
+    entry.params.push_back(WeibullFitter(entry_sample).fit());
+  }
+}
+
+bool
+NullModelLibrary::confirms(const Entry& entry,
+                           const PerturbedEigengaps& samples) noexcept(false) {
+  assert(samples.size() == entry.params.size());
+
+  for (std::size_t index = 0; index < samples.size(); ++index) {
+    auto sorted_sample = samples[index];
+    if (sorted_sample.empty())
+      continue;
+    std::sort(std::begin(sorted_sample), std::end(sorted_sample));
+
+    auto const sample_size = sorted_sample.size();
+    std::vector<double> cdf(sample_size);
+    weibull_cdf(entry.params[index], sorted_sample.data(), cdf.data(),
+                sample_size);
+
+    double distance = 0.;
+    for (std::size_t rank = 0; rank < sample_size; ++rank) {
+      double const lower =
+          static_cast<double>(rank) / static_cast<double>(sample_size);
+      double const upper =
+          static_cast<double>(rank + 1) / static_cast<double>(sample_size);
+      distance =
+          std::max({distance, cdf[rank] - lower, upper - cdf[rank]});
+    }
+
+    if (distance >= kolmogorov_smirnov_critical_value(
+                        static_cast<unsigned>(sample_size),
+                        confirmationAlpha))
+      return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ptba_types.hpp"
+#include "weibull_fitter.hpp"
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+/* Null models of the eigengaps shared between the windows.
+ *
+ * Windows with a similar number of bases, reads and mutation frequency after
+ * filtering have similar null distributions, so the permutations drawn for a
+ * window can be borrowed by the following ones in the same bin, which only
+ * draw a few permutations of their own to confirm them. */
+class NullModelLibrary {
+public:
+  struct Key {
+    unsigned eigenGaps;
+    int basesBin;
+    int readsBin;
+    int mutationFrequencyBin;
+
+    bool operator<(const Key& other) const noexcept;
+  };
+
+  struct Entry {
+    PerturbedEigengaps samples;
+    /* Weibull fit of the samples of each eigengap */
+    std::vector<WeibullParams> params;
+  };
+
+  static constexpr double binsPerOctave = 4.;
+  static constexpr double confirmationAlpha = 0.05;
+
+  static Key makeKey(unsigned eigenGaps, unsigned bases, double reads,
+                     double mutationFrequency) noexcept;
+
+  /* A copy of the entry of the bin, if it has at least minSamples
+   * permutations */
+  std::optional<Entry> find(const Key& key, std::size_t minSamples) const
+      noexcept(false);
+  /* Adds the permutations of a window to its bin, which keeps at most
+   * maxSamples of them */
+  void add(const Key& key, const PerturbedEigengaps& samples,
+           std::size_t maxSamples) noexcept(false);
+
+  /* Whether the permutations of a window follow the null models of the entry,
+   * with a Kolmogorov-Smirnov test on each eigengap */
+  static bool confirms(const Entry& entry,
+                       const PerturbedEigengaps& samples) noexcept(false);
+
+private:
+  mutable std::mutex mutex;
+  std::map<Key, Entry> entries;
+};
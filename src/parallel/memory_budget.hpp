@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace parallel {
+
+/* Counting semaphore over bytes, used to bound the memory of the work in
+ * flight. A request larger than the whole budget is granted when nothing else
+ * is in use, so that a single huge item cannot deadlock the pipeline. */
+struct memory_budget {
+  explicit memory_budget(std::size_t max_bytes) noexcept;
+  memory_budget(const memory_budget&) = delete;
+  memory_budget& operator=(const memory_budget&) = delete;
+
+  void acquire(std::size_t bytes);
+  void release(std::size_t bytes) noexcept;
+
+  std::size_t max_bytes() const noexcept;
+  std::size_t in_use() const noexcept;
+
+private:
+  std::size_t _max_bytes;
+  std::size_t _in_use = 0;
+  mutable std::mutex mx;
+  std::condition_variable cv;
+};
+
+/* Holds bytes of a memory_budget for the lifetime of the object */
+struct memory_budget_guard {
+  memory_budget_guard(memory_budget& budget, std::size_t bytes);
+  memory_budget_guard(const memory_budget_guard&) = delete;
+  memory_budget_guard& operator=(const memory_budget_guard&) = delete;
+  ~memory_budget_guard();
+
+private:
+  memory_budget* _budget;
+  std::size_t _bytes;
+};
+
+} // namespace parallel
+
+#include "memory_budget_impl.hpp"
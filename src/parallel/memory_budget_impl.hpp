@@ -0,0 +1,53 @@
+#pragma once
+
+#include "memory_budget.hpp"
+
+#include <cassert>
+
+namespace parallel {
+
+inline memory_budget::memory_budget(std::size_t max_bytes) noexcept
+    : _max_bytes(max_bytes) {}
+
+inline void
+memory_budget::acquire(std::size_t bytes) {
+  std::unique_lock lock(mx);
+  cv.wait(lock, [&] {
+    return _in_use == 0 or
+           (_in_use <= _max_bytes and bytes <= _max_bytes - _in_use);
+  });
+  _in_use += bytes;
+}
+
+inline void
+memory_budget::release(std::size_t bytes) noexcept {
+  {
+    std::lock_guard lock(mx);
+    assert(bytes <= _in_use);
+    _in_use -= bytes;
+  }
+  cv.notify_all();
+}
+
+inline std::size_t
+memory_budget::max_bytes() const noexcept {
+  return _max_bytes;
+}
+
+inline std::size_t
+memory_budget::in_use() const noexcept {
+  std::lock_guard lock(mx);
+  return _in_use;
+}
+
+inline memory_budget_guard::memory_budget_guard(memory_budget& budget,
+                                                std::size_t bytes)
+    : _budget(&budget), _bytes(bytes) {
+  _budget->acquire(_bytes);
+}
+
+inline memory_budget_guard::~memory_budget_guard() {
+  _budget->release(_bytes);
+}
+
+} // namespace parallel
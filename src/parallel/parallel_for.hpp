@@ -19,6 +19,8 @@ parallel_for(Args&&... args) {
 
 #include "blocked_range.hpp"
 
+#include <cassert>
+#include <limits>
 #include <thread>
 #include <type_traits>
 #include <vector>
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <exception>
+#include <random>
+#include <vector>
+
+/* Permutations of a window drawn in parallel batches, and then handed out one
+ * at a time in the order they were seeded.
+ *
+ * Each permutation of a batch has its own generator, seeded in order from the
+ * main one, so the sequence does not depend on the number of threads as long
+ * as there is more than one. With a single thread the main generator is used
+ * directly. The permutations left in the batch when the caller stops are
+ * thrown away. */
+template <typename Value>
+class PermutationBatches {
+public:
+  explicit PermutationBatches(unsigned threads) noexcept;
+
+  /* Draws a new batch of at most `remaining` permutations when the current
+   * one is over. An exception thrown by a draw is rethrown when its
+   * permutation is handed out. */
+  template <typename Draw>
+  Value next(std::mt19937& generator, unsigned remaining,
+             Draw&& draw) noexcept(false);
+
+private:
+  unsigned threads;
+  std::vector<Value> values;
+  std::vector<std::exception_ptr> exceptions;
+  std::size_t nextValue = 0;
+};
+
+#include "permutation_batches_impl.hpp"
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "permutation_batches.hpp"
+
+#include "parallel/parallel_for.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+template <typename Value>
+PermutationBatches<Value>::PermutationBatches(unsigned threads) noexcept
+    : threads(std::max(threads, 1u)) {}
+
+template <typename Value>
+template <typename Draw>
+Value
+PermutationBatches<Value>::next(std::mt19937& generator, unsigned remaining,
+                                Draw&& draw) noexcept(false) {
+  assert(remaining > 0);
+  if (threads == 1)
+    return draw(generator);
+
+  if (nextValue == values.size()) {
+    auto const batchSize = std::min(threads, remaining);
+    std::vector<std::mt19937::result_type> seeds(batchSize);
+    for (auto& seed : seeds)
+      seed = generator();
+
+    values.clear();
+    values.resize(batchSize);
+    exceptions.assign(batchSize, nullptr);
+    parallel::parallel_for(0u, batchSize, [&](unsigned drawIndex) {
+      try {
+        std::mt19937 drawGenerator(seeds[drawIndex]);
+        values[drawIndex] = draw(drawGenerator);
+      } catch (...) {
+        exceptions[drawIndex] = std::current_exception();
+      }
+    });
+    nextValue = 0;
+  }
+
+  if (exceptions[nextValue])
+    std::rethrow_exception(exceptions[nextValue]);
+  return std::move(values[nextValue++]);
+}
@@ -1,10 +1,19 @@
 #include "ptba.hpp"
+#include "kolmogorov_smirnov.hpp"
+#include "permutation_batches.hpp"
+#include "sequential_test.hpp"
 #include "weibull_fitter.hpp"
 
 #include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <iterator>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <thread>
+
+#include <boost/math/distributions/weibull.hpp>
 
 #if __has_include(<filesystem>)
 #include <filesystem>
@@ -16,8 +25,8 @@ namespace fs = std::experimental::filesystem;
 #error "Missing filesystem header"
 #endif
 
-Ptba::Ptba(const RingmapData& data, Args const& args)
-    : ringmapData(&data), minFilteredReads(args.min_filtered_reads()),
+Ptba::Ptba(const RingmapWindowView& window, Args const& args)
+    : window(&window), minFilteredReads(args.min_filtered_reads()),
       maxPermutations(args.max_permutations()),
       minPermutations(args.min_permutations()),
       firstEigengapThreshold(args.first_eigengap_threshold()),
@@ -29,32 +38,44 @@ Ptba::Ptba(const RingmapData& data, Args const& args)
       alternative_check_permutations(args.alternative_check_permutations()),
       min_null_stddev(args.min_null_stddev()),
       minBasesSize(args.min_bases_size()),
-      extended_search_eigengaps(args.extended_search_eigengaps()) {}
+      extended_search_eigengaps(args.extended_search_eigengaps()),
+      dumpAllEigenGaps(args.create_eigengaps_plots()),
+      sequentialTest(args.sequential_test()),
+      nullModelConfirmations(std::max(args.null_model_confirmations(), 1u)),
+      permutationThreads([&] {
+        auto threads = args.permutation_threads();
+        if (threads == 0)
+          threads = std::thread::hardware_concurrency();
+        return std::max(threads, 1u);
+      }()) {}
+
+arma::mat
+Ptba::calculateNormalizedLaplacian(arma::mat& adjacency) {
+  // data.fixBadNeighboursOnAdjacency(adjacency);
+  RingmapData::removeHighValuesOnAdjacency(adjacency);
+
+  adjacency.diag() = arma::zeros(adjacency.n_cols);
+  arma::vec degree = arma::sum(adjacency, 1);
+  arma::mat laplacian = arma::diagmat(degree) - adjacency;
+  std::transform(std::begin(degree), std::end(degree), std::begin(degree),
+                 [](double degree) {
+                   if (std::abs(degree) < 1e-4)
+                     return 1.;
+                   else
+                     return degree;
+                 });
+  arma::mat invSqrtDiagonal =
+      arma::diagmat(arma::ones(degree.size()) / arma::sqrt(degree));
+  arma::mat normalizedLaplacian = invSqrtDiagonal * laplacian * invSqrtDiagonal;
+
+  assert(not normalizedLaplacian.has_nan());
+  return normalizedLaplacian;
+}
 
 std::tuple<arma::mat, arma::vec, arma::vec, arma::mat>
-Ptba::calculateEigenGaps(const RingmapData& data) {
-  arma::mat normalizedLaplacian;
-  arma::mat adjacency = data.data().covariance(data.getBaseWeights());
-  {
-    // data.fixBadNeighboursOnAdjacency(adjacency);
-    RingmapData::removeHighValuesOnAdjacency(adjacency);
-
-    adjacency.diag() = arma::zeros(adjacency.n_cols);
-    arma::vec degree = arma::sum(adjacency, 1);
-    arma::mat laplacian = arma::diagmat(degree) - adjacency;
-    std::transform(std::begin(degree), std::end(degree), std::begin(degree),
-                   [](double degree) {
-                     if (std::abs(degree) < 1e-4)
-                       return 1.;
-                     else
-                       return degree;
-                   });
-    arma::mat invSqrtDiagonal =
-        arma::diagmat(arma::ones(degree.size()) / arma::sqrt(degree));
-    normalizedLaplacian = invSqrtDiagonal * laplacian * invSqrtDiagonal;
-
-    assert(not normalizedLaplacian.has_nan());
-  }
+Ptba::calculateEigenGaps(arma::mat adjacency) {
+  arma::mat const normalizedLaplacian =
+      calculateNormalizedLaplacian(adjacency);
 
   arma::mat eigVecs;
   arma::vec eigValues;
@@ -63,6 +84,49 @@ Ptba::calculateEigenGaps(const RingmapData& data) {
                          std::move(adjacency));
 }
 
+std::pair<arma::vec, arma::mat>
+Ptba::calculatePerturbedEigenGaps(arma::mat adjacency, unsigned nEigenGaps,
+                                  const arma::mat& initialSubspace) {
+  arma::mat const normalizedLaplacian =
+      calculateNormalizedLaplacian(adjacency);
+
+  auto decomposition = eigen_solver::smallest(
+      normalizedLaplacian, nEigenGaps + 1, initialSubspace, false);
+  assert(decomposition.eigenValues.n_elem > 1);
+  return {arma::diff(decomposition.eigenValues),
+          std::move(decomposition.subspace)};
+}
+
+bool
+Ptba::is_distribution(WeibullParams const& params,
+                      PerturbedEigengap const& sorted_data) noexcept(false) {
+  assert(not sorted_data.empty());
+  assert(std::is_sorted(std::begin(sorted_data), std::end(sorted_data)));
+  std::size_t const data_size = sorted_data.size();
+
+  std::vector<double> diffs(data_size);
+  weibull_cdf(params, sorted_data.data(), diffs.data(), data_size);
+
+  double const data_sum =
+      std::accumulate(std::begin(sorted_data), std::end(sorted_data), 0.);
+  double cum_value = 0.;
+  for (std::size_t index = 0; index < data_size; ++index) {
+    cum_value += sorted_data[index];
+    diffs[index] = std::abs(diffs[index] - cum_value / data_sum);
+  }
+
+  auto const threshold = kolmogorov_smirnov_critical_value(
+      static_cast<unsigned>(data_size), 0.10);
+  auto const after_high_diff_index =
+      static_cast<std::size_t>(static_cast<double>(data_size) * 0.90);
+  assert(after_high_diff_index > 0);
+  assert(after_high_diff_index <= data_size);
+  auto const high_diff_iter =
+      std::next(std::begin(diffs), after_high_diff_index - 1);
+  std::nth_element(std::begin(diffs), high_diff_iter, std::end(diffs));
+  return *high_diff_iter < threshold;
+}
+
 unsigned
 Ptba::getNumberOfClusters() const {
   return run();
@@ -151,6 +215,21 @@ Ptba::setMinEigenGapThreshold(double value) {
   minEigenGapThreshold = value;
 }
 
+void
+Ptba::setWindowComutations(const RingmapSlidingComutations* comutations) {
+  windowComutations = comutations;
+}
+
+void
+Ptba::setEigenSubspace(eigen_solver::EigenSubspace* subspace) {
+  eigenSubspace = subspace;
+}
+
+void
+Ptba::setNullModelLibrary(NullModelLibrary* library) {
+  nullModelLibrary = library;
+}
+
 unsigned
 Ptba::run() const noexcept(false) {
   auto result = result_from_run();
@@ -168,31 +247,74 @@ Ptba::run() const noexcept(false) {
 
 auto
 Ptba::result_from_run() const noexcept(false) -> PtbaResult {
+  PermutationsTrace trace;
+  auto result = testPermutations(trace);
+  result.permutations = trace.drawn;
+  result.libraryPermutations = trace.fromLibrary;
+  if (trace.settledEarly)
+    result.savedPermutations =
+        maxPermutations - trace.drawn - trace.fromLibrary;
+  if (trace.libraryKey and not result.perturbedEigenGaps.empty())
+    nullModelLibrary->add(*trace.libraryKey, result.perturbedEigenGaps,
+                          maxPermutations);
+  return result;
+}
+
+auto
+Ptba::testPermutations(PermutationsTrace& trace) const noexcept(false)
+    -> PtbaResult {
   enum class PValueResult { significant, nonsignificant, inf, alternative };
 
   arma::mat dataEigenVecs;
   arma::vec dataEigenVals;
   arma::vec dataEigenGaps;
   arma::mat adjacency;
-  auto initialData = *ringmapData;
-  std::vector<unsigned> filteredToUnfilteredBases(
-      initialData.getSequence().size());
-  initialData.filterBases();
+  std::optional<NullModelLibrary::Key> libraryKey;
+  // The views only hold the masks of the filters, the reads are not copied
+  auto initialView = *window;
+  initialView.filterBases();
+  auto const& filteredBases = initialView.getFilteredBases();
+  std::vector<unsigned> filteredToUnfilteredBases(initialView.cols_size());
+  std::copy(std::begin(filteredBases), std::end(filteredBases),
+            std::begin(filteredToUnfilteredBases));
 
   {
-    auto filteredData = initialData;
-    filteredData.filterReads();
-    for (auto [filteredIndex, unfilteredIndex] :
-         filteredData.getFilteredToNonFilteredMap()) {
-      assert(filteredIndex < filteredToUnfilteredBases.size());
-      filteredToUnfilteredBases[filteredIndex] = unfilteredIndex;
+    auto filteredView = initialView;
+    filteredView.filterReads();
+
+    auto const bases = static_cast<unsigned>(filteredBases.size());
+    std::vector<std::uint8_t> usedBases(initialView.cols_size(), 0);
+    for (auto base : filteredBases)
+      usedBases[base] = 1;
+
+    double reads = 0.;
+    double modifications = 0.;
+    for (unsigned readPosition = 0; readPosition < filteredView.rows_size();
+         ++readPosition) {
+      if (not filteredView.isReadKept(readPosition))
+        continue;
+
+      auto const multiplicity = filteredView.readMultiplicity(readPosition);
+      auto const indices = filteredView.readIndices(readPosition);
+      auto const readModifications = std::count_if(
+          std::begin(indices), std::end(indices), [&](auto base) {
+            return usedBases[base - window->begin_index()] != 0;
+          });
+      reads += multiplicity;
+      modifications += static_cast<double>(readModifications) * multiplicity;
     }
-    if (filteredData.size() < minFilteredReads or
-        filteredData.data().cols_size() < minBasesSize)
+
+    if (reads < minFilteredReads or bases < minBasesSize)
       return {};
 
+    if (nullModelLibrary)
+      libraryKey = NullModelLibrary::makeKey(
+          0, bases, reads, modifications / (reads * bases));
+
     std::tie(dataEigenVecs, dataEigenVals, dataEigenGaps, adjacency) =
-        calculateEigenGaps(filteredData);
+        calculateEigenGaps(windowComutations
+                               ? windowComutations->covariance(filteredView)
+                               : filteredView.covariance());
     assert(dataEigenGaps.size() > 1);
 
     if (arma::all(dataEigenGaps == 0))
@@ -211,8 +333,15 @@ Ptba::result_from_run() const noexcept(false) -> PtbaResult {
   PerturbedEigengaps perturbed_eigengaps(useful_eigengaps);
   dataEigenGaps.resize(useful_eigengaps);
 #else
-  PerturbedEigengaps perturbed_eigengaps(dataEigenGaps.size());
+  // Only the eigengaps that can be tested are drawn, unless all of them are
+  // needed for the eigengaps plots
+  PerturbedEigengaps perturbed_eigengaps(
+      dumpAllEigenGaps ? static_cast<unsigned>(dataEigenGaps.size())
+                       : useful_eigengaps);
 #endif
+  /* The same samples kept sorted, inserting each new permutation in place, for
+   * the goodness-of-fit check of the null models */
+  PerturbedEigengaps sorted_perturbed_eigengaps(perturbed_eigengaps.size());
   std::vector<WeibullFitter> weibull_fitters;
   weibull_fitters.reserve(dataEigenGaps.size());
   for (auto const& perturbed_eigengap : perturbed_eigengaps) {
@@ -223,31 +352,150 @@ Ptba::result_from_run() const noexcept(false) -> PtbaResult {
 
   unsigned eigenGapIndex = 0u;
   unsigned valid_eigengap_index = std::numeric_limits<unsigned>::max();
-  assert(initialData.size() != 0);
-  for (unsigned permutation = 0;
+  assert(initialView.rows_size() != 0);
+  RingmapColumnPermutations const permutations(initialView);
+  std::mt19937 randomGenerator(std::random_device{}());
+
+  auto const nPerturbedEigenGaps =
+      static_cast<unsigned>(perturbed_eigengaps.size());
+
+  /* The permutations of the previous windows in the same bin of the library
+   * are used as the first ones, once confirmed by the first
+   * nullModelConfirmations permutations of this window. Otherwise the
+   * permutations of this window are added to the library. */
+  std::optional<NullModelLibrary::Entry> libraryEntry;
+  if (libraryKey) {
+    libraryKey->eigenGaps = nPerturbedEigenGaps;
+    auto const maxLibraryPermutations =
+        maxPermutations - std::min(maxPermutations, nullModelConfirmations);
+    if (maxLibraryPermutations > 0)
+      libraryEntry = nullModelLibrary->find(*libraryKey, maxPermutations / 4);
+
+    if (libraryEntry) {
+      trace.fromLibrary = static_cast<unsigned>(std::min<std::size_t>(
+          libraryEntry->samples[0].size(), maxLibraryPermutations));
+      for (unsigned index = 0; index < nPerturbedEigenGaps; ++index) {
+        auto const& library_samples = libraryEntry->samples[index];
+        perturbed_eigengaps[index].assign(
+            std::begin(library_samples),
+            std::next(std::begin(library_samples), trace.fromLibrary));
+        sorted_perturbed_eigengaps[index] = perturbed_eigengaps[index];
+        std::sort(std::begin(sorted_perturbed_eigengaps[index]),
+                  std::end(sorted_perturbed_eigengaps[index]));
+      }
+    } else
+      trace.libraryKey = libraryKey;
+  }
+  bool libraryPending = libraryEntry.has_value();
+
+  /* Each permutation is decomposed starting from the eigenvectors of the
+   * previous one, or from the ones of the previous window. The rows of the
+   * shared subspace are moved to the bases of this window. Nothing is shared
+   * when the dense solver is used, which does not need a subspace: it is the
+   * case unless maxClusters is much smaller than the filtered bases. */
+  bool const sharedSubspace =
+      eigenSubspace and
+      eigen_solver::usesLobpcg(filteredBases.size(), nPerturbedEigenGaps + 1);
+  arma::mat localSubspace;
+  arma::mat& permutationsSubspace =
+      sharedSubspace ? eigenSubspace->vectors : localSubspace;
+  if (sharedSubspace) {
+    std::vector<unsigned> bases(filteredBases.size());
+    for (unsigned base = 0; base < bases.size(); ++base)
+      bases[base] = window->begin_index() + filteredBases[base];
+    eigenSubspace->vectors = eigenSubspace->on(bases);
+    eigenSubspace->bases = std::move(bases);
+  }
+
+  // Empty when the permutation has too few reads left
+  using DrawnEigenGaps = std::optional<std::pair<arma::vec, arma::mat>>;
+  auto const drawEigenGaps = [&](std::mt19937& generator) -> DrawnEigenGaps {
+    auto const transposed = permutations.draw(generator);
+    if (transposed.cols_size() < minFilteredReads)
+      return std::nullopt;
+    return calculatePerturbedEigenGaps(permutations.covariance(transposed),
+                                       nPerturbedEigenGaps,
+                                       permutationsSubspace);
+  };
+
+  /* With more than one thread the permutations are drawn in parallel batches
+   * and consumed in order, the stopping logic is unchanged. The permutations
+   * of a batch all start from the same subspace. */
+  PermutationBatches<DrawnEigenGaps> permutationBatches(permutationThreads);
+
+  /* Eigengaps waiting for more permutations that the sequential test already
+   * settles as non-significant */
+  auto const isSettledNonSignificant = [&](PerturbedEigengap const& nullModel,
+                                           double eigengap, bool lowerTail,
+                                           double level) {
+    return sequentialTest and
+           sequential_test::settledNonSignificant(
+               sequential_test::extremes(nullModel, eigengap, lowerTail),
+               maxPermutations, level);
+  };
+
+  for (unsigned permutation = trace.fromLibrary;
        permutation < maxPermutations and eigenGapIndex < useful_eigengaps and
        (valid_eigengap_index == std::numeric_limits<unsigned>::max() or
         eigenGapIndex <= valid_eigengap_index + extended_search_eigengaps);
        ++permutation) {
-    RingmapData perturbedData = initialData;
-    perturbedData.perturb();
-    perturbedData.filterBases();
-    perturbedData.filterReads();
-
-    if (perturbedData.size() < minFilteredReads)
+    auto drawn_eigengaps = permutationBatches.next(
+        randomGenerator, maxPermutations - permutation, drawEigenGaps);
+    if (not drawn_eigengaps) {
+      // Not a decision of the test, no permutation is saved
+      trace.settledEarly = false;
       return {};
+    }
+    trace.drawn = permutation + 1 - trace.fromLibrary;
+    if (not drawn_eigengaps->second.empty())
+      permutationsSubspace = std::move(drawn_eigengaps->second);
 
-    auto current_perturbed_eigengaps =
-        std::get<2>(calculateEigenGaps(perturbedData));
+    auto const& current_perturbed_eigengaps = drawn_eigengaps->first;
     {
       auto perturbed_eigengaps_iter = std::begin(perturbed_eigengaps);
       auto const perturbed_eigengaps_end = std::end(perturbed_eigengaps);
+      auto sorted_perturbed_eigengaps_iter =
+          std::begin(sorted_perturbed_eigengaps);
       auto current_perturbed_eigengaps_iter =
           std::cbegin(current_perturbed_eigengaps);
       for (; perturbed_eigengaps_iter < perturbed_eigengaps_end;
-           ++perturbed_eigengaps_iter, ++current_perturbed_eigengaps_iter) {
-        perturbed_eigengaps_iter->emplace_back(
-            std::max(*current_perturbed_eigengaps_iter, 1e-6));
+           ++perturbed_eigengaps_iter, ++sorted_perturbed_eigengaps_iter,
+           ++current_perturbed_eigengaps_iter) {
+        double const value = std::max(*current_perturbed_eigengaps_iter, 1e-6);
+        perturbed_eigengaps_iter->emplace_back(value);
+
+        auto& sorted_perturbed_eigengap = *sorted_perturbed_eigengaps_iter;
+        sorted_perturbed_eigengap.insert(
+            std::upper_bound(std::begin(sorted_perturbed_eigengap),
+                             std::end(sorted_perturbed_eigengap), value),
+            value);
+      }
+    }
+
+    if (libraryPending) {
+      if (permutation + 1 < trace.fromLibrary + nullModelConfirmations)
+        continue;
+      libraryPending = false;
+
+      // The library is dropped when this window does not follow it
+      PerturbedEigengaps window_eigengaps(nPerturbedEigenGaps);
+      for (unsigned index = 0; index < nPerturbedEigenGaps; ++index) {
+        auto const& perturbed_eigengap = perturbed_eigengaps[index];
+        window_eigengaps[index].assign(
+            std::next(std::begin(perturbed_eigengap), trace.fromLibrary),
+            std::end(perturbed_eigengap));
+      }
+
+      if (not NullModelLibrary::confirms(*libraryEntry, window_eigengaps)) {
+        for (unsigned index = 0; index < nPerturbedEigenGaps; ++index) {
+          auto& sorted_perturbed_eigengap = sorted_perturbed_eigengaps[index];
+          perturbed_eigengaps[index] = window_eigengaps[index];
+          sorted_perturbed_eigengap = std::move(window_eigengaps[index]);
+          std::sort(std::begin(sorted_perturbed_eigengap),
+                    std::end(sorted_perturbed_eigengap));
+        }
+        permutation -= trace.fromLibrary;
+        trace.fromLibrary = 0;
       }
     }
 
@@ -303,8 +551,8 @@ Ptba::result_from_run() const noexcept(false) -> PtbaResult {
                                                              params.scale);
 
       if (not null_dist_is_valid[eigenGapIndex]) {
-        null_dist_is_valid[eigenGapIndex] =
-            is_distribution(distribution, perturbed_eigengap);
+        null_dist_is_valid[eigenGapIndex] = is_distribution(
+            params, sorted_perturbed_eigengaps[eigenGapIndex]);
         if (not null_dist_is_valid[eigenGapIndex])
           return std::pair(PValueResult::inf, true);
       }
@@ -330,7 +578,10 @@ Ptba::result_from_run() const noexcept(false) -> PtbaResult {
           isPValueSignificative(0);
 
       if (significativeness == PValueResult::inf) {
-        if (permutation == maxPermutations - 1)
+        if (permutation == maxPermutations - 1 or
+            isSettledNonSignificant(perturbed_eigengaps[0], dataEigenGaps[0],
+                                    true, alphaValue / 2.)) {
+          trace.settledEarly = permutation < maxPermutations - 1;
           return {0u,
                   std::move(dataEigenVecs),
                   std::move(dataEigenGaps),
@@ -338,7 +589,7 @@ Ptba::result_from_run() const noexcept(false) -> PtbaResult {
                   {},
                   std::move(filteredToUnfilteredBases),
                   std::move(adjacency)};
-        else
+        } else
           continue;
       }
 
@@ -426,16 +677,21 @@ Ptba::result_from_run() const noexcept(false) -> PtbaResult {
           } else if (pValue >= alphaValue / 2. or
                      std::abs(first_mean - dataEigenGaps[0]) <
                          first_mean * (1. - firstEigengapThreshold)) {
-            if (permutation < maxPermutations - 1)
+            if (permutation < maxPermutations - 1 and
+                not(pValue >= alphaValue / 2. and
+                    isSettledNonSignificant(shiftedFirstEigengap,
+                                            dataEigenGaps[0], true,
+                                            alphaValue / 2.)))
               continue;
-            else
-              return {0u,
-                      std::move(dataEigenVecs),
-                      std::move(dataEigenGaps),
-                      std::move(perturbed_eigengaps),
-                      {},
-                      std::move(filteredToUnfilteredBases),
-                      std::move(adjacency)};
+
+            trace.settledEarly = permutation < maxPermutations - 1;
+            return {0u,
+                    std::move(dataEigenVecs),
+                    std::move(dataEigenGaps),
+                    std::move(perturbed_eigengaps),
+                    {},
+                    std::move(filteredToUnfilteredBases),
+                    std::move(adjacency)};
           }
         }
       } else {
@@ -525,8 +781,16 @@ Ptba::result_from_run() const noexcept(false) -> PtbaResult {
       if (result == PValueResult::inf or
           result == PValueResult::nonsignificant) {
         if (eigenGapIndex > valid_eigengap_index + extended_search_eigengaps or
-            permutation < maxPermutations - 1)
+            (permutation < maxPermutations - 1 and
+             not isSettledNonSignificant(perturbed_eigengaps[eigenGapIndex],
+                                         dataEigenGaps[eigenGapIndex], false,
+                                         alphaValue)))
           break;
+
+        /* Before the last permutation, the sequential test lets the search go
+         * on: the early end of the run depends on it from now on */
+        if (permutation < maxPermutations - 1)
+          trace.settledEarly = true;
       }
 
       if (result == PValueResult::significant) {
@@ -1,9 +1,16 @@
 #pragma once
 
 #include "args.hpp"
+#include "eigen_solver.hpp"
+#include "null_model_library.hpp"
 #include "ptba_types.hpp"
+#include "ringmap_column_permutations.hpp"
 #include "ringmap_data.hpp"
+#include "ringmap_sliding_comutations.hpp"
+#include "ringmap_window_view.hpp"
+#include "weibull_fitter.hpp"
 
+#include <optional>
 #include <stdexcept>
 #include <string_view>
 #include <tuple>
@@ -20,6 +27,12 @@ struct PtbaResult {
   std::vector<unsigned> significantIndices;
   std::vector<unsigned> filteredToUnfilteredBases;
   arma::mat adjacency;
+  /* Permutations drawn, and the ones left out because the sequential test
+   * settled the remaining eigengaps */
+  unsigned permutations = 0;
+  unsigned savedPermutations = 0;
+  /* Permutations taken from the null model library */
+  unsigned libraryPermutations = 0;
 };
 
 class Ptba /* Permutation test-based analysis */
@@ -30,7 +43,9 @@ public:
     explicit exception(const char* what) : std::runtime_error(what){};
   };
 
-  Ptba(const RingmapData& data, Args const& args);
+  /* The window must not be filtered, its parent data must outlive the
+   * analysis */
+  Ptba(const RingmapWindowView& window, Args const& args);
 
   unsigned getNumberOfClusters() const;
   unsigned getNumberOfClustersAndDumpData(
@@ -45,6 +60,17 @@ public:
   void setMaxClusters(unsigned value);
   std::vector<unsigned> getAllSignificantEigenGapIndices() const;
   void setMinEigenGapThreshold(double value);
+  /* Uses the counts of a sliding window, which must currently be on the data
+   * being analyzed, instead of computing the covariance from scratch */
+  void setWindowComutations(const RingmapSlidingComutations* comutations);
+  /* Starts the eigensolves of the permutations from the given subspace, which
+   * is then replaced by the one of the last permutation. Meant to be shared by
+   * consecutive windows. */
+  void setEigenSubspace(eigen_solver::EigenSubspace* subspace);
+  /* Borrows the permutations of the windows with similar statistics from the
+   * library, and adds the ones of this window when it has to draw all of
+   * them. Meant to be shared by all the windows. */
+  void setNullModelLibrary(NullModelLibrary* library);
 
   unsigned run() const noexcept(false);
   PtbaResult result_from_run() const noexcept(false);
@@ -58,15 +84,37 @@ public:
                          std::string_view perturbedEigenGapsFilename);
 
 private:
+  struct PermutationsTrace {
+    unsigned drawn = 0;
+    unsigned fromLibrary = 0;
+    /* Whether the run ended before maxPermutations because of the
+     * sequential test */
+    bool settledEarly = false;
+    /* Set when the permutations of the window go to the library */
+    std::optional<NullModelLibrary::Key> libraryKey;
+  };
+
+  PtbaResult testPermutations(PermutationsTrace& trace) const noexcept(false);
+
   static std::tuple<arma::mat, arma::vec, arma::vec, arma::mat>
-  calculateEigenGaps(const RingmapData& data);
+  calculateEigenGaps(arma::mat adjacency);
+  /* Only the first nEigenGaps eigengaps, together with the subspace to start
+   * the next permutation from. The eigenvectors are not computed when the
+   * dense solver is used. */
+  static std::pair<arma::vec, arma::mat>
+  calculatePerturbedEigenGaps(arma::mat adjacency, unsigned nEigenGaps,
+                              const arma::mat& initialSubspace);
+  static arma::mat calculateNormalizedLaplacian(arma::mat& adjacency);
 
-  template <typename Distribution>
+  /* Goodness-of-fit of a Weibull null model, on the sorted samples */
   static bool
-  is_distribution(Distribution&& distribution,
-                  PerturbedEigengap const& perturbed_data) noexcept(false);
+  is_distribution(WeibullParams const& params,
+                  PerturbedEigengap const& sorted_data) noexcept(false);
 
-  const RingmapData* ringmapData;
+  const RingmapWindowView* window;
+  const RingmapSlidingComutations* windowComutations = nullptr;
+  eigen_solver::EigenSubspace* eigenSubspace = nullptr;
+  NullModelLibrary* nullModelLibrary = nullptr;
   unsigned minFilteredReads = 5;
   unsigned maxPermutations = 400;
   unsigned minPermutations = 8;
@@ -81,7 +129,8 @@ private:
   double min_null_stddev = 0.025;
   unsigned minBasesSize = 10;
   unsigned extended_search_eigengaps = 3;
+  bool dumpAllEigenGaps = false;
+  bool sequentialTest = false;
+  unsigned nullModelConfirmations = 8;
+  unsigned permutationThreads = 1;
 };
-
-
-#include "ptba_impl.hpp"
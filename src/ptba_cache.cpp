@@ -0,0 +1,246 @@
+#include "ptba_cache.hpp"
+
+#include "binary_stream.hpp"
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+#include <unistd.h>
+
+#if __has_include(<filesystem>)
+#include <filesystem>
+namespace fs = std::filesystem;
+#elif __has_include(<experimental/filesystem>)
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#else
+#error "Missing filesystem header"
+#endif
+
+namespace {
+
+constexpr std::array<char, 8> entryMagic{'D', 'R', 'A', 'C',
+                                         'O', 'P', 'T', 'B'};
+/* To be increased whenever the entries or the analysis change */
+constexpr std::uint32_t entryVersion = 3;
+
+/* 64-bit FNV-1a */
+struct Hasher {
+  std::uint64_t value = 14695981039346656037ull;
+
+  template <typename T>
+  Hasher& operator<<(T const& t) noexcept {
+    static_assert(std::is_trivially_copyable_v<T>);
+    std::array<unsigned char, sizeof(T)> bytes;
+    std::memcpy(bytes.data(), &t, sizeof(T));
+    for (auto byte : bytes) {
+      value ^= byte;
+      value *= 1099511628211ull;
+    }
+    return *this;
+  }
+};
+
+template <typename Stream>
+void
+writeDoubles(BinaryStream<Stream>& binaryStream,
+             std::vector<double> const& values) {
+  binaryStream << static_cast<std::uint32_t>(values.size());
+  for (double value : values) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(double));
+    binaryStream << bits;
+  }
+}
+
+template <typename Stream>
+bool
+readDoubles(Stream& stream, std::vector<double>& values) {
+  BinaryStream<Stream> binaryStream(stream);
+  std::uint32_t size;
+  binaryStream >> size;
+  if (not stream)
+    return false;
+
+  values.resize(size);
+  for (auto& value : values) {
+    std::uint64_t bits;
+    binaryStream >> bits;
+    std::memcpy(&value, &bits, sizeof(double));
+  }
+  return static_cast<bool>(stream);
+}
+
+} // namespace
+
+PtbaCache::PtbaCache(std::string directory, Args const& args) noexcept(false)
+    : directory(std::move(directory)) {
+  fs::create_directories(this->directory);
+  if (not fs::is_directory(this->directory))
+    throw std::runtime_error("cannot use '" + this->directory +
+                             "' as PTBA cache directory");
+
+  Hasher hasher;
+  hasher << entryVersion << args.shape() << args.minimum_base_coverage()
+         << args.minimum_modifications_per_base()
+         << args.minimum_modifications_per_base_fraction()
+         << args.minimum_modifications_per_read() << args.max_clusters()
+         << args.min_filtered_reads() << args.min_permutations()
+         << args.max_permutations() << args.sequential_test()
+         << args.null_model_library() << args.null_model_confirmations()
+         << args.first_eigengap_threshold() << args.min_eigengap_threshold()
+         << args.eigengap_diff_absolute_threshold() << args.alpha_value()
+         << args.beta_value() << args.first_eigengap_beta_value()
+         << args.min_null_stddev() << args.alternative_check_permutations()
+         << args.min_bases_size() << args.extended_search_eigengaps()
+         << args.create_eigengaps_plots();
+  argsKey = hasher.value;
+}
+
+std::uint64_t
+PtbaCache::windowKey(const RingmapWindowView& window) const noexcept {
+  Hasher hasher;
+  hasher << argsKey << window.begin_index() << window.end_index();
+  for (char base : window.getSequence())
+    hasher << base;
+
+  /* Only the part of the reads inside the window matters */
+  hasher << window.rows_size();
+  for (unsigned readPosition = 0; readPosition < window.rows_size();
+       ++readPosition) {
+    auto const modifiedIndices = window.readIndices(readPosition);
+    hasher << window.readMultiplicity(readPosition) << modifiedIndices.size();
+    for (auto index : modifiedIndices)
+      hasher << index;
+  }
+
+  return hasher.value;
+}
+
+std::string
+PtbaCache::entryFilename(std::uint64_t key) const {
+  std::ostringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0') << key << ".ptba";
+  return (fs::path(directory) / name.str()).string();
+}
+
+std::optional<PtbaResult>
+PtbaCache::load(const RingmapWindowView& window) const noexcept(false) {
+  auto const key = windowKey(window);
+  std::ifstream stream(entryFilename(key), std::ios::binary);
+
+  auto const miss = [&]() -> std::optional<PtbaResult> {
+    ++nMisses;
+    return std::nullopt;
+  };
+  if (not stream)
+    return miss();
+
+  BinaryStream<std::ifstream> binaryStream(stream);
+  std::array<char, entryMagic.size()> magic;
+  stream.read(magic.data(), magic.size());
+  std::uint32_t version;
+  std::uint64_t storedKey;
+  binaryStream >> version >> storedKey;
+  if (not stream or magic != entryMagic or version != entryVersion or
+      storedKey != key)
+    return miss();
+
+  PtbaResult result;
+  std::uint32_t nSignificantIndices;
+  binaryStream >> result.nClusters >> result.permutations >>
+      result.savedPermutations >> result.libraryPermutations >>
+      nSignificantIndices;
+  if (not stream)
+    return miss();
+  result.significantIndices.resize(nSignificantIndices);
+  for (auto& index : result.significantIndices)
+    binaryStream >> index;
+
+  std::vector<double> eigenGaps;
+  if (not readDoubles(stream, eigenGaps))
+    return miss();
+  result.eigenGaps = arma::vec(eigenGaps);
+
+  std::uint32_t nPerturbedEigenGaps;
+  binaryStream >> nPerturbedEigenGaps;
+  if (not stream)
+    return miss();
+  result.perturbedEigenGaps.resize(nPerturbedEigenGaps);
+  for (auto& perturbedEigenGap : result.perturbedEigenGaps) {
+    if (not readDoubles(stream, perturbedEigenGap))
+      return miss();
+  }
+
+  ++nHits;
+  return result;
+}
+
+void
+PtbaCache::store(const RingmapWindowView& window,
+                 const PtbaResult& result) const noexcept(false) {
+  auto const key = windowKey(window);
+  auto const filename = entryFilename(key);
+
+  /* Written aside and then renamed, so that the workers and the concurrent
+   * runs never read a partial entry */
+  std::ostringstream tempFilename;
+  tempFilename << filename << '.' << ::getpid() << '.'
+               << std::this_thread::get_id() << ".tmp";
+  try {
+    {
+      std::ofstream stream(tempFilename.str(),
+                           std::ios::binary bitor std::ios::trunc);
+      if (not stream)
+        throw std::runtime_error("cannot open '" + tempFilename.str() +
+                                 "' for writing");
+
+      BinaryStream<std::ofstream> binaryStream(stream);
+      stream.write(entryMagic.data(), entryMagic.size());
+      binaryStream << entryVersion << key
+                   << static_cast<std::uint32_t>(result.nClusters)
+                   << static_cast<std::uint32_t>(result.permutations)
+                   << static_cast<std::uint32_t>(result.savedPermutations)
+                   << static_cast<std::uint32_t>(result.libraryPermutations)
+                   << static_cast<std::uint32_t>(
+                          result.significantIndices.size());
+      for (auto index : result.significantIndices)
+        binaryStream << static_cast<std::uint32_t>(index);
+
+      writeDoubles(binaryStream, arma::conv_to<std::vector<double>>::from(
+                                     result.eigenGaps));
+      binaryStream << static_cast<std::uint32_t>(
+          result.perturbedEigenGaps.size());
+      for (auto const& perturbedEigenGap : result.perturbedEigenGaps)
+        writeDoubles(binaryStream, perturbedEigenGap);
+
+      if (not stream)
+        throw std::runtime_error("cannot write '" + tempFilename.str() + "'");
+    }
+
+    fs::rename(tempFilename.str(), filename);
+  } catch (const std::exception& e) {
+    // The result is still used, it is only not reusable by later runs
+    std::error_code error;
+    fs::remove(tempFilename.str(), error);
+    std::cerr << "WARNING: PTBA cache entry '" << filename
+              << "' cannot be written (" << e.what() << ")\n";
+  }
+}
+
+std::size_t
+PtbaCache::hits() const noexcept {
+  return nHits;
+}
+
+std::size_t
+PtbaCache::misses() const noexcept {
+  return nMisses;
+}
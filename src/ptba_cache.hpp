@@ -0,0 +1,41 @@
+#pragma once
+
+#include "args.hpp"
+#include "ptba.hpp"
+#include "ringmap_window_view.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+/* On-disk cache of the PTBA results of the windows, reused by later runs that
+ * only change the parameters applied after the spectral analysis.
+ *
+ * Each result is stored in its own file, named after a hash of the reads of
+ * the window and of the arguments that can change the result. Only the data
+ * used after the analysis is stored: the eigenvectors, the adjacency matrix
+ * and the bases map of a loaded result are empty. */
+class PtbaCache {
+public:
+  PtbaCache(std::string directory, Args const& args) noexcept(false);
+
+  std::optional<PtbaResult> load(const RingmapWindowView& window) const
+      noexcept(false);
+  /* A result that cannot be written only gives a warning, the run goes on
+   * without caching it */
+  void store(const RingmapWindowView& window, const PtbaResult& result) const
+      noexcept(false);
+
+  std::size_t hits() const noexcept;
+  std::size_t misses() const noexcept;
+
+private:
+  std::uint64_t windowKey(const RingmapWindowView& window) const noexcept;
+  std::string entryFilename(std::uint64_t key) const;
+
+  std::string directory;
+  std::uint64_t argsKey;
+  mutable std::atomic<std::size_t> nHits{0};
+  mutable std::atomic<std::size_t> nMisses{0};
+};
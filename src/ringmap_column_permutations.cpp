@@ -0,0 +1,172 @@
+#include "ringmap_column_permutations.hpp"
+#include "ringmap_data.hpp"
+#include "ringmap_window_view.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <numeric>
+
+RingmapColumnPermutations::RingmapColumnPermutations(
+    const RingmapData& data) noexcept(false)
+    : readsFiltered(data.modificationsFilter <
+                    data.minimumModificationsPerRead),
+      minimumModificationsPerRead(data.minimumModificationsPerRead),
+      covarianceKernel(data.covarianceKernel) {
+  assert(data.basesFiltered);
+
+  // Permutations act on single reads
+  auto expanded = data.m_data;
+  expanded.expandDuplicateRows();
+  assert(expanded.rows_size() == expanded.storedReads());
+  reads = expanded.storedReads();
+  columns = RingmapMatrixCsr(expanded).t();
+
+  auto const& baseCoverages = data.baseCoverages;
+  assert(baseCoverages.size() == columns.rows_size());
+  baseWeights.resize(baseCoverages.size());
+  if (not baseCoverages.empty()) {
+    auto const highestCoverage = static_cast<double>(
+        *std::max_element(std::begin(baseCoverages), std::end(baseCoverages)));
+    std::transform(std::begin(baseCoverages), std::end(baseCoverages),
+                   std::begin(baseWeights), [&](unsigned coverage) {
+                     return static_cast<double>(coverage) / highestCoverage;
+                   });
+  }
+
+  permuted = columns;
+}
+
+RingmapColumnPermutations::RingmapColumnPermutations(
+    const RingmapWindowView& view) noexcept(false)
+    : readsFiltered(view.modificationsFilter <
+                    view.data->minimumModificationsPerRead),
+      minimumModificationsPerRead(view.data->minimumModificationsPerRead),
+      covarianceKernel(view.data->covarianceKernel) {
+  assert(view.basesFiltered);
+
+  auto const& filteredBases = view.getFilteredBases();
+  auto const bases = static_cast<unsigned>(filteredBases.size());
+  std::vector<unsigned> filteredPositions(view.cols_size(), bases);
+  for (unsigned position = 0; position < bases; ++position)
+    filteredPositions[filteredBases[position]] = position;
+
+  // Permutations act on single reads, each copy of a read is a column
+  std::vector<std::size_t> offsets(bases + 1, 0);
+  reads = 0;
+  for (unsigned readPosition = 0; readPosition < view.rows_size();
+       ++readPosition) {
+    if (not view.isReadKept(readPosition))
+      continue;
+
+    auto const multiplicity = view.readMultiplicity(readPosition);
+    for (auto base : view.readIndices(readPosition)) {
+      if (auto const position = filteredPositions[base - view.begin];
+          position != bases)
+        offsets[position + 1] += multiplicity;
+    }
+    reads += multiplicity;
+  }
+  std::partial_sum(std::begin(offsets), std::end(offsets),
+                   std::begin(offsets));
+
+  std::vector<index_type> indices(offsets[bases]);
+  auto nextOffsets = offsets;
+  index_type read = 0;
+  for (unsigned readPosition = 0; readPosition < view.rows_size();
+       ++readPosition) {
+    if (not view.isReadKept(readPosition))
+      continue;
+
+    auto const multiplicity = view.readMultiplicity(readPosition);
+    for (auto base : view.readIndices(readPosition)) {
+      if (auto const position = filteredPositions[base - view.begin];
+          position != bases) {
+        auto const out = std::next(std::begin(indices),
+                                   static_cast<std::ptrdiff_t>(
+                                       nextOffsets[position]));
+        std::iota(out, std::next(out, multiplicity), read);
+        nextOffsets[position] += multiplicity;
+      }
+    }
+    read += multiplicity;
+  }
+  columns = RingmapMatrixCsr(reads, std::move(offsets), std::move(indices));
+
+  // Every read covers the whole window
+  baseWeights = view.getBaseWeights();
+  permuted = columns;
+}
+
+unsigned
+RingmapColumnPermutations::cols_size() const noexcept {
+  return columns.rows_size();
+}
+
+unsigned
+RingmapColumnPermutations::filteredReads() const noexcept {
+  return permuted.cols_size();
+}
+
+const RingmapMatrixCsr&
+RingmapColumnPermutations::transposed() const noexcept {
+  return permuted;
+}
+
+arma::mat
+RingmapColumnPermutations::covariance() const noexcept(false) {
+  return covariance(permuted);
+}
+
+arma::mat
+RingmapColumnPermutations::covariance(const RingmapMatrixCsr& transposed) const
+    noexcept(false) {
+  assert(transposed.rows_size() == cols_size());
+  if (covarianceKernel == ringmap_matrix::CovarianceKernel::gemm)
+    return ringmap_matrix::covariance(transposed.t(), {}, baseWeights,
+                                      covarianceKernel);
+  else
+    return ringmap_matrix::covariance(transposed.t(), transposed, baseWeights,
+                                      covarianceKernel);
+}
+
+RingmapMatrixCsr
+RingmapColumnPermutations::filterReads(
+    std::vector<index_type>&& indices,
+    const std::vector<unsigned>& readModifications) const noexcept(false) {
+  auto const bases = columns.rows_size();
+  std::vector<std::size_t> offsets(bases + 1);
+  for (unsigned base = 0; base < bases; ++base)
+    offsets[base + 1] =
+        offsets[base] + static_cast<std::size_t>(columns.row(base).size());
+
+  if (not readsFiltered)
+    return RingmapMatrixCsr(reads, std::move(offsets), std::move(indices));
+
+  // Same rule as RingmapData::filterReads, kept reads are renumbered
+  std::vector<index_type> newIndices(reads);
+  index_type keptReads = 0;
+  for (unsigned readIndex = 0; readIndex < reads; ++readIndex) {
+    if (readModifications[readIndex] >= minimumModificationsPerRead)
+      newIndices[readIndex] = keptReads++;
+    else
+      newIndices[readIndex] = reads;
+  }
+
+  auto outIter = std::begin(indices);
+  for (unsigned base = 0; base < bases; ++base) {
+    auto const begin = std::next(std::begin(indices),
+                                 static_cast<std::ptrdiff_t>(offsets[base]));
+    auto const end = std::next(std::begin(indices),
+                               static_cast<std::ptrdiff_t>(offsets[base + 1]));
+    offsets[base] = static_cast<std::size_t>(outIter - std::begin(indices));
+    for (auto iter = begin; iter < end; ++iter) {
+      if (auto const newIndex = newIndices[*iter]; newIndex != reads)
+        *outIter++ = newIndex;
+    }
+  }
+  offsets[bases] = static_cast<std::size_t>(outIter - std::begin(indices));
+  indices.erase(outIter, std::end(indices));
+
+  return RingmapMatrixCsr(keptReads, std::move(offsets), std::move(indices));
+}
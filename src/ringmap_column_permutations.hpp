@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ringmap_matrix_comutations.hpp"
+#include "ringmap_matrix_csr.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <armadillo>
+
+class RingmapData;
+class RingmapWindowView;
+
+/* Null-model permutations of base-filtered data, working on a column-major
+ * copy of the reads.
+ *
+ * perturb() is equivalent to RingmapData::perturb() followed by filterBases()
+ * and filterReads(). Each column is shuffled like
+ * RingmapMatrixColAccessor::shuffle does, drawing the same random numbers: a
+ * modification is moved to a random read only when that read is not already
+ * modified on the base. The reads modified on a base live in a bitset while
+ * shuffling, and the result is only kept as the transposed CSR matrix needed
+ * by the co-mutation kernels, without ever building the rows. The bases
+ * filter has nothing to do, because a permutation does not change the number
+ * of modifications on a base. */
+class RingmapColumnPermutations {
+public:
+  using index_type = RingmapMatrixCsr::index_type;
+
+  explicit RingmapColumnPermutations(const RingmapData& data) noexcept(false);
+  /* Same as for the RingmapData extracted for the window, built directly
+   * from the reads of the view, which must have its bases filtered */
+  explicit RingmapColumnPermutations(const RingmapWindowView& view) noexcept(
+      false);
+
+  template <typename URBG>
+  void perturb(URBG&& randomGenerator) noexcept(false);
+  /* Draws a permutation and returns its transposed matrix, whose columns are
+   * the reads left by the reads filter, without changing the state of the
+   * object. Different permutations can be drawn concurrently, each one with
+   * its own random generator. */
+  template <typename URBG>
+  RingmapMatrixCsr draw(URBG&& randomGenerator) const noexcept(false);
+
+  unsigned cols_size() const noexcept;
+  /* Reads left by the reads filter after the last permutation */
+  unsigned filteredReads() const noexcept;
+  /* One row for each base, with the sorted indices of the filtered reads */
+  const RingmapMatrixCsr& transposed() const noexcept;
+  /* Same as the covariance of the perturbed and filtered RingmapData */
+  arma::mat covariance() const noexcept(false);
+  arma::mat covariance(const RingmapMatrixCsr& transposed) const
+      noexcept(false);
+
+private:
+  RingmapMatrixCsr
+  filterReads(std::vector<index_type>&& indices,
+              const std::vector<unsigned>& readModifications) const
+      noexcept(false);
+
+  RingmapMatrixCsr columns;
+  unsigned reads = 0;
+  bool readsFiltered;
+  unsigned minimumModificationsPerRead;
+  std::vector<double> baseWeights;
+  ringmap_matrix::CovarianceKernel covarianceKernel;
+  RingmapMatrixCsr permuted;
+};
+
+#include "ringmap_column_permutations_impl.hpp"
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "ringmap_column_permutations.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <random>
+
+namespace detail {
+
+inline unsigned
+countTrailingZeros(std::uint64_t value) noexcept {
+  assert(value != 0);
+#if defined(__GNUC__)
+  return static_cast<unsigned>(__builtin_ctzll(value));
+#else
+  unsigned out = 0;
+  for (; (value & 1) == 0; value >>= 1)
+    ++out;
+  return out;
+#endif
+}
+
+} // namespace detail
+
+template <typename URBG>
+void
+RingmapColumnPermutations::perturb(URBG&& randomGenerator) noexcept(false) {
+  permuted = draw(randomGenerator);
+}
+
+template <typename URBG>
+RingmapMatrixCsr
+RingmapColumnPermutations::draw(URBG&& randomGenerator) const noexcept(false) {
+  assert(reads > 0);
+  auto const bases = columns.rows_size();
+  std::size_t const words = (std::size_t(reads) + 63) / 64;
+  std::vector<std::uint64_t> readsBitset(words);
+  std::vector<unsigned> readModifications(reads, 0);
+  std::vector<index_type> indices(columns.nonZeros());
+  auto indicesIter = std::begin(indices);
+
+  for (unsigned base = 0; base < bases; ++base) {
+    std::fill(std::begin(readsBitset), std::end(readsBitset), 0);
+    for (auto readIndex : columns.row(base))
+      readsBitset[readIndex / 64] |= std::uint64_t(1) << (readIndex % 64);
+
+    /* Reads are visited in increasing order, and a modification moved
+     * further down is visited again, as it happens shuffling the rows */
+    std::uniform_int_distribution<unsigned> distribution(0, reads - 1);
+    for (std::size_t word = 0; word < words; ++word) {
+      for (auto pending = readsBitset[word]; pending != 0;) {
+        auto const bit = detail::countTrailingZeros(pending);
+        pending &= pending - 1;
+
+        auto const otherRead = distribution(randomGenerator);
+        auto const otherWord = otherRead / 64;
+        auto const otherMask = std::uint64_t(1) << (otherRead % 64);
+        if ((readsBitset[otherWord] & otherMask) != 0)
+          continue;
+
+        readsBitset[word] &= ~(std::uint64_t(1) << bit);
+        readsBitset[otherWord] |= otherMask;
+        if (otherWord == word and otherRead % 64 > bit)
+          pending |= otherMask;
+      }
+    }
+
+    // The number of modified reads on the base never changes
+    for (std::size_t word = 0; word < words; ++word) {
+      for (auto bits = readsBitset[word]; bits != 0; bits &= bits - 1) {
+        auto const readIndex = static_cast<index_type>(
+            word * 64 + detail::countTrailingZeros(bits));
+        *indicesIter++ = readIndex;
+        ++readModifications[readIndex];
+      }
+    }
+  }
+  assert(indicesIter == std::end(indices));
+
+  return filterReads(std::move(indices), readModifications);
+}
@@ -12,14 +12,18 @@
 #include <range/v3/numeric.hpp>
 
 #include <array>
+#include <atomic>
 #include <cassert>
+#include <exception>
 #include <fstream>
 #include <iomanip>
 #include <limits>
 #include <optional>
 #include <regex>
 #include <sstream>
+#include <thread>
 #include <unordered_map>
+#include <utility>
 
 RingmapData::RingmapData(const std::string& filename,
                          const std::string& sequence, Args const& args,
@@ -29,7 +33,9 @@ RingmapData::RingmapData(const std::string& filename,
       minimumModificationsPerRead(args.minimum_modifications_per_read()),
       minimumModificationsPerBaseFraction(
           args.minimum_modifications_per_base_fraction()),
-      sequence(sequence), shape(args.shape()) {
+      sequence(sequence), shape(args.shape()),
+      covarianceKernel(
+          ringmap_matrix::parseCovarianceKernel(args.covariance_kernel())) {
   startIndex = std::numeric_limits<unsigned>::max();
   endIndex = std::numeric_limits<unsigned>::lowest();
 
@@ -104,7 +110,9 @@ RingmapData::RingmapData(const std::string& sequence, data_type&& dataMatrix,
       minimumModificationsPerBaseFraction(
           args.minimum_modifications_per_base_fraction()),
       sequence(sequence), baseCoverages(sequence.size(), nSetReads),
-      m_data(std::move(dataMatrix)), shape(args.shape()) {}
+      m_data(std::move(dataMatrix)), shape(args.shape()),
+      covarianceKernel(
+          ringmap_matrix::parseCovarianceKernel(args.covariance_kernel())) {}
 
 RingmapData::RingmapData(const std::string& sequence, data_type&& dataMatrix,
                          unsigned startIndex, unsigned endIndex)
@@ -114,7 +122,7 @@ RingmapData::RingmapData(const std::string& sequence, data_type&& dataMatrix,
 }
 
 RingmapData::RingmapData(const MutationMapTranscript& transcript,
-                         Args const& args)
+                         Args const& args, unsigned decodingThreads)
     : startIndex(0),
       endIndex(static_cast<unsigned>(transcript.getSequence().size())),
       nSetReads(transcript.getReadsSize()),
@@ -124,8 +132,76 @@ RingmapData::RingmapData(const MutationMapTranscript& transcript,
       minimumModificationsPerBaseFraction(
           args.minimum_modifications_per_base_fraction()),
       sequence(transcript.getSequence()), baseCoverages(endIndex),
-      m_data(nSetReads, endIndex), shape(args.shape()) {
-  addReads(ranges::begin(transcript), ranges::end(transcript));
+      m_data(nSetReads, endIndex), shape(args.shape()),
+      covarianceKernel(
+          ringmap_matrix::parseCovarianceKernel(args.covariance_kernel())) {
+  if (decodingThreads > 1 and transcript.isMemoryMapped() and
+      nSetReads > decodingChunkReads)
+    addReadsConcurrently(transcript, decodingThreads);
+  else if (transcript.hasReadViews()) {
+    auto views = transcript.views();
+    addReads(ranges::begin(views), ranges::end(views));
+  } else
+    addReads(ranges::begin(transcript), ranges::end(transcript));
+
+  if (args.collapse_duplicate_reads()) {
+    m_data.collapseDuplicateRows();
+    nSetReads = m_data.storedReads();
+  }
+}
+
+void
+RingmapData::addReadsConcurrently(const MutationMapTranscript& transcript,
+                                  unsigned decodingThreads) {
+  auto const chunks = transcript.chunks(decodingChunkReads);
+  assert(ranges::accumulate(chunks, 0u, std::plus<>{},
+                            &MutationMapTranscriptChunk::reads) == nSetReads);
+
+  auto const nThreads = static_cast<unsigned>(
+      std::min<std::size_t>(decodingThreads, chunks.size()));
+  std::atomic<std::size_t> nextChunk(0);
+  std::vector<std::vector<unsigned>> threadsCoverages(
+      nThreads, std::vector<unsigned>(baseCoverages.size(), 0));
+  std::vector<std::exception_ptr> threadsExceptions(nThreads);
+
+  auto decodeChunks = [&](unsigned threadIndex) {
+    auto& coverages = threadsCoverages[threadIndex];
+    try {
+      for (;;) {
+        auto const chunkIndex =
+            nextChunk.fetch_add(1, std::memory_order_relaxed);
+        if (chunkIndex >= chunks.size())
+          break;
+
+        transcript.forEachChunkRead(
+            chunks[chunkIndex], [&](unsigned readIndex, auto&& read) {
+              for (unsigned base = read.begin; base < read.end; ++base)
+                ++coverages[base];
+              m_data.setRead(readIndex, read);
+            });
+      }
+    } catch (...) {
+      threadsExceptions[threadIndex] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(nThreads - 1);
+  for (unsigned threadIndex = 1; threadIndex < nThreads; ++threadIndex)
+    threads.emplace_back(decodeChunks, threadIndex);
+  decodeChunks(0);
+  for (auto& thread : threads)
+    thread.join();
+
+  for (auto&& exception : threadsExceptions) {
+    if (exception)
+      std::rethrow_exception(exception);
+  }
+
+  for (auto&& coverages : threadsCoverages)
+    ranges::transform(baseCoverages, coverages, ranges::begin(baseCoverages),
+                      std::plus<>{});
+  m_data.resize(nSetReads);
 }
 
 RingmapData::RingmapData(const RingmapData& other,
@@ -147,7 +223,7 @@ RingmapData::RingmapData(const RingmapData& other,
       oldColsToNew(other.oldColsToNew),
       m_data(static_cast<unsigned>(subsetIndices.size()),
              other.m_data.cols_size()),
-      shape(other.shape) {
+      shape(other.shape), covarianceKernel(other.covarianceKernel) {
   m_data.resize(static_cast<unsigned>(subsetIndices.size()));
   unsigned row = 0;
   for (unsigned index : subsetIndices)
@@ -158,7 +234,7 @@ void
 RingmapData::filterBases() {
   assert(basesFiltered or
          ranges::all_of(baseCoverages,
-                        [nReads = m_data.rows_size()](unsigned coverage) {
+                        [nReads = m_data.totalReads()](unsigned coverage) {
                           return coverage <= nReads;
                         }));
 
@@ -216,11 +292,11 @@ RingmapData::filterBases() {
           usedCols.emplace_back(colIndex);
           newOldColsToNew.emplace(baseIndex, new_n_cols);
           filtered.col(new_n_cols++) =
-              m_data.col(static_cast<unsigned>(colIndex));
+              std::as_const(m_data).col(static_cast<unsigned>(colIndex));
         };
 
         auto const modificationsOnCol = static_cast<double>(
-            m_data.col(static_cast<unsigned>(colIndex)).sum());
+            std::as_const(m_data).col(static_cast<unsigned>(colIndex)).sum());
         if (not basesFiltered) {
           if (baseCoverages[colIndex] >= minimumCoverage and
               modificationsOnCol / baseCoverages[colIndex] >
@@ -268,9 +344,10 @@ RingmapData::filterReads() {
   unsigned new_n_rows = 0;
 
   for (unsigned row = 0; row < m_data.rows_size(); ++row) {
-    if (m_data.row(row).sum() >= minimumModificationsPerRead) {
+    // Read through const accessors, to avoid detaching shared rows
+    if (std::as_const(m_data).row(row).sum() >= minimumModificationsPerRead) {
       newReadsMap.emplace_back(readsMap[row]);
-      filtered.row(new_n_rows++) = m_data.row(row);
+      filtered.row(new_n_rows++) = std::as_const(m_data).row(row);
     }
   }
 
@@ -288,11 +365,28 @@ RingmapData::filter() {
   filterReads();
 }
 
+void
+RingmapData::expandDuplicateReads() {
+  if (not m_data.hasMultiplicities())
+    return;
+
+  if (not readsMap.empty()) {
+    decltype(readsMap) expandedReadsMap;
+    expandedReadsMap.reserve(m_data.totalReads());
+    for (unsigned row = 0; row < m_data.rows_size(); ++row)
+      expandedReadsMap.insert(ranges::end(expandedReadsMap),
+                              std::as_const(m_data).row(row).multiplicity(),
+                              readsMap[row]);
+    readsMap = std::move(expandedReadsMap);
+  }
+
+  m_data.expandDuplicateRows();
+  nSetReads = m_data.storedReads();
+}
+
 void
 RingmapData::perturb() {
-  std::mt19937 randomGenerator(std::random_device{}());
-  for (auto&& col : m_data.cols())
-    col.shuffle(randomGenerator);
+  perturb(std::mt19937(std::random_device{}()));
 }
 
 auto
@@ -457,7 +551,10 @@ RingmapData::resize(unsigned size) {
 
 std::size_t
 RingmapData::size() const {
-  return nSetReads;
+  if (m_data.hasMultiplicities())
+    return m_data.totalReads();
+  else
+    return nSetReads;
 }
 
 const std::vector<unsigned>&
@@ -483,6 +580,11 @@ RingmapData::getBaseWeights() const {
   return cachedBaseWeights;
 }
 
+ringmap_matrix::CovarianceKernel
+RingmapData::getCovarianceKernel() const noexcept {
+  return covarianceKernel;
+}
+
 unsigned
 RingmapData::getModificationsFilter() const {
   return modificationsFilter;
@@ -584,9 +686,9 @@ RingmapData::fractionReadsByWeights(const WeightedClusters& weights) const
     auto indices = std::cref(read.modifiedIndices());
     if (auto uniqueReadIter = uniqueReadsCount.find(indices);
         uniqueReadIter != ranges::end(uniqueReadsCount))
-      ++uniqueReadIter->second;
+      uniqueReadIter->second += read.multiplicity();
     else
-      uniqueReadsCount[indices] = 1;
+      uniqueReadsCount[indices] = read.multiplicity();
   }
 
   std::vector<std::size_t> counts(usableWeights.getClustersSize(), 0);
@@ -683,7 +785,7 @@ RingmapData::setBasesMask(arma::Col<std::uint8_t> mask) {
 
 double
 RingmapData::getUnfoldedFraction() const {
-  arma::mat frequencies = m_data.covariance();
+  arma::mat frequencies = m_data.covariance(covarianceKernel);
   {
     arma::vec coverages(baseCoverages.size());
     ranges::copy(baseCoverages, ranges::begin(coverages));
@@ -840,51 +942,97 @@ RingmapData::remapPatterns(const clusters_pattern_type& patterns) const
   return mappedPatterns;
 }
 
-void
-RingmapData::enqueueRingmapsFromMutationMap(
-    MutationMap& mutationMap,
-    parallel::blocking_queue<std::pair<MutationMapTranscript, RingmapData>>&
-        queue,
-    Args const& args) {
+static std::vector<std::string>
+read_whitelist(std::string const& whitelist_filename) noexcept(false) {
+  std::vector<std::string> whitelisted_genes;
+  {
+    std::ifstream whitelist_stream(whitelist_filename);
+    for (std::string line; std::getline(whitelist_stream, line);
+         line.clear()) {
+      ranges::transform(line, ranges::begin(line), [](char c) {
+        return static_cast<char>(std::tolower(c));
+      });
+      whitelisted_genes.emplace_back(std::move(line));
+    }
+  }
+
+  ranges::sort(whitelisted_genes);
+  return whitelisted_genes;
+}
+
+std::vector<const MutationMapIndexEntry*>
+RingmapData::getIndexedTranscriptsEntries(MutationMap const& mutationMap,
+                                          Args const& args) {
+  auto&& entries = mutationMap.getIndexEntries();
+  std::vector<const MutationMapIndexEntry*> out;
+  out.reserve(entries.size());
 
   if (auto const& whitelist_filename = args.whitelist();
       whitelist_filename.empty()) {
-    for (auto&& transcript : mutationMap)
-      queue.push(std::pair(transcript, RingmapData(transcript, args)));
+    for (auto&& entry : entries)
+      out.emplace_back(&entry);
   } else {
-    std::vector<std::string> whitelisted_genes;
-    {
-      std::ifstream whitelist_stream(whitelist_filename);
-      for (std::string line; std::getline(whitelist_stream, line);
-           line.clear()) {
-        ranges::transform(line, ranges::begin(line), [](char c) {
-          return static_cast<char>(std::tolower(c));
-        });
-        whitelisted_genes.emplace_back(std::move(line));
-      }
+    for (auto&& transcriptId : read_whitelist(whitelist_filename)) {
+      ranges::copy(mutationMap.findIndexEntries(transcriptId),
+                   ranges::back_inserter(out));
     }
 
-    ranges::sort(whitelisted_genes);
-    std::string transcriptId;
-    for (auto&& transcript : mutationMap) {
-      transcriptId = transcript.getId();
-      ranges::transform(transcriptId, ranges::begin(transcriptId), [](char c) {
-        return static_cast<char>(std::tolower(c));
-      });
-
-      if (ranges::binary_search(whitelisted_genes, transcriptId)) {
-        queue.push(std::pair(transcript, RingmapData(transcript, args)));
-      }
-    }
+    // Keep the file order, so that transcripts are read sequentially
+    ranges::sort(out, {}, &MutationMapIndexEntry::offset);
+    out.erase(ranges::unique(out), ranges::end(out));
   }
 
-  queue.finish();
+  return out;
+}
+
+std::size_t
+RingmapData::memoryUsage() const {
+  return m_data.memoryUsage() + baseCoverages.capacity() * sizeof(unsigned) +
+         sequence.capacity();
+}
+
+std::size_t
+RingmapData::estimateMemoryUsage(const MutationMapIndexEntry& entry,
+                                 unsigned formatVersion) {
+  std::size_t const reads = entry.reads;
+  auto const size = static_cast<std::size_t>(entry.size);
+
+  /* In v1 maps the mutations are stored as 32 bit integers after 12 bytes of
+   * read header, while in v2 maps each mutation takes at least one byte. */
+  std::size_t mutationsBytes;
+  if (formatVersion == 1)
+    mutationsBytes = size > reads * 12 ? size - reads * 12 : 0;
+  else
+    mutationsBytes = size * sizeof(ringmap_matrix::base_index_type);
+
+  return reads * sizeof(ringmap_matrix::row_type) + mutationsBytes +
+         std::size_t(entry.sequenceLength) * (sizeof(unsigned) + 1);
 }
 
 RingmapData
 RingmapData::get_new_range(
     unsigned begin, unsigned end,
     std::vector<unsigned>* const used_reads_indices) const {
+  return get_new_range_from_rows(
+      begin, end, ranges::view::iota(0u, m_data.rows_size()),
+      used_reads_indices);
+}
+
+RingmapData
+RingmapData::get_new_range(
+    unsigned begin, unsigned end, const RingmapMatrixIntervalIndex& readsIndex,
+    std::vector<unsigned>* const used_reads_indices) const {
+  assert(readsIndex.rows_size() == m_data.rows_size());
+  return get_new_range_from_rows(begin, end,
+                                 readsIndex.coveringRows(begin, end),
+                                 used_reads_indices);
+}
+
+template <typename Rows>
+RingmapData
+RingmapData::get_new_range_from_rows(
+    unsigned begin, unsigned end, Rows&& rows,
+    std::vector<unsigned>* const used_reads_indices) const {
   assert(not basesFiltered);
   assert(oldColsToNew.empty());
   assert(begin >= startIndex);
@@ -907,13 +1055,10 @@ RingmapData::get_new_range(
   new_ringmap.baseCoverages.resize(end - begin, 0);
   new_ringmap.m_data = RingmapMatrix(end - begin);
   new_ringmap.shape = shape;
+  new_ringmap.covarianceKernel = covarianceKernel;
 
-  auto&& rows = m_data.rows();
-  auto rows_iter = ranges::begin(rows);
-  auto const end_rows = ranges::end(rows);
-
-  for (unsigned row_index = 0; rows_iter < end_rows; ++rows_iter, ++row_index) {
-    auto&& row = *rows_iter;
+  for (unsigned row_index : rows) {
+    auto&& row = m_data.row(row_index);
 
     assert(row.begin_index() <= row.end_index());
     if (row.begin_index() <= begin and row.end_index() >= end) {
@@ -940,12 +1085,14 @@ RingmapData::get_new_range(
       ranges::transform(first_index_iter, last_index_iter,
                         ranges::begin(new_row),
                         [begin](auto&& index) { return index - begin; });
+      new_row.multiplicity = row.multiplicity();
       new_ringmap.m_data.addModifiedIndicesRow(std::move(new_row));
     }
   }
 
   new_ringmap.nSetReads = static_cast<unsigned>(new_ringmap.m_data.rows_size());
-  ranges::fill(new_ringmap.baseCoverages, new_ringmap.nSetReads);
+  ranges::fill(new_ringmap.baseCoverages,
+               static_cast<unsigned>(new_ringmap.m_data.totalReads()));
 
   return new_ringmap;
 }
@@ -1117,6 +1264,7 @@ RingmapData::split_into_windows(
     ranges::transform(
         first_index_iter, last_index_iter, ranges::begin(new_row),
         [begin = window.begin_index](auto&& index) { return index - begin; });
+    new_row.multiplicity = row.multiplicity();
     ringmap.m_data.addModifiedIndicesRow(std::move(new_row));
 
     auto const base_coverages_begin = std::begin(ringmap.baseCoverages);
@@ -1125,7 +1273,9 @@ RingmapData::split_into_windows(
     std::transform(
         first_base_cov,
         std::next(base_coverages_begin, new_row_end - window.begin_index),
-        first_base_cov, [](auto base_coverage) { return base_coverage + 1; });
+        first_base_cov, [multiplicity = row.multiplicity()](auto base_coverage) {
+          return base_coverage + multiplicity;
+        });
   }
 
   for (auto& ringmap : splitted_ringmaps) {
@@ -1,17 +1,20 @@
 #pragma once
 
 #include "args.hpp"
-#include "parallel/blocking_queue.hpp"
+#include "mutation_map_index.hpp"
 #include "ringmap_matrix.hpp"
+#include "ringmap_matrix_interval_index.hpp"
 #include "weighted_clusters_impl.hpp"
 
 #include <array>
+#include <ios>
 #include <map>
 #include <string>
 #include <vector>
 
 class MutationMap;
 class MutationMapTranscript;
+struct MutationMapIndexEntry;
 class RnaSecondaryStructure;
 struct PairedRnaSecondaryStructure;
 
@@ -28,13 +31,16 @@ public:
   using data_type = RingmapMatrix;
   using data_value_type = RingmapMatrix::value_type;
   friend struct test::RingmapData;
+  friend class RingmapWindowView;
+  friend class RingmapColumnPermutations;
 
   RingmapData() = default;
   RingmapData(const std::string& sequence, data_type&& dataMatrix,
               unsigned startIndex, unsigned endIndex, Args const& args);
   RingmapData(const std::string& filename, const std::string& sequence,
               Args const& args, bool keepFragments = true);
-  RingmapData(const MutationMapTranscript& transcript, Args const& args);
+  RingmapData(const MutationMapTranscript& transcript, Args const& args,
+              unsigned decodingThreads = 1);
   template <typename Iter>
   RingmapData(const std::string& sequence, unsigned nReads, Iter readsBegin,
               Iter readsEnd, Args const& args);
@@ -52,6 +58,9 @@ public:
   void filterReads();
   void filter();
   void perturb();
+  /* Same as perturb(), drawing from the given random generator */
+  template <typename URBG>
+  void perturb(URBG&& randomGenerator);
   void shuffle();
   void resize(unsigned size);
   const data_type& data() const;
@@ -76,6 +85,11 @@ public:
   void setBasesMask(arma::Col<std::uint8_t> mask);
   RingmapData get_new_range(unsigned begin, unsigned end,
                             std::vector<unsigned>* const = nullptr) const;
+  /* Same as above, but only visits the reads covering the range. The index
+   * must have been built on data(). */
+  RingmapData get_new_range(unsigned begin, unsigned end,
+                            const RingmapMatrixIntervalIndex& readsIndex,
+                            std::vector<unsigned>* const = nullptr) const;
 
   WeightedClusters getUnfilteredWeights(const WeightedClusters& weights) const;
 
@@ -92,16 +106,26 @@ public:
 
   double getUnfoldedFraction() const;
 
-  static void enqueueRingmapsFromMutationMap(
-      MutationMap& mutationMap,
-      parallel::blocking_queue<std::pair<MutationMapTranscript, RingmapData>>&
-          queue,
-      Args const& args);
+  static std::vector<const MutationMapIndexEntry*>
+  getIndexedTranscriptsEntries(MutationMap const& mutationMap,
+                               Args const& args);
+
+  /* Approximate number of bytes used by the reads */
+  std::size_t memoryUsage() const;
+  /* Estimates memoryUsage() before decoding a transcript, from its index entry
+   */
+  static std::size_t estimateMemoryUsage(const MutationMapIndexEntry& entry,
+                                         unsigned formatVersion);
 
 private:
   RingmapData(const std::string& sequence, data_type&& dataMatrix,
               unsigned startIndex, unsigned endIndex);
 
+  template <typename Rows>
+  RingmapData get_new_range_from_rows(unsigned begin, unsigned end,
+                                      Rows&& rows,
+                                      std::vector<unsigned>* const) const;
+
 #ifndef NDEBUG
   bool allowedMismatches = false;
 #endif
@@ -122,6 +146,8 @@ private:
   data_type m_data;
   arma::Col<std::uint8_t> basesMask;
   bool shape = false;
+  ringmap_matrix::CovarianceKernel covarianceKernel =
+      ringmap_matrix::CovarianceKernel::automatic;
 
 public:
   const decltype(oldColsToNew)& getNonFilteredToFilteredMap() const;
@@ -129,12 +155,20 @@ public:
   const decltype(readsMap)& getReadsMap() const;
   const std::vector<unsigned>& getBaseCoverages() const;
   const std::vector<double>& getBaseWeights() const;
+  ringmap_matrix::CovarianceKernel getCovarianceKernel() const noexcept;
   std::vector<RingmapData>
   split_into_windows(std::vector<results::Window> const& windows) &&;
 
 private:
+  /* Number of reads in each chunk decoded by a thread, for v1 maps. The index
+   * stores the offsets of these chunks. */
+  static constexpr unsigned decodingChunkReads = MutationMapIndex::chunkReads;
+
   template <typename Iter>
   void addReads(Iter begin, Iter end);
+  void addReadsConcurrently(const MutationMapTranscript& transcript,
+                            unsigned decodingThreads);
+  void expandDuplicateReads();
 };
 
 #include "ringmap_data_impl.hpp"
@@ -14,7 +14,9 @@ RingmapData::RingmapData(const std::string& sequence, unsigned nReads,
       minimumModificationsPerBaseFraction(
           args.minimum_modifications_per_base_fraction()),
       sequence(sequence), baseCoverages(endIndex, 0), m_data(nReads, endIndex),
-      shape(args.shape()) {
+      shape(args.shape()),
+      covarianceKernel(
+          ringmap_matrix::parseCovarianceKernel(args.covariance_kernel())) {
   addReads(std::move(readsBegin), std::move(readsEnd));
 }
 
@@ -65,6 +67,17 @@ RingmapData::from(T&& other) {
   ringmap.allowedMismatches = other.allowedMismatches;
 #endif
   ringmap.shape = other.shape;
+  ringmap.covarianceKernel = other.covarianceKernel;
 
   return ringmap;
 }
+
+template <typename URBG>
+void
+RingmapData::perturb(URBG&& randomGenerator) {
+  // Permutations act on single reads
+  expandDuplicateReads();
+
+  for (auto&& col : m_data.cols())
+    col.shuffle(randomGenerator);
+}
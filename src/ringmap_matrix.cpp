@@ -11,13 +11,13 @@ RingmapMatrix::RingmapMatrix(unsigned nBases) noexcept(false)
     : bases(nBases), readsCount(0) {}
 
 RingmapMatrix::RingmapMatrix(unsigned nReads, unsigned nBases) noexcept(false)
-    : bases(nBases), readsCount(0), data(nReads) {}
+    : bases(nBases), readsCount(0), data(matrix_type(nReads)) {}
 
 void
 RingmapMatrix::addModifiedIndicesRow(row_type const& row) noexcept(false) {
   assert(row.end_index >= row.begin_index);
   assert(row.end_index - row.begin_index <= bases);
-  data.emplace_back(row);
+  data->emplace_back(row);
   ++readsCount;
 }
 
@@ -25,15 +25,15 @@ void
 RingmapMatrix::addModifiedIndicesRow(row_type&& row) noexcept(false) {
   assert(row.end_index >= row.begin_index);
   assert(row.end_index - row.begin_index <= bases);
-  data.emplace_back(std::move(row));
+  data->emplace_back(std::move(row));
   ++readsCount;
 }
 
 arma::vec
 RingmapMatrix::mean(unsigned char axis) const noexcept(false) {
-  unsigned divider;
+  double divider;
   if (axis == 0)
-    divider = readsCount;
+    divider = static_cast<double>(totalReads());
   else
     divider = bases;
 
@@ -44,16 +44,16 @@ arma::vec
 RingmapMatrix::sum(unsigned char axis) const noexcept(false) {
   if (axis == 0) {
     arma::vec out(bases, arma::fill::zeros);
-    for (const auto& readData : data) {
+    for (const auto& readData : *data) {
       for (unsigned index : readData)
-        out[index] += 1.;
+        out[index] += readData.multiplicity;
     }
 
     return out;
   } else {
     arma::vec out(readsCount);
     unsigned readIndex = 0;
-    for (const auto& readData : data)
+    for (const auto& readData : *data)
       out[readIndex++] = static_cast<double>(readData.size());
 
     return out;
@@ -61,29 +61,29 @@ RingmapMatrix::sum(unsigned char axis) const noexcept(false) {
 }
 
 auto
-RingmapMatrix::operator()(unsigned row, unsigned col) noexcept
+RingmapMatrix::operator()(unsigned row, unsigned col) noexcept(false)
     -> accessor_type {
   readsCount = std::max(row + 1, readsCount);
-  return {data.data() + row, col};
+  return {data->data() + row, col};
 }
 
 auto
 RingmapMatrix::operator()(unsigned row, unsigned col) const noexcept
     -> const_accessor_type {
-  return {data.data() + row, col};
+  return {data->data() + row, col};
 }
 
 void
 RingmapMatrix::remove_rows(unsigned begin, unsigned end) noexcept(false) {
   readsCount -= std::min(readsCount, end) - std::min(readsCount, begin);
-  data.erase(ranges::next(ranges::begin(data), begin),
-             ranges::next(ranges::begin(data), end));
+  data->erase(ranges::next(ranges::begin(*data), begin),
+              ranges::next(ranges::begin(*data), end));
 }
 
 void
-RingmapMatrix::remove_cols(unsigned begin, unsigned end) noexcept {
+RingmapMatrix::remove_cols(unsigned begin, unsigned end) noexcept(false) {
   bases -= std::min(bases, end) - std::min(bases, begin);
-  for (auto& row : data) {
+  for (auto& row : *data) {
     row.erase(ranges::remove_if(row,
                                 [begin, end](unsigned index) {
                                   return index >= begin and index < end;
@@ -94,8 +94,8 @@ RingmapMatrix::remove_cols(unsigned begin, unsigned end) noexcept {
 
 unsigned
 RingmapMatrix::rows_size() const noexcept {
-  assert(data.size() <= std::numeric_limits<unsigned>::max());
-  return static_cast<unsigned>(data.size());
+  assert(data->size() <= std::numeric_limits<unsigned>::max());
+  return static_cast<unsigned>(data->size());
 }
 
 unsigned
@@ -108,19 +108,44 @@ RingmapMatrix::storedReads() const noexcept {
   return readsCount;
 }
 
+std::size_t
+RingmapMatrix::totalReads() const noexcept {
+  return ranges::accumulate(*data | ranges::view::take(readsCount),
+                            std::size_t(0), std::plus<>{},
+                            &row_type::multiplicity);
+}
+
+std::size_t
+RingmapMatrix::memoryUsage() const noexcept {
+  return data->capacity() * sizeof(row_type) +
+         ranges::accumulate(*data, std::size_t(0), std::plus<>{},
+                            [](auto&& row) {
+                              return row.capacity() *
+                                     sizeof(ringmap_matrix::base_index_type);
+                            });
+}
+
+bool
+RingmapMatrix::hasMultiplicities() const noexcept {
+  return ranges::any_of(*data | ranges::view::take(readsCount),
+                        [](auto&& row) { return row.multiplicity != 1; });
+}
+
 auto
-RingmapMatrix::row(unsigned index) noexcept -> row_accessor {
+RingmapMatrix::row(unsigned index) noexcept(false) -> row_accessor {
   readsCount = std::max(index + 1, readsCount);
-  return {*this, data.data() + index};
+  return {*this, data->data() + index};
 }
 
 auto
 RingmapMatrix::row(unsigned index) const noexcept -> const_row_accessor {
-  return {*this, data.data() + index};
+  return {*this, data->data() + index};
 }
 
 auto
-RingmapMatrix::col(unsigned index) noexcept -> col_accessor {
+RingmapMatrix::col(unsigned index) noexcept(false) -> col_accessor {
+  // Detached here, so that the accessor never has to copy the rows
+  data.detach();
   return {*this, index};
 }
 
@@ -130,12 +155,13 @@ RingmapMatrix::col(unsigned index) const noexcept -> const_col_accessor {
 }
 
 void
-RingmapMatrix::shrink() noexcept {
-  data.resize(readsCount);
+RingmapMatrix::shrink() noexcept(false) {
+  data->resize(readsCount);
 }
 
 auto
-RingmapMatrix::rows() noexcept -> row_iterator_helper {
+RingmapMatrix::rows() noexcept(false) -> row_iterator_helper {
+  data.detach();
   return {*this};
 }
 
@@ -144,7 +170,8 @@ RingmapMatrix::rows() const noexcept -> const_row_iterator_helper {
   return {*this};
 }
 auto
-RingmapMatrix::cols() noexcept -> col_iterator_helper {
+RingmapMatrix::cols() noexcept(false) -> col_iterator_helper {
+  data.detach();
   return {*this};
 }
 
@@ -156,10 +183,20 @@ RingmapMatrix::cols() const noexcept -> const_col_iterator_helper {
 RingmapMatrix
 RingmapMatrix::t() const noexcept(false) {
   RingmapMatrix out(bases, readsCount);
+  {
+    std::vector<std::size_t> counts(bases, 0);
+    for (const auto& read : *data) {
+      for (unsigned index : read)
+        ++counts[index];
+    }
+    for (unsigned base = 0; base < bases; ++base)
+      (*out.data)[base].reserve(counts[base]);
+  }
+
   unsigned readIndex = 0;
-  for (const auto& read : data) {
+  for (const auto& read : *data) {
     for (unsigned index : read)
-      out.data[index].emplace_back(readIndex);
+      (*out.data)[index].emplace_back(readIndex);
     ++readIndex;
   }
   out.readsCount = bases;
@@ -168,28 +205,9 @@ RingmapMatrix::t() const noexcept(false) {
 }
 
 arma::mat
-RingmapMatrix::covariance() const noexcept(false) {
-  RingmapMatrix transposed = t();
-  assert(transposed.t() == *this);
-  arma::mat out(bases, bases, arma::fill::zeros);
-  for (unsigned row = 0; row < bases; ++row) {
-    const auto& rowVector = transposed.data[row];
-    for (unsigned col = row; col < bases; ++col) {
-      const auto& colVector = transposed.data[col];
-      unsigned count = static_cast<unsigned>(count_intersections(
-          ranges::begin(rowVector), ranges::end(rowVector),
-          ranges::begin(colVector), ranges::end(colVector)));
-
-#ifndef NDEBUG
-      if (row == col)
-        assert(count == colVector.size());
-#endif
-
-      out(row, col) = count;
-    }
-  }
-
-  return arma::symmatu(out);
+RingmapMatrix::covariance(ringmap_matrix::CovarianceKernel kernel) const
+    noexcept(false) {
+  return covariance(std::vector<double>(bases, 1.), kernel);
 }
 
 bool
@@ -197,8 +215,8 @@ RingmapMatrix::operator==(const RingmapMatrix& other) const noexcept {
   if (bases != other.bases or readsCount != other.readsCount)
     return false;
 
-  return ranges::equal(data | ranges::view::take(readsCount),
-                       other.data | ranges::view::take(readsCount));
+  return ranges::equal(*data | ranges::view::take(readsCount),
+                       *other.data | ranges::view::take(readsCount));
 }
 
 bool
@@ -206,36 +224,87 @@ RingmapMatrix::operator!=(const RingmapMatrix& other) const noexcept {
   if (bases != other.bases or readsCount != other.readsCount)
     return true;
 
-  auto const end = ranges::next(ranges::begin(data), readsCount);
+  auto const end = ranges::next(ranges::begin(*data), readsCount);
   auto mismatch = ranges::mismatch(
-      ranges::begin(data), end, ranges::begin(other.data),
-      ranges::next(ranges::begin(other.data), other.readsCount));
+      ranges::begin(*data), end, ranges::begin(*other.data),
+      ranges::next(ranges::begin(*other.data), other.readsCount));
   return mismatch.in1 != end;
 }
 
 void
 RingmapMatrix::append(const RingmapMatrix& other) noexcept(false) {
   assert(bases == other.bases);
-  data.resize(readsCount + other.readsCount);
-  ranges::copy(other.data | ranges::view::take(other.readsCount),
-               ranges::next(ranges::begin(data), readsCount));
+  data->resize(readsCount + other.readsCount);
+  ranges::copy(*other.data | ranges::view::take(other.readsCount),
+               ranges::next(ranges::begin(*data), readsCount));
   readsCount += other.readsCount;
 }
 
 void
-RingmapMatrix::shuffle() noexcept(std::is_nothrow_swappable_v<row_type>) {
+RingmapMatrix::collapseDuplicateRows() noexcept(false) {
+  data->resize(readsCount);
+  ranges::sort(*data);
+
+  auto outIter = ranges::begin(*data);
+  for (auto rowIter = ranges::begin(*data); rowIter != ranges::end(*data);) {
+    auto const sameEnd =
+        ranges::find_if(ranges::next(rowIter), ranges::end(*data),
+                        [&](auto&& row) { return row != *rowIter; });
+    auto const multiplicity =
+        ranges::accumulate(rowIter, sameEnd, 0u, std::plus<>{},
+                           &row_type::multiplicity);
+    if (outIter != rowIter)
+      *outIter = std::move(*rowIter);
+    outIter->multiplicity = multiplicity;
+    ++outIter;
+    rowIter = sameEnd;
+  }
+
+  data->erase(outIter, ranges::end(*data));
+  readsCount = static_cast<unsigned>(data->size());
+}
+
+void
+RingmapMatrix::expandDuplicateRows() noexcept(false) {
+  auto const nReads = totalReads();
+  assert(nReads <= std::numeric_limits<unsigned>::max());
+  if (nReads == readsCount)
+    return;
+
+  // Rows shared with other matrices are copied instead of being detached
+  bool const moveRows = not data.isShared();
+  matrix_type expanded;
+  expanded.reserve(nReads);
+  for (unsigned rowIndex = 0; rowIndex < readsCount; ++rowIndex) {
+    auto const& row = (*std::as_const(data))[rowIndex];
+    auto const multiplicity = row.multiplicity;
+    for (unsigned copy = 0; copy < multiplicity; ++copy) {
+      if (moveRows and copy + 1 == multiplicity)
+        expanded.push_back(std::move((*data)[rowIndex]));
+      else
+        expanded.push_back(row);
+      expanded.back().multiplicity = 1;
+    }
+  }
+
+  data = std::move(expanded);
+  readsCount = static_cast<unsigned>(nReads);
+}
+
+void
+RingmapMatrix::shuffle() noexcept(false) {
   std::random_device randomDevice;
   std::mt19937 randomGenerator(randomDevice());
-  ranges::shuffle(data, randomGenerator);
+  ranges::shuffle(*data, randomGenerator);
 }
 
 void
 RingmapMatrix::resize(unsigned size) noexcept(false) {
   readsCount = size;
-  data.resize(readsCount);
+  data->resize(readsCount);
 }
 
 auto
 RingmapMatrix::getIndices(unsigned rowIndex) const noexcept -> const row_type& {
-  return data[rowIndex];
+  return (*data)[rowIndex];
 }
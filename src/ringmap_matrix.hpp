@@ -1,6 +1,8 @@
 #pragma once
 
 #include "mutation_map_transcript_read.hpp"
+#include "ringmap_matrix_comutations.hpp"
+#include "mutation_map_transcript_read_view.hpp"
 #include "ringmap_matrix_accessor.hpp"
 #include "ringmap_matrix_col_accessor.hpp"
 #include "ringmap_matrix_col_iterator.hpp"
@@ -10,6 +12,8 @@
 #include "ringmap_matrix_row_iterator.hpp"
 #include "ringmap_matrix_traits.hpp"
 
+#include "copy_on_write.hpp"
+
 #include <vector>
 
 #include <armadillo>
@@ -59,20 +63,23 @@ public:
   explicit RingmapMatrix(unsigned nBases) noexcept(false);
   RingmapMatrix(unsigned nReads, unsigned nBases) noexcept(false);
 
-  accessor_type operator()(unsigned row, unsigned col) noexcept;
+  accessor_type operator()(unsigned row, unsigned col) noexcept(false);
   const_accessor_type operator()(unsigned row, unsigned col) const noexcept;
 
   template <typename Iterable>
   void addRead(Iterable&& iterable,
-               std::enable_if_t<not std::is_same<
-                   std::decay_t<Iterable>, MutationMapTranscriptRead>::value>* =
-                   nullptr) noexcept(false);
+               std::enable_if_t<not is_mutation_map_transcript_read_v<
+                   Iterable>>* = nullptr) noexcept(false);
+  template <typename TranscriptRead>
+  void addRead(TranscriptRead&& transcriptRead,
+               std::enable_if_t<is_mutation_map_transcript_read_v<
+                   TranscriptRead>>* = nullptr) noexcept(false);
+
+  /* Stores the read in an already allocated row, without changing the number
+   * of stored reads. Different rows can be set concurrently. */
   template <typename TranscriptRead>
-  void
-  addRead(TranscriptRead&& transcriptRead,
-          std::enable_if_t<std::is_same<std::decay_t<TranscriptRead>,
-                                        MutationMapTranscriptRead>::value>* =
-              nullptr) noexcept(false);
+  void setRead(unsigned rowIndex, TranscriptRead&& transcriptRead) noexcept(
+      false);
 
   void addModifiedIndicesRow(row_type const& row) noexcept(false);
   void addModifiedIndicesRow(row_type&& row) noexcept(false);
@@ -80,15 +87,20 @@ public:
   unsigned rows_size() const noexcept;
   unsigned cols_size() const noexcept;
   unsigned storedReads() const noexcept;
+  /* Number of reads, taking into account the multiplicity of the rows */
+  std::size_t totalReads() const noexcept;
+  bool hasMultiplicities() const noexcept;
+  /* Approximate number of bytes allocated for the rows */
+  std::size_t memoryUsage() const noexcept;
 
-  row_accessor row(unsigned index) noexcept;
+  row_accessor row(unsigned index) noexcept(false);
   const_row_accessor row(unsigned index) const noexcept;
-  col_accessor col(unsigned index) noexcept;
+  col_accessor col(unsigned index) noexcept(false);
   const_col_accessor col(unsigned index) const noexcept;
 
-  row_iterator_helper rows() noexcept;
+  row_iterator_helper rows() noexcept(false);
   const_row_iterator_helper rows() const noexcept;
-  col_iterator_helper cols() noexcept;
+  col_iterator_helper cols() noexcept(false);
   const_col_iterator_helper cols() const noexcept;
 
   bool operator==(const RingmapMatrix& other) const noexcept;
@@ -96,14 +108,21 @@ public:
   arma::vec mean(unsigned char axis = 0) const noexcept(false);
   arma::vec sum(unsigned char axis = 0) const noexcept(false);
   RingmapMatrix t() const noexcept(false);
-  arma::mat covariance() const noexcept(false);
+  /* The reads are converted to the CSR input of the kernels on each call, and
+   * transposed unless the gemm kernel is used */
+  arma::mat covariance(ringmap_matrix::CovarianceKernel kernel =
+                           ringmap_matrix::CovarianceKernel::automatic) const
+      noexcept(false);
   template <typename Weights>
-  arma::mat covariance(Weights&& baseWeights) const noexcept(false);
+  arma::mat covariance(Weights&& baseWeights,
+                       ringmap_matrix::CovarianceKernel kernel =
+                           ringmap_matrix::CovarianceKernel::automatic) const
+      noexcept(false);
 
   void remove_rows(unsigned begin, unsigned end) noexcept(false);
-  void remove_cols(unsigned begin, unsigned end) noexcept;
-  void shrink() noexcept;
-  void shuffle() noexcept(std::is_nothrow_swappable_v<row_type>);
+  void remove_cols(unsigned begin, unsigned end) noexcept(false);
+  void shrink() noexcept(false);
+  void shuffle() noexcept(false);
   void resize(unsigned size) noexcept(false);
   const row_type& getIndices(unsigned rowIndex) const noexcept;
 
@@ -112,10 +131,20 @@ public:
 
   void append(const RingmapMatrix& other) noexcept(false);
 
+  /* Merges identical rows into a single one, summing their multiplicities.
+   * Rows are sorted in the process. */
+  void collapseDuplicateRows() noexcept(false);
+  /* Replicates each row as many times as its multiplicity, the opposite of
+   * collapseDuplicateRows() */
+  void expandDuplicateRows() noexcept(false);
+
 private:
   unsigned bases;
   unsigned readsCount;
-  matrix_type data;
+  /* Rows are shared between copies of a matrix until they are modified. The
+   * non-const accessors and iterators detach the storage when they are
+   * created, the const ones never copy. */
+  CopyOnWrite<matrix_type> data;
 };
 
 #include "ringmap_matrix_impl.hpp"
@@ -13,6 +13,8 @@ template <typename Matrix>
 class RingmapMatrixColAccessor {
   template <typename>
   friend class RingmapMatrixColIterator;
+  template <typename>
+  friend class RingmapMatrixColAccessor;
   friend class RingmapMatrix;
 
 public:
@@ -25,25 +25,32 @@ RingmapMatrixColAccessor<Matrix>::size() const noexcept {
 template <typename Matrix>
 std::size_t
 RingmapMatrixColAccessor<Matrix>::sum() const noexcept {
-  return ranges::accumulate(*this, 0u);
+  std::size_t out = 0;
+  for (auto&& row :
+       *std::as_const(matrix->data) | ranges::view::take(matrix->readsCount)) {
+    if (ranges::binary_search(row, col))
+      out += row.multiplicity;
+  }
+  return out;
 }
 
 template <typename Matrix>
 double
 RingmapMatrixColAccessor<Matrix>::mean() const noexcept {
-  return static_cast<double>(sum()) / matrix->readsCount;
+  return static_cast<double>(sum()) /
+         static_cast<double>(matrix->totalReads());
 }
 
 template <typename Matrix>
 auto
 RingmapMatrixColAccessor<Matrix>::begin() const noexcept -> iterator {
-  return {*matrix, matrix->data.data(), col};
+  return {*matrix, matrix->data->data(), col};
 }
 
 template <typename Matrix>
 auto
 RingmapMatrixColAccessor<Matrix>::end() const noexcept -> iterator {
-  return {*matrix, matrix->data.data() + matrix->readsCount, col};
+  return {*matrix, matrix->data->data() + matrix->readsCount, col};
 }
 
 template <typename Matrix>
@@ -52,12 +59,12 @@ void
 RingmapMatrixColAccessor<Matrix>::shuffle(URBG&& g) const noexcept(false) {
   std::uniform_int_distribution<unsigned> distribution(0,
                                                        matrix->readsCount - 1);
-  for (auto&& row : matrix->data) {
+  for (auto&& row : *matrix->data) {
     auto colIter = ranges::lower_bound(row, col);
     if (colIter == ranges::end(row) or *colIter != col)
       continue;
 
-    auto& otherRow = matrix->data[distribution(g)];
+    auto& otherRow = (*matrix->data)[distribution(g)];
     if (ranges::binary_search(otherRow, col))
       continue;
 
@@ -123,7 +130,7 @@ operator=(RingmapMatrixColAccessor<RingmapMatrix&&>&& rhs) const noexcept(false)
 template <typename Matrix>
 RingmapMatrixAccessor<Matrix> RingmapMatrixColAccessor<Matrix>::
 operator[](std::size_t index) const noexcept {
-  return {matrix->data.data() + index, col};
+  return {matrix->data->data() + index, col};
 }
 
 template <typename Matrix>
@@ -131,18 +138,20 @@ template <typename Accessor>
 void
 RingmapMatrixColAccessor<Matrix>::copy_from_accessor(Accessor&& rhs) const
     noexcept(false) {
-  if (matrix->data.size() < rhs.matrix->data.size())
-    matrix->data.resize(rhs.matrix->data.size());
+  if (matrix->data->size() < rhs.matrix->data->size())
+    matrix->data->resize(rhs.matrix->data->size());
 
   if (matrix->readsCount < rhs.matrix->readsCount)
     matrix->readsCount = rhs.matrix->readsCount;
 
-  auto rowIter = ranges::begin(matrix->data);
-  auto const rowEnd = ranges::end(matrix->data);
-  auto rhsRowIter = ranges::begin(std::as_const(rhs.matrix->data));
+  auto rowIter = ranges::begin(*matrix->data);
+  auto const rowEnd = ranges::end(*matrix->data);
+  auto rhsRowIter = ranges::begin(*std::as_const(rhs.matrix->data));
   for (; rowIter < rowEnd; ++rowIter, ++rhsRowIter) {
     auto&& rhsRow = *rhsRowIter;
     auto& row = *rowIter;
+    // Rows are the same reads on both sides
+    row.multiplicity = rhsRow.multiplicity;
     if (ranges::find(rhsRow, rhs.col) == ranges::end(rhsRow))
       row.erase(ranges::remove(row, col), ranges::end(row));
     else if (ranges::find(row, col) == ranges::end(row)) {
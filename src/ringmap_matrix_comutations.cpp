@@ -0,0 +1,379 @@
+#include "ringmap_matrix_comutations.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+
+#if defined(__GNUC__) and defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace ringmap_matrix {
+
+namespace {
+
+/* 256 words are 16384 reads, 2 KiB for each base */
+constexpr std::size_t bitsetBlockWords = 256;
+
+/* Reads densified at once by the GEMM kernel */
+constexpr unsigned gemmBlockReads = 4096;
+
+/* Number of bits set in the AND of two bitsets of the given number of words.
+ * The implementation is chosen once at startup from the features of the CPU,
+ * because the default build targets the baseline x86-64, where the builtin
+ * popcount is a library call. */
+using AndPopcountFunction = std::uint64_t (*)(const std::uint64_t*,
+                                              const std::uint64_t*,
+                                              std::size_t) noexcept;
+
+std::uint64_t
+andPopcountGeneric(const std::uint64_t* lhs, const std::uint64_t* rhs,
+                   std::size_t words) noexcept {
+  std::uint64_t count = 0;
+  for (std::size_t word = 0; word < words; ++word) {
+#if defined(__GNUC__)
+    count += static_cast<std::uint64_t>(
+        __builtin_popcountll(lhs[word] & rhs[word]));
+#else
+    count += std::bitset<64>(lhs[word] & rhs[word]).count();
+#endif
+  }
+  return count;
+}
+
+#if defined(__GNUC__) and defined(__x86_64__)
+#define RINGMAP_MATRIX_POPCOUNT_DISPATCH
+
+__attribute__((target("popcnt"))) std::uint64_t
+andPopcountPopcnt(const std::uint64_t* lhs, const std::uint64_t* rhs,
+                  std::size_t words) noexcept {
+  std::uint64_t count = 0;
+  for (std::size_t word = 0; word < words; ++word)
+    count += static_cast<std::uint64_t>(
+        __builtin_popcountll(lhs[word] & rhs[word]));
+  return count;
+}
+
+/* Counts the bits of each nibble with a byte shuffle, then sums the bytes of
+ * each 64-bit lane */
+__attribute__((target("avx2,popcnt"))) std::uint64_t
+andPopcountAvx2(const std::uint64_t* lhs, const std::uint64_t* rhs,
+                std::size_t words) noexcept {
+  __m256i const lookup =
+      _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1,
+                       2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  __m256i const lowMask = _mm256_set1_epi8(0x0f);
+  __m256i const zero = _mm256_setzero_si256();
+
+  __m256i counts = zero;
+  std::size_t word = 0;
+  for (; word + 4 <= words; word += 4) {
+    __m256i const value = _mm256_and_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lhs + word)),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rhs + word)));
+    __m256i const lowNibbles = _mm256_and_si256(value, lowMask);
+    __m256i const highNibbles =
+        _mm256_and_si256(_mm256_srli_epi16(value, 4), lowMask);
+    __m256i const bytesCounts =
+        _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lowNibbles),
+                        _mm256_shuffle_epi8(lookup, highNibbles));
+    counts = _mm256_add_epi64(counts, _mm256_sad_epu8(bytesCounts, zero));
+  }
+
+  std::uint64_t count =
+      static_cast<std::uint64_t>(_mm256_extract_epi64(counts, 0)) +
+      static_cast<std::uint64_t>(_mm256_extract_epi64(counts, 1)) +
+      static_cast<std::uint64_t>(_mm256_extract_epi64(counts, 2)) +
+      static_cast<std::uint64_t>(_mm256_extract_epi64(counts, 3));
+  for (; word < words; ++word)
+    count += static_cast<std::uint64_t>(
+        __builtin_popcountll(lhs[word] & rhs[word]));
+  return count;
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq"))) std::uint64_t
+andPopcountAvx512(const std::uint64_t* lhs, const std::uint64_t* rhs,
+                  std::size_t words) noexcept {
+  __m512i counts = _mm512_setzero_si512();
+  std::size_t word = 0;
+  for (; word + 8 <= words; word += 8) {
+    __m512i const value = _mm512_and_si512(_mm512_loadu_si512(lhs + word),
+                                           _mm512_loadu_si512(rhs + word));
+    counts = _mm512_add_epi64(counts, _mm512_popcnt_epi64(value));
+  }
+
+  if (word < words) {
+    auto const mask = static_cast<__mmask8>((1u << (words - word)) - 1);
+    __m512i const value =
+        _mm512_and_si512(_mm512_maskz_loadu_epi64(mask, lhs + word),
+                         _mm512_maskz_loadu_epi64(mask, rhs + word));
+    counts = _mm512_add_epi64(counts, _mm512_popcnt_epi64(value));
+  }
+
+  std::array<std::uint64_t, 8> lanes;
+  _mm512_storeu_si512(lanes.data(), counts);
+  return std::accumulate(std::begin(lanes), std::end(lanes), std::uint64_t(0));
+}
+
+#endif
+
+/* The sparse kernel costs roughly a binary search for each modified index of
+ * each pair of bases, the bitset one a word for every 64 reads of each pair.
+ * The density from which the bitset kernel is faster depends on the popcount
+ * implementation, and was measured on random matrices of 5k to 100k reads and
+ * 100 to 200 bases. */
+struct AndPopcount {
+  AndPopcountFunction function;
+  double bitsetDensityThreshold;
+};
+
+AndPopcount
+selectAndPopcount() noexcept {
+#if defined(RINGMAP_MATRIX_POPCOUNT_DISPATCH)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512vpopcntdq"))
+    return {andPopcountAvx512, 1. / 4096.};
+  if (__builtin_cpu_supports("avx2"))
+    return {andPopcountAvx2, 1. / 2048.};
+  if (__builtin_cpu_supports("popcnt"))
+    return {andPopcountPopcnt, 1. / 1024.};
+#endif
+  return {andPopcountGeneric, 1. / 256.};
+}
+
+AndPopcount const andPopcount = selectAndPopcount();
+
+std::vector<unsigned>
+getUsedBasesIndices(const std::vector<bool>& usedBases) {
+  std::vector<unsigned> out;
+  out.reserve(usedBases.size());
+  for (unsigned base = 0; base < usedBases.size(); ++base) {
+    if (usedBases[base])
+      out.push_back(base);
+  }
+  return out;
+}
+
+} // namespace
+
+CovarianceKernel
+parseCovarianceKernel(const std::string& name) noexcept(false) {
+  if (name == "auto")
+    return CovarianceKernel::automatic;
+  else if (name == "sparse")
+    return CovarianceKernel::sparse;
+  else if (name == "bitset")
+    return CovarianceKernel::bitset;
+  else if (name == "gemm")
+    return CovarianceKernel::gemm;
+  else
+    throw std::runtime_error("invalid covariance kernel '" + name +
+                             "' (valid kernels: auto, sparse, bitset, gemm)");
+}
+
+arma::mat
+sparseComutations(const RingmapMatrixCsr& csr,
+                  const RingmapMatrixCsr& transposed,
+                  const std::vector<bool>& usedBases) noexcept(false) {
+  auto const bases = transposed.rows_size();
+  assert(usedBases.size() == bases);
+  bool const weightedRows = csr.hasMultiplicities();
+
+  arma::mat out(bases, bases, arma::fill::zeros);
+  auto const usedBasesIndices = getUsedBasesIndices(usedBases);
+  for (auto rowIter = std::begin(usedBasesIndices);
+       rowIter != std::end(usedBasesIndices); ++rowIter) {
+    auto const row = *rowIter;
+    auto const rowVector = transposed.row(row);
+    for (auto colIter = rowIter; colIter != std::end(usedBasesIndices);
+         ++colIter) {
+      auto const col = *colIter;
+      auto const colVector = transposed.row(col);
+      std::size_t count;
+      if (weightedRows)
+        count = sum_intersections_weights(
+            ranges::begin(rowVector), ranges::end(rowVector),
+            ranges::begin(colVector), ranges::end(colVector),
+            [&csr](unsigned readIndex) { return csr.multiplicity(readIndex); });
+      else {
+        count = count_intersections(
+            ranges::begin(rowVector), ranges::end(rowVector),
+            ranges::begin(colVector), ranges::end(colVector));
+        assert(row != col or
+               count == static_cast<std::size_t>(colVector.size()));
+      }
+
+      out(row, col) = static_cast<double>(count);
+    }
+  }
+
+  return out;
+}
+
+arma::mat
+bitsetComutations(const RingmapMatrixCsr& csr,
+                  const RingmapMatrixCsr& transposed,
+                  const std::vector<bool>& usedBases) noexcept(false) {
+  assert(not csr.hasMultiplicities());
+  auto const bases = transposed.rows_size();
+  assert(usedBases.size() == bases);
+
+  auto const usedBasesIndices = getUsedBasesIndices(usedBases);
+  auto const nUsed = usedBasesIndices.size();
+  std::size_t const words = (std::size_t(csr.rows_size()) + 63) / 64;
+
+  std::vector<std::uint64_t> bitsets(nUsed * words, 0);
+  for (std::size_t usedIndex = 0; usedIndex < nUsed; ++usedIndex) {
+    auto const bitset = bitsets.data() + usedIndex * words;
+    for (auto readIndex : transposed.row(usedBasesIndices[usedIndex]))
+      bitset[readIndex / 64] |= std::uint64_t(1) << (readIndex % 64);
+  }
+
+  std::vector<std::uint64_t> counts(nUsed * nUsed, 0);
+  for (std::size_t blockBegin = 0; blockBegin < words;
+       blockBegin += bitsetBlockWords) {
+    auto const blockEnd = std::min(blockBegin + bitsetBlockWords, words);
+    for (std::size_t rowIndex = 0; rowIndex < nUsed; ++rowIndex) {
+      auto const rowBitset = bitsets.data() + rowIndex * words;
+      for (std::size_t colIndex = rowIndex; colIndex < nUsed; ++colIndex) {
+        auto const colBitset = bitsets.data() + colIndex * words;
+        counts[rowIndex * nUsed + colIndex] +=
+            andPopcount.function(rowBitset + blockBegin,
+                                 colBitset + blockBegin,
+                                 blockEnd - blockBegin);
+      }
+    }
+  }
+
+  arma::mat out(bases, bases, arma::fill::zeros);
+  for (std::size_t rowIndex = 0; rowIndex < nUsed; ++rowIndex) {
+    for (std::size_t colIndex = rowIndex; colIndex < nUsed; ++colIndex)
+      out(usedBasesIndices[rowIndex], usedBasesIndices[colIndex]) =
+          static_cast<double>(counts[rowIndex * nUsed + colIndex]);
+  }
+
+  return out;
+}
+
+bool
+preferBitsetComutations(const RingmapMatrixCsr& csr) noexcept {
+  if (csr.hasMultiplicities() or csr.rows_size() == 0 or csr.cols_size() == 0)
+    return false;
+
+  auto const density =
+      static_cast<double>(csr.nonZeros()) /
+      (static_cast<double>(csr.rows_size()) * csr.cols_size());
+  return density >= andPopcount.bitsetDensityThreshold;
+}
+
+arma::mat
+comutations(const RingmapMatrixCsr& csr, const RingmapMatrixCsr& transposed,
+            const std::vector<bool>& usedBases,
+            CovarianceKernel kernel) noexcept(false) {
+  if (kernel == CovarianceKernel::automatic)
+    kernel = preferBitsetComutations(csr) ? CovarianceKernel::bitset
+                                          : CovarianceKernel::sparse;
+  if (kernel == CovarianceKernel::bitset and csr.hasMultiplicities())
+    kernel = CovarianceKernel::sparse;
+
+  switch (kernel) {
+  case CovarianceKernel::bitset:
+    return bitsetComutations(csr, transposed, usedBases);
+  case CovarianceKernel::sparse:
+    return sparseComutations(csr, transposed, usedBases);
+  default:
+    throw std::runtime_error("unsupported co-mutation kernel");
+  }
+}
+
+arma::mat
+gemmCovariance(const RingmapMatrixCsr& csr,
+               const std::vector<double>& baseScales) noexcept(false) {
+  auto const bases = csr.cols_size();
+  assert(baseScales.size() == bases);
+
+  std::vector<unsigned> usedBasesIndices;
+  std::vector<unsigned> compactIndices(bases, bases);
+  for (unsigned base = 0; base < bases; ++base) {
+    if (baseScales[base] != 0) {
+      compactIndices[base] = static_cast<unsigned>(usedBasesIndices.size());
+      usedBasesIndices.push_back(base);
+    }
+  }
+
+  arma::mat out(bases, bases, arma::fill::zeros);
+  if (usedBasesIndices.empty())
+    return out;
+
+  auto const nUsed = static_cast<arma::uword>(usedBasesIndices.size());
+  arma::mat compact(nUsed, nUsed, arma::fill::zeros);
+  arma::mat block;
+  auto const reads = csr.rows_size();
+  for (unsigned blockBegin = 0; blockBegin < reads;
+       blockBegin += gemmBlockReads) {
+    auto const blockEnd = std::min(blockBegin + gemmBlockReads, reads);
+    block.zeros(blockEnd - blockBegin, nUsed);
+    for (unsigned readIndex = blockBegin; readIndex < blockEnd; ++readIndex) {
+      double const readScale =
+          std::sqrt(static_cast<double>(csr.multiplicity(readIndex)));
+      for (auto base : csr.row(readIndex)) {
+        auto const compactIndex = compactIndices[base];
+        if (compactIndex != bases)
+          block(readIndex - blockBegin, compactIndex) =
+              readScale * baseScales[base];
+      }
+    }
+
+    compact += block.t() * block;
+  }
+
+  for (arma::uword row = 0; row < nUsed; ++row) {
+    for (arma::uword col = 0; col < nUsed; ++col)
+      out(usedBasesIndices[row], usedBasesIndices[col]) = compact(row, col);
+  }
+
+  return out;
+}
+
+arma::mat
+covariance(const RingmapMatrixCsr& csr, const RingmapMatrixCsr& transposed,
+           const std::vector<double>& baseWeights,
+           CovarianceKernel kernel) noexcept(false) {
+  auto const bases = csr.cols_size();
+  assert(baseWeights.size() == bases);
+  if (kernel == CovarianceKernel::gemm) {
+    std::vector<double> baseScales(bases);
+    for (unsigned base = 0; base < bases; ++base) {
+      double const baseWeight = baseWeights[base];
+      baseScales[base] = baseWeight == 0 ? 0. : 1. / std::sqrt(baseWeight);
+    }
+    return gemmCovariance(csr, baseScales);
+  }
+
+  assert(transposed.rows_size() == bases);
+  std::vector<bool> usedBases(bases);
+  for (unsigned base = 0; base < bases; ++base)
+    usedBases[base] = baseWeights[base] != 0;
+
+  arma::mat out = comutations(csr, transposed, usedBases, kernel);
+  for (unsigned row = 0; row < bases; ++row) {
+    if (not usedBases[row])
+      continue;
+
+    double const rowBaseWeight = baseWeights[row];
+    for (unsigned col = row; col < bases; ++col) {
+      if (usedBases[col])
+        out(row, col) /= std::sqrt(rowBaseWeight * baseWeights[col]);
+    }
+  }
+
+  return arma::symmatu(out);
+}
+
+} // namespace ringmap_matrix
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "ringmap_matrix_csr.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <armadillo>
+
+namespace ringmap_matrix {
+
+enum class CovarianceKernel { automatic, sparse, bitset, gemm };
+
+CovarianceKernel parseCovarianceKernel(const std::string& name) noexcept(false);
+
+/* Kernels computing, for every pair of used bases, how many reads are modified
+ * on both. Only the upper triangle of the result is filled. Both take the
+ * transposed CSR matrix (one row per base) and the original one, needed for
+ * the read multiplicities. */
+
+/* Intersects the sorted lists of reads of each pair of bases */
+arma::mat sparseComutations(const RingmapMatrixCsr& csr,
+                            const RingmapMatrixCsr& transposed,
+                            const std::vector<bool>& usedBases) noexcept(false);
+
+/* Packs the reads of each base in a bitset and counts the common ones with
+ * AND + popcount, processing blocks of reads to keep the bitsets in cache. The
+ * popcount uses AVX-512, AVX2 or the POPCNT instruction when the CPU has them.
+ * It does not support read multiplicities. */
+arma::mat bitsetComutations(const RingmapMatrixCsr& csr,
+                            const RingmapMatrixCsr& transposed,
+                            const std::vector<bool>& usedBases) noexcept(false);
+
+/* Chooses the bitset kernel when the matrix is dense enough for the packed
+ * scan to be cheaper than the list intersections, with a threshold depending
+ * on the popcount available */
+bool preferBitsetComutations(const RingmapMatrixCsr& csr) noexcept;
+
+arma::mat comutations(const RingmapMatrixCsr& csr,
+                      const RingmapMatrixCsr& transposed,
+                      const std::vector<bool>& usedBases,
+                      CovarianceKernel kernel = CovarianceKernel::automatic) noexcept(false);
+
+/* Computes the whole scaled covariance as a sum of X^T X products over dense
+ * blocks of reads, leaving the work to the BLAS syrk routine. Each modified
+ * base of a read contributes sqrt(multiplicity) * baseScales[base] to X, and
+ * bases with a zero scale are skipped. Unlike the other kernels, it returns
+ * the full symmetric matrix. */
+arma::mat gemmCovariance(const RingmapMatrixCsr& csr,
+                         const std::vector<double>& baseScales) noexcept(false);
+
+/* Weighted covariance of the matrix: the co-mutations of each pair of bases
+ * divided by the square root of the product of their weights. Bases with a
+ * zero weight are left out. The transposed matrix is not used by the gemm
+ * kernel, and can be left empty in that case. */
+arma::mat covariance(const RingmapMatrixCsr& csr,
+                     const RingmapMatrixCsr& transposed,
+                     const std::vector<double>& baseWeights,
+                     CovarianceKernel kernel = CovarianceKernel::automatic) noexcept(false);
+
+} // namespace ringmap_matrix
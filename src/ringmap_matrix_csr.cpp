@@ -0,0 +1,111 @@
+#include "ringmap_matrix_csr.hpp"
+#include "ringmap_matrix.hpp"
+
+#include <cassert>
+#include <range/v3/algorithm.hpp>
+
+RingmapMatrixCsr::RingmapMatrixCsr(const RingmapMatrix& matrix) noexcept(false)
+    : cols(matrix.cols_size()) {
+  auto const nRows = matrix.storedReads();
+  offsets.resize(nRows + 1);
+  beginIndices.resize(nRows);
+  endIndices.resize(nRows);
+
+  std::size_t nIndices = 0;
+  for (unsigned rowIndex = 0; rowIndex < nRows; ++rowIndex) {
+    nIndices += matrix.getIndices(rowIndex).size();
+    offsets[rowIndex + 1] = nIndices;
+  }
+
+  bool const weighted = matrix.hasMultiplicities();
+  if (weighted)
+    multiplicities.resize(nRows);
+
+  indices.resize(nIndices);
+  for (unsigned rowIndex = 0; rowIndex < nRows; ++rowIndex) {
+    auto const& row = matrix.getIndices(rowIndex);
+    ranges::copy(row, ranges::next(ranges::begin(indices),
+                                   static_cast<std::ptrdiff_t>(offsets[rowIndex])));
+    beginIndices[rowIndex] = row.begin_index;
+    endIndices[rowIndex] = row.end_index;
+    if (weighted)
+      multiplicities[rowIndex] = row.multiplicity;
+  }
+}
+
+RingmapMatrixCsr::RingmapMatrixCsr(unsigned cols,
+                                   std::vector<std::size_t> offsets,
+                                   std::vector<index_type> indices) noexcept(false)
+    : cols(cols), offsets(std::move(offsets)), indices(std::move(indices)) {
+  assert(not this->offsets.empty());
+  assert(this->offsets.back() == this->indices.size());
+  beginIndices.assign(rows_size(), 0);
+  endIndices.assign(rows_size(), cols);
+}
+
+unsigned
+RingmapMatrixCsr::rows_size() const noexcept {
+  return static_cast<unsigned>(offsets.size() - 1);
+}
+
+unsigned
+RingmapMatrixCsr::cols_size() const noexcept {
+  return cols;
+}
+
+std::size_t
+RingmapMatrixCsr::nonZeros() const noexcept {
+  return indices.size();
+}
+
+auto
+RingmapMatrixCsr::row(unsigned index) const noexcept -> row_view {
+  assert(index < rows_size());
+  return {indices.data() + offsets[index],
+          static_cast<std::ptrdiff_t>(offsets[index + 1] - offsets[index])};
+}
+
+auto
+RingmapMatrixCsr::begin_index(unsigned index) const noexcept -> index_type {
+  return beginIndices[index];
+}
+
+auto
+RingmapMatrixCsr::end_index(unsigned index) const noexcept -> index_type {
+  return endIndices[index];
+}
+
+unsigned
+RingmapMatrixCsr::multiplicity(unsigned index) const noexcept {
+  return multiplicities.empty() ? 1u : multiplicities[index];
+}
+
+bool
+RingmapMatrixCsr::hasMultiplicities() const noexcept {
+  return not multiplicities.empty();
+}
+
+RingmapMatrixCsr
+RingmapMatrixCsr::t() const noexcept(false) {
+  auto const nRows = rows_size();
+
+  RingmapMatrixCsr out;
+  out.cols = nRows;
+  out.offsets.assign(cols + 1, 0);
+  for (auto index : indices)
+    ++out.offsets[index + 1];
+  for (unsigned col = 0; col < cols; ++col)
+    out.offsets[col + 1] += out.offsets[col];
+
+  out.indices.resize(indices.size());
+  std::vector<std::size_t> positions(ranges::begin(out.offsets),
+                                     ranges::prev(ranges::end(out.offsets)));
+  for (unsigned rowIndex = 0; rowIndex < nRows; ++rowIndex) {
+    for (auto index : row(rowIndex))
+      out.indices[positions[index]++] = rowIndex;
+  }
+
+  out.beginIndices.assign(cols, 0);
+  out.endIndices.assign(cols, nRows);
+  return out;
+}
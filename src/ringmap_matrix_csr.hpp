@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ringmap_matrix_traits.hpp"
+
+#include <cstddef>
+#include <range/v3/view/span.hpp>
+#include <vector>
+
+class RingmapMatrix;
+
+/* Compressed sparse row input of the co-mutation kernels. The modified indices
+ * of all the rows are stored in a single contiguous array, delimited by the
+ * row offsets, and the read boundaries live in two parallel arrays.
+ *
+ * It is not the storage of RingmapMatrix, which keeps one vector per read:
+ * building it from a matrix copies all the indices. */
+class RingmapMatrixCsr {
+public:
+  using index_type = ringmap_matrix::base_index_type;
+  using row_view = ranges::span<const index_type>;
+
+  RingmapMatrixCsr() = default;
+  explicit RingmapMatrixCsr(const RingmapMatrix& matrix) noexcept(false);
+  /* Adopts already built arrays, the offsets delimiting each row inside the
+   * indices. Rows span all the columns and have a multiplicity of one. */
+  RingmapMatrixCsr(unsigned cols, std::vector<std::size_t> offsets,
+                   std::vector<index_type> indices) noexcept(false);
+
+  unsigned rows_size() const noexcept;
+  unsigned cols_size() const noexcept;
+  std::size_t nonZeros() const noexcept;
+  row_view row(unsigned index) const noexcept;
+  index_type begin_index(unsigned index) const noexcept;
+  index_type end_index(unsigned index) const noexcept;
+  unsigned multiplicity(unsigned index) const noexcept;
+  bool hasMultiplicities() const noexcept;
+
+  /* Transposes the matrix with a counting sort, so that every row of the
+   * result contains the sorted indices of the reads modified on a base. Read
+   * boundaries and multiplicities are not carried over. */
+  RingmapMatrixCsr t() const noexcept(false);
+
+private:
+  unsigned cols = 0;
+  std::vector<std::size_t> offsets{0};
+  std::vector<index_type> indices;
+  std::vector<index_type> beginIndices;
+  std::vector<index_type> endIndices;
+  // Empty when every row has a multiplicity of one
+  std::vector<unsigned> multiplicities;
+};
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "ringmap_matrix.hpp"
+#include "ringmap_matrix_comutations.hpp"
+#include "ringmap_matrix_csr.hpp"
 #include "ringmap_matrix_row.hpp"
 #include "utils.hpp"
 
@@ -11,12 +13,11 @@ template <typename Iterable>
 void
 RingmapMatrix::addRead(
     Iterable&& iterable,
-    std::enable_if_t<
-        not std::is_same<std::decay_t<Iterable>,
-                         MutationMapTranscriptRead>::value>*) noexcept(false) {
-  while (readsCount >= data.size())
-    data.emplace_back();
-  auto& read = data[readsCount++];
+    std::enable_if_t<not is_mutation_map_transcript_read_v<Iterable>>*) noexcept(
+        false) {
+  while (readsCount >= data->size())
+    data->emplace_back();
+  auto& read = (*data)[readsCount++];
   unsigned baseIndex = 0;
   for (auto&& element : iterable) {
     if (element == 1)
@@ -29,18 +30,34 @@ template <typename TranscriptRead>
 void
 RingmapMatrix::addRead(
     TranscriptRead&& transcriptRead,
-    std::enable_if_t<
-        std::is_same<std::decay_t<TranscriptRead>,
-                     MutationMapTranscriptRead>::value>*) noexcept(false) {
-  assert(ranges::is_sorted(transcriptRead.indices));
-  while (readsCount >= data.size())
-    data.emplace_back();
-  data[readsCount] = std::forward<TranscriptRead>(transcriptRead).indices;
-  data[readsCount].begin_index = transcriptRead.begin;
-  data[readsCount].end_index = transcriptRead.end;
+    std::enable_if_t<is_mutation_map_transcript_read_v<TranscriptRead>>*) noexcept(
+        false) {
+  while (readsCount >= data->size())
+    data->emplace_back();
+  setRead(readsCount, std::forward<TranscriptRead>(transcriptRead));
   ++readsCount;
 }
 
+template <typename TranscriptRead>
+void
+RingmapMatrix::setRead(unsigned rowIndex,
+                       TranscriptRead&& transcriptRead) noexcept(false) {
+  static_assert(is_mutation_map_transcript_read_v<TranscriptRead>);
+  assert(rowIndex < data->size());
+  assert(ranges::is_sorted(transcriptRead.indices));
+
+  // Rows are never shared here, concurrent calls do not detach the storage
+  auto& row = (*data)[rowIndex];
+  if constexpr (std::is_same<std::decay_t<TranscriptRead>,
+                             MutationMapTranscriptReadView>::value)
+    row.assign(ranges::begin(transcriptRead.indices),
+               ranges::end(transcriptRead.indices));
+  else
+    row = std::forward<TranscriptRead>(transcriptRead).indices;
+  row.begin_index = transcriptRead.begin;
+  row.end_index = transcriptRead.end;
+}
+
 template <typename Iterable>
 void
 RingmapMatrix::keepOnlyIndices(Iterable&& iterable) noexcept(false) {
@@ -55,52 +72,34 @@ RingmapMatrix::keepOnlyIndices(Iterable&& iterable) noexcept(false) {
     sortedIterable = localIterable.get();
   }
 
-  auto end = ranges::next(ranges::begin(data), readsCount);
+  auto end = ranges::next(ranges::begin(*data), readsCount);
   for (unsigned index = readsCount;;) {
     if (index == 0)
       break;
     --index;
 
     if (not ranges::binary_search(*sortedIterable, index))
-      data[index] = std::move(*--end);
+      (*data)[index] = std::move(*--end);
   }
   readsCount =
-      static_cast<unsigned>(ranges::distance(ranges::begin(data), end));
-  data.resize(readsCount);
+      static_cast<unsigned>(ranges::distance(ranges::begin(*data), end));
+  data->resize(readsCount);
 }
 
 template <typename Weights>
 arma::mat
-RingmapMatrix::covariance(Weights&& baseWeights) const noexcept(false) {
-  RingmapMatrix transposed = t();
-  assert(transposed.t() == *this);
-  arma::mat out(bases, bases, arma::fill::zeros);
-  for (unsigned row = 0; row < bases; ++row) {
-    double rowBaseWeight = baseWeights[row];
-    if (rowBaseWeight == 0)
-      continue;
-
-    const auto& rowVector = transposed.data[row];
-    for (unsigned col = row; col < bases; ++col) {
-      double colBaseWeight = baseWeights[col];
-      if (colBaseWeight == 0)
-        continue;
-
-      const auto& colVector = transposed.data[col];
-      std::size_t count =
-          count_intersections(ranges::begin(rowVector), ranges::end(rowVector),
-                              ranges::begin(colVector), ranges::end(colVector));
-
-#ifndef NDEBUG
-      if (row == col)
-        assert(count == colVector.size());
-#endif
-      out(row, col) =
-          static_cast<double>(count) / std::sqrt(rowBaseWeight * colBaseWeight);
-    }
-  }
+RingmapMatrix::covariance(Weights&& baseWeights,
+                          ringmap_matrix::CovarianceKernel kernel) const
+    noexcept(false) {
+  std::vector<double> weights(bases);
+  for (unsigned base = 0; base < bases; ++base)
+    weights[base] = baseWeights[base];
 
-  return arma::symmatu(out);
+  RingmapMatrixCsr const csr(*this);
+  if (kernel == ringmap_matrix::CovarianceKernel::gemm)
+    return ringmap_matrix::covariance(csr, {}, weights, kernel);
+  else
+    return ringmap_matrix::covariance(csr, csr.t(), weights, kernel);
 }
 
 static_assert(
@@ -0,0 +1,80 @@
+#include "ringmap_matrix_interval_index.hpp"
+#include "ringmap_matrix.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+RingmapMatrixIntervalIndex::RingmapMatrixIntervalIndex(
+    const RingmapMatrix& matrix) noexcept(false) {
+  auto const nRows = matrix.rows_size();
+  rowsByBegin.resize(nRows);
+  std::iota(std::begin(rowsByBegin), std::end(rowsByBegin), 0u);
+  std::stable_sort(std::begin(rowsByBegin), std::end(rowsByBegin),
+                   [&matrix](unsigned lhs, unsigned rhs) {
+                     return matrix.getIndices(lhs).begin_index <
+                            matrix.getIndices(rhs).begin_index;
+                   });
+
+  sortedBegins.resize(nRows);
+  std::transform(std::begin(rowsByBegin), std::end(rowsByBegin),
+                 std::begin(sortedBegins), [&matrix](unsigned row) {
+                   return matrix.getIndices(row).begin_index;
+                 });
+
+  leaves = 1;
+  while (leaves < nRows)
+    leaves *= 2;
+
+  maxEnds.assign(std::size_t(leaves) * 2,
+                 std::numeric_limits<index_type>::min());
+  for (unsigned sortedIndex = 0; sortedIndex < nRows; ++sortedIndex)
+    maxEnds[leaves + sortedIndex] =
+        matrix.getIndices(rowsByBegin[sortedIndex]).end_index;
+  for (unsigned node = leaves - 1; node > 0; --node)
+    maxEnds[node] = std::max(maxEnds[2 * node], maxEnds[2 * node + 1]);
+}
+
+unsigned
+RingmapMatrixIntervalIndex::rows_size() const noexcept {
+  return static_cast<unsigned>(rowsByBegin.size());
+}
+
+std::vector<unsigned>
+RingmapMatrixIntervalIndex::coveringRows(index_type begin,
+                                         index_type end) const noexcept(false) {
+  std::vector<unsigned> out;
+  auto const candidates = static_cast<unsigned>(
+      std::upper_bound(std::begin(sortedBegins), std::end(sortedBegins),
+                       begin) -
+      std::begin(sortedBegins));
+  if (candidates == 0)
+    return out;
+
+  // Nodes to visit, with the first sorted row they span
+  std::vector<std::pair<unsigned, unsigned>> nodes{{1u, 0u}};
+  unsigned nodeSpan = leaves;
+  std::vector<std::pair<unsigned, unsigned>> children;
+  while (not nodes.empty()) {
+    children.clear();
+    for (auto [node, first] : nodes) {
+      if (first >= candidates or maxEnds[node] < end)
+        continue;
+
+      if (nodeSpan == 1)
+        out.push_back(rowsByBegin[first]);
+      else {
+        children.emplace_back(2 * node, first);
+        children.emplace_back(2 * node + 1, first + nodeSpan / 2);
+      }
+    }
+
+    std::swap(nodes, children);
+    nodeSpan /= 2;
+  }
+
+  std::sort(std::begin(out), std::end(out));
+  return out;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ringmap_matrix_traits.hpp"
+
+#include <vector>
+
+class RingmapMatrix;
+
+/* Index over the read boundaries of a RingmapMatrix, to find the reads that
+ * fully cover a range without scanning all the rows.
+ *
+ * Rows are sorted by begin index, and a segment tree keeps the maximum end
+ * index of each span of sorted rows. A query only descends into the spans
+ * that start early enough and contain at least one read ending late enough,
+ * so it costs O((k + 1) log n) for k matching reads. The index is a snapshot:
+ * it must be rebuilt if the rows of the matrix change. */
+class RingmapMatrixIntervalIndex {
+public:
+  using index_type = ringmap_matrix::base_index_type;
+
+  RingmapMatrixIntervalIndex() = default;
+  explicit RingmapMatrixIntervalIndex(const RingmapMatrix& matrix) noexcept(
+      false);
+
+  unsigned rows_size() const noexcept;
+
+  /* Rows with begin_index <= begin and end_index >= end, in increasing order
+   */
+  std::vector<unsigned> coveringRows(index_type begin, index_type end) const
+      noexcept(false);
+
+private:
+  std::vector<unsigned> rowsByBegin;
+  std::vector<index_type> sortedBegins;
+  // Implicit segment tree, the leaves start at index `leaves`
+  std::vector<index_type> maxEnds;
+  unsigned leaves = 0;
+};
@@ -14,13 +14,13 @@ RingmapMatrixRowIteratorHelper<Matrix>::RingmapMatrixRowIteratorHelper(
 template <typename Matrix>
 auto
 RingmapMatrixRowIteratorHelper<Matrix>::begin() const noexcept -> iterator {
-  return {*matrix, matrix->data.data()};
+  return {*matrix, matrix->data->data()};
 }
 
 template <typename Matrix>
 auto
 RingmapMatrixRowIteratorHelper<Matrix>::end() const noexcept -> iterator {
-  return {*matrix, matrix->data.data() + matrix->readsCount};
+  return {*matrix, matrix->data->data() + matrix->readsCount};
 }
 
 template <typename Matrix>
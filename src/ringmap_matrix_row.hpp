@@ -20,6 +20,9 @@ struct RingmapMatrixRow : std::vector<ringmap_matrix::base_index_type> {
 
   base_index_type begin_index = std::numeric_limits<base_index_type>::max();
   base_index_type end_index = std::numeric_limits<base_index_type>::min();
+  /* Number of identical reads represented by this row. It does not take part
+   * in comparisons, which only consider the read itself. */
+  unsigned multiplicity = 1;
 };
 
 inline bool
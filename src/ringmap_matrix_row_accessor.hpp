@@ -76,6 +76,7 @@ public:
 
   ringmap_matrix::base_index_type begin_index() const noexcept;
   ringmap_matrix::base_index_type end_index() const noexcept;
+  unsigned multiplicity() const noexcept;
 
   void set_begin_index(ringmap_matrix::base_index_type value) noexcept;
   void set_end_index(ringmap_matrix::base_index_type value) noexcept;
@@ -21,7 +21,7 @@ RingmapMatrixRowAccessor<Matrix>::RingmapMatrixRowAccessor(
     std::enable_if_t<not std::is_const<M>::value, row_type* const> row) noexcept
     : matrix(&matrix), row(row) {
   matrix.readsCount = std::max(
-      static_cast<unsigned>(std::distance(matrix.data.data(), row)) + 1,
+      static_cast<unsigned>(row - std::as_const(matrix.data)->data()) + 1,
       matrix.readsCount);
 }
 
@@ -254,6 +254,13 @@ RingmapMatrixRowAccessor<Matrix>::end_index() const noexcept {
   return row->end_index;
 }
 
+template <typename Matrix>
+unsigned
+RingmapMatrixRowAccessor<Matrix>::multiplicity() const noexcept {
+  assert(matrix);
+  return row->multiplicity;
+}
+
 template <typename Matrix>
 void
 RingmapMatrixRowAccessor<Matrix>::set_begin_index(
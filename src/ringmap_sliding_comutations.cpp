@@ -0,0 +1,295 @@
+#include "ringmap_sliding_comutations.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+RingmapSlidingComutations::RingmapSlidingComutations(
+    const RingmapMatrix& matrix, unsigned windowSize) noexcept(false)
+    : matrix(&matrix), transposed(RingmapMatrixCsr(matrix).t()),
+      size(windowSize) {
+  if (windowSize == 0 or windowSize > matrix.cols_size())
+    throw std::runtime_error("invalid window size for sliding co-mutations");
+
+  auto const nReads = matrix.storedReads();
+  readsByBegin.resize(nReads);
+  std::iota(std::begin(readsByBegin), std::end(readsByBegin), 0u);
+  readsByEnd = readsByBegin;
+
+  std::stable_sort(std::begin(readsByBegin), std::end(readsByBegin),
+                   [&matrix](unsigned lhs, unsigned rhs) {
+                     return matrix.getIndices(lhs).begin_index <
+                            matrix.getIndices(rhs).begin_index;
+                   });
+  std::stable_sort(std::begin(readsByEnd), std::end(readsByEnd),
+                   [&matrix](unsigned lhs, unsigned rhs) {
+                     return matrix.getIndices(lhs).end_index <
+                            matrix.getIndices(rhs).end_index;
+                   });
+}
+
+void
+RingmapSlidingComutations::slideTo(unsigned newBegin) noexcept(false) {
+  if (newBegin + size > matrix->cols_size())
+    throw std::runtime_error("sliding co-mutations window out of range");
+
+  if (not initialized or newBegin < begin or newBegin >= begin + size) {
+    begin = newBegin;
+    rebuild();
+    return;
+  }
+
+  if (newBegin == begin)
+    return;
+
+  auto const oldBegin = begin;
+  auto const oldEnd = begin + size;
+  auto const newEnd = newBegin + size;
+
+  /* Reads ending before the new end leave the window */
+  {
+    auto const endLower = [this](unsigned readIndex, unsigned end) {
+      return matrix->getIndices(readIndex).end_index < end;
+    };
+    auto const first = std::lower_bound(
+        std::begin(readsByEnd), std::end(readsByEnd), oldEnd, endLower);
+    auto const last =
+        std::lower_bound(first, std::end(readsByEnd), newEnd, endLower);
+    for (auto readIter = first; readIter < last; ++readIter) {
+      auto const& read = matrix->getIndices(*readIter);
+      if (read.begin_index <= oldBegin) {
+        addRead(*readIter, -static_cast<double>(read.multiplicity));
+        --reads;
+      }
+    }
+  }
+
+  auto const shift = newBegin - oldBegin;
+  auto const overlap = size - shift;
+  {
+    arma::mat shifted(size, size, arma::fill::zeros);
+    shifted.submat(0, 0, overlap - 1, overlap - 1) =
+        comutations.submat(shift, shift, size - 1, size - 1);
+    comutations = std::move(shifted);
+  }
+  begin = newBegin;
+
+  /* The reads that stay only gain the mutations on the new bases */
+  for (unsigned base = oldEnd; base < newEnd; ++base) {
+    auto const newBase = base - newBegin;
+    for (auto readIndex : transposed.row(base)) {
+      auto const& read = matrix->getIndices(readIndex);
+      if (read.begin_index > oldBegin or read.end_index < newEnd)
+        continue;
+
+      auto const weight = static_cast<double>(read.multiplicity);
+      auto const first =
+          std::lower_bound(std::begin(read), std::end(read), newBegin);
+      auto const last = std::lower_bound(first, std::end(read), newEnd);
+      for (auto indexIter = first; indexIter < last; ++indexIter) {
+        auto const otherBase = *indexIter - newBegin;
+        comutations(newBase, otherBase) += weight;
+        if (*indexIter < oldEnd)
+          comutations(otherBase, newBase) += weight;
+      }
+    }
+  }
+
+  /* Reads starting in (oldBegin, newBegin] enter the window */
+  {
+    auto const beginLower = [this](unsigned readIndex, unsigned begin) {
+      return matrix->getIndices(readIndex).begin_index <= begin;
+    };
+    auto const first = std::lower_bound(
+        std::begin(readsByBegin), std::end(readsByBegin), oldBegin, beginLower);
+    auto const last =
+        std::lower_bound(first, std::end(readsByBegin), newBegin, beginLower);
+    for (auto readIter = first; readIter < last; ++readIter) {
+      auto const& read = matrix->getIndices(*readIter);
+      if (read.end_index >= newEnd) {
+        addRead(*readIter, static_cast<double>(read.multiplicity));
+        ++reads;
+      }
+    }
+  }
+}
+
+unsigned
+RingmapSlidingComutations::windowBegin() const noexcept {
+  return begin;
+}
+
+unsigned
+RingmapSlidingComutations::windowSize() const noexcept {
+  return size;
+}
+
+unsigned
+RingmapSlidingComutations::windowReads() const noexcept {
+  return reads;
+}
+
+const arma::mat&
+RingmapSlidingComutations::counts() const noexcept {
+  return comutations;
+}
+
+arma::mat
+RingmapSlidingComutations::covariance(const RingmapData& window,
+                                      const RingmapData& filtered) const
+    noexcept(false) {
+  assert(initialized);
+  if (window.data().rows_size() != reads or window.data().cols_size() != size)
+    throw std::runtime_error(
+        "window data does not match the sliding co-mutations window");
+
+  auto const nCols = filtered.data().cols_size();
+  std::vector<unsigned> windowBases(nCols);
+  std::vector<unsigned> filteredBases(size, nCols);
+  for (auto [filteredIndex, windowIndex] :
+       filtered.getFilteredToNonFilteredMap()) {
+    assert(filteredIndex < nCols and windowIndex < size);
+    windowBases[filteredIndex] = windowIndex;
+    filteredBases[windowIndex] = filteredIndex;
+  }
+
+  arma::mat out(nCols, nCols);
+  for (unsigned col = 0; col < nCols; ++col) {
+    for (unsigned row = 0; row < nCols; ++row)
+      out(row, col) = comutations(windowBases[row], windowBases[col]);
+  }
+
+  /* The reads discarded by the filtering are usually few, and each of them
+   * has only a handful of mutations on the remaining bases */
+  if (filtered.data().rows_size() != reads) {
+    auto const& readsMap = filtered.getReadsMap();
+    assert(std::is_sorted(std::begin(readsMap), std::end(readsMap)));
+
+    auto keptIter = std::begin(readsMap);
+    std::vector<unsigned> readBases;
+    for (unsigned readIndex = 0; readIndex < reads; ++readIndex) {
+      if (keptIter != std::end(readsMap) and *keptIter == readIndex) {
+        ++keptIter;
+        continue;
+      }
+
+      auto const& read = window.data().getIndices(readIndex);
+      readBases.clear();
+      for (auto base : read) {
+        if (filteredBases[base] != nCols)
+          readBases.push_back(filteredBases[base]);
+      }
+
+      auto const weight = static_cast<double>(read.multiplicity);
+      for (auto row : readBases) {
+        for (auto col : readBases)
+          out(row, col) -= weight;
+      }
+    }
+  }
+
+  auto const& baseWeights = filtered.getBaseWeights();
+  for (unsigned col = 0; col < nCols; ++col) {
+    for (unsigned row = 0; row < nCols; ++row) {
+      double const weight = baseWeights[row] * baseWeights[col];
+      if (weight == 0)
+        out(row, col) = 0.;
+      else
+        out(row, col) /= std::sqrt(weight);
+    }
+  }
+
+  return out;
+}
+
+arma::mat
+RingmapSlidingComutations::covariance(const RingmapWindowView& view) const
+    noexcept(false) {
+  assert(initialized);
+  if (view.begin_index() != begin or view.cols_size() != size or
+      view.rows_size() != reads)
+    throw std::runtime_error(
+        "window view does not match the sliding co-mutations window");
+
+  auto const& windowBases = view.getFilteredBases();
+  auto const nCols = static_cast<unsigned>(windowBases.size());
+  std::vector<unsigned> filteredBases(size, nCols);
+  for (unsigned filteredIndex = 0; filteredIndex < nCols; ++filteredIndex)
+    filteredBases[windowBases[filteredIndex]] = filteredIndex;
+
+  arma::mat out(nCols, nCols);
+  for (unsigned col = 0; col < nCols; ++col) {
+    for (unsigned row = 0; row < nCols; ++row)
+      out(row, col) = comutations(windowBases[row], windowBases[col]);
+  }
+
+  std::vector<unsigned> readBases;
+  for (unsigned readPosition = 0; readPosition < reads; ++readPosition) {
+    if (view.isReadKept(readPosition))
+      continue;
+
+    readBases.clear();
+    for (auto base : view.readIndices(readPosition)) {
+      if (filteredBases[base - begin] != nCols)
+        readBases.push_back(filteredBases[base - begin]);
+    }
+
+    auto const weight = static_cast<double>(view.readMultiplicity(readPosition));
+    for (auto row : readBases) {
+      for (auto col : readBases)
+        out(row, col) -= weight;
+    }
+  }
+
+  auto const baseWeights = view.getBaseWeights();
+  for (unsigned col = 0; col < nCols; ++col) {
+    for (unsigned row = 0; row < nCols; ++row) {
+      double const weight = baseWeights[row] * baseWeights[col];
+      if (weight == 0)
+        out(row, col) = 0.;
+      else
+        out(row, col) /= std::sqrt(weight);
+    }
+  }
+
+  return out;
+}
+
+void
+RingmapSlidingComutations::rebuild() noexcept(false) {
+  comutations.zeros(size, size);
+  reads = 0;
+
+  auto const end = begin + size;
+  for (auto readIndex : readsByBegin) {
+    auto const& read = matrix->getIndices(readIndex);
+    if (read.begin_index > begin)
+      break;
+
+    if (read.end_index >= end) {
+      addRead(readIndex, static_cast<double>(read.multiplicity));
+      ++reads;
+    }
+  }
+
+  initialized = true;
+}
+
+void
+RingmapSlidingComutations::addRead(unsigned readIndex, double weight) noexcept {
+  auto const& read = matrix->getIndices(readIndex);
+  auto const end = begin + size;
+  auto const first = std::lower_bound(std::begin(read), std::end(read), begin);
+  auto const last = std::lower_bound(first, std::end(read), end);
+  for (auto rowIter = first; rowIter < last; ++rowIter) {
+    auto const row = *rowIter - begin;
+    comutations(row, row) += weight;
+    for (auto colIter = std::next(rowIter); colIter < last; ++colIter) {
+      auto const col = *colIter - begin;
+      comutations(row, col) += weight;
+      comutations(col, row) += weight;
+    }
+  }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "ringmap_data.hpp"
+#include "ringmap_matrix.hpp"
+#include "ringmap_matrix_csr.hpp"
+#include "ringmap_window_view.hpp"
+
+#include <vector>
+
+#include <armadillo>
+
+/* Co-mutation counts of a window sliding along a transcript.
+ *
+ * The window contains the reads fully covering it, as in
+ * RingmapData::get_new_range. When the window moves forward, only the reads
+ * leaving or entering the window and the mutations on the newly covered bases
+ * are processed, so the cost of a slide is proportional to the churn instead
+ * of the size of the window. */
+class RingmapSlidingComutations {
+public:
+  /* The matrix must outlive this object */
+  RingmapSlidingComutations(const RingmapMatrix& matrix,
+                            unsigned windowSize) noexcept(false);
+
+  /* Moves the window to [begin, begin + windowSize). Moving backwards or past
+   * the current window rebuilds the counts from scratch. */
+  void slideTo(unsigned begin) noexcept(false);
+
+  unsigned windowBegin() const noexcept;
+  unsigned windowSize() const noexcept;
+  unsigned windowReads() const noexcept;
+  /* Multiplicity-weighted co-mutations, indexed relatively to the window */
+  const arma::mat& counts() const noexcept;
+
+  /* Returns the same matrix as RingmapMatrix::covariance for `filtered`, which
+   * must be obtained from `window`, the RingmapData of the current window,
+   * through base and read filtering. */
+  arma::mat covariance(const RingmapData& window,
+                       const RingmapData& filtered) const noexcept(false);
+  /* Same as RingmapWindowView::covariance, for a filtered view of the current
+   * window */
+  arma::mat covariance(const RingmapWindowView& view) const noexcept(false);
+
+private:
+  void rebuild() noexcept(false);
+  void addRead(unsigned readIndex, double weight) noexcept;
+
+  const RingmapMatrix* matrix;
+  RingmapMatrixCsr transposed;
+  std::vector<unsigned> readsByBegin;
+  std::vector<unsigned> readsByEnd;
+  unsigned size;
+  unsigned begin = 0;
+  unsigned reads = 0;
+  bool initialized = false;
+  arma::mat comutations;
+};
@@ -0,0 +1,261 @@
+#include "ringmap_window_view.hpp"
+#include "ringmap_data.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <numeric>
+#include <range/v3/algorithm/copy.hpp>
+
+RingmapWindowView::RingmapWindowView(const RingmapData& data, unsigned begin,
+                                     unsigned end) noexcept(false)
+    : data(&data), begin(begin), end(end),
+      modificationsFilter(data.modificationsFilter) {
+  assert(not data.basesFiltered);
+  assert(begin >= data.startIndex and end <= data.endIndex and begin < end);
+
+  auto const& matrix = data.m_data;
+  for (unsigned rowIndex = 0; rowIndex < matrix.rows_size(); ++rowIndex) {
+    auto const& row = matrix.getIndices(rowIndex);
+    if (row.begin_index <= begin and row.end_index >= end)
+      readsIndices.push_back(rowIndex);
+  }
+
+  for (auto rowIndex : readsIndices)
+    nTotalReads += matrix.getIndices(rowIndex).multiplicity;
+  nKeptReads = static_cast<unsigned>(readsIndices.size());
+}
+
+RingmapWindowView::RingmapWindowView(
+    const RingmapData& data, unsigned begin, unsigned end,
+    const RingmapMatrixIntervalIndex& readsIndex) noexcept(false)
+    : data(&data), begin(begin), end(end),
+      readsIndices(readsIndex.coveringRows(begin, end)),
+      modificationsFilter(data.modificationsFilter) {
+  assert(not data.basesFiltered);
+  assert(begin >= data.startIndex and end <= data.endIndex and begin < end);
+  assert(readsIndex.rows_size() == data.m_data.rows_size());
+
+  for (auto rowIndex : readsIndices)
+    nTotalReads += data.m_data.getIndices(rowIndex).multiplicity;
+  nKeptReads = static_cast<unsigned>(readsIndices.size());
+}
+
+unsigned
+RingmapWindowView::begin_index() const noexcept {
+  return begin;
+}
+
+unsigned
+RingmapWindowView::end_index() const noexcept {
+  return end;
+}
+
+unsigned
+RingmapWindowView::cols_size() const noexcept {
+  return end - begin;
+}
+
+unsigned
+RingmapWindowView::rows_size() const noexcept {
+  return static_cast<unsigned>(readsIndices.size());
+}
+
+std::size_t
+RingmapWindowView::totalReads() const noexcept {
+  return nTotalReads;
+}
+
+std::string_view
+RingmapWindowView::getSequence() const noexcept {
+  return std::string_view(data->sequence)
+      .substr(begin - data->startIndex, end - begin);
+}
+
+const std::vector<unsigned>&
+RingmapWindowView::getReadsIndices() const noexcept {
+  return readsIndices;
+}
+
+auto
+RingmapWindowView::readIndices(unsigned readPosition) const noexcept
+    -> indices_span {
+  auto const& row = data->m_data.getIndices(readsIndices[readPosition]);
+  auto const first = std::lower_bound(std::begin(row), std::end(row), begin);
+  auto const last = std::lower_bound(first, std::end(row), end);
+  return {row.data() + (first - std::begin(row)), last - first};
+}
+
+unsigned
+RingmapWindowView::readMultiplicity(unsigned readPosition) const noexcept {
+  return data->m_data.getIndices(readsIndices[readPosition]).multiplicity;
+}
+
+std::vector<unsigned>
+RingmapWindowView::getBaseCoverages() const {
+  // Every read covers the whole window
+  return std::vector<unsigned>(cols_size(),
+                               static_cast<unsigned>(nTotalReads));
+}
+
+std::vector<std::size_t>
+RingmapWindowView::filteredColumnSums() const {
+  std::vector<std::size_t> out(cols_size(), 0);
+  for (unsigned readPosition = 0; readPosition < rows_size(); ++readPosition) {
+    if (not isReadKept(readPosition))
+      continue;
+
+    auto const multiplicity = readMultiplicity(readPosition);
+    for (auto base : readIndices(readPosition))
+      out[base - begin] += multiplicity;
+  }
+  return out;
+}
+
+void
+RingmapWindowView::filterBases() noexcept(false) {
+  auto const columnSums = filteredColumnSums();
+  std::vector<unsigned> candidates;
+  if (basesFiltered)
+    candidates = filteredBases;
+  else {
+    candidates.resize(cols_size());
+    std::iota(std::begin(candidates), std::end(candidates), 0u);
+  }
+
+  auto const coverage = static_cast<double>(nTotalReads);
+  std::vector<unsigned> newFilteredBases;
+  newFilteredBases.reserve(candidates.size());
+  for (auto base : candidates) {
+    auto const modificationsOnCol = static_cast<double>(columnSums[base]);
+    if (basesFiltered) {
+      if (modificationsOnCol > data->minimumModificationsPerBase)
+        newFilteredBases.push_back(base);
+      continue;
+    }
+
+    char const baseChar = static_cast<char>(std::toupper(static_cast<int>(
+        data->sequence[begin - data->startIndex + base])));
+    if (not data->shape and baseChar != 'C' and baseChar != 'A')
+      continue;
+
+    if (nTotalReads >= data->minimumCoverage and
+        modificationsOnCol / coverage >
+            data->minimumModificationsPerBaseFraction and
+        modificationsOnCol > data->minimumModificationsPerBase)
+      newFilteredBases.push_back(base);
+  }
+
+  filteredBases = std::move(newFilteredBases);
+  basesFiltered = true;
+}
+
+void
+RingmapWindowView::filterReads() noexcept(false) {
+  if (modificationsFilter >= data->minimumModificationsPerRead)
+    return;
+
+  std::vector<std::uint8_t> usedBases(cols_size(), not basesFiltered);
+  for (auto base : filteredBases)
+    usedBases[base] = 1;
+
+  keptReads.assign(rows_size(), 0);
+  nKeptReads = 0;
+  for (unsigned readPosition = 0; readPosition < rows_size(); ++readPosition) {
+    auto const indices = readIndices(readPosition);
+    auto const modifications = std::count_if(
+        std::begin(indices), std::end(indices),
+        [&](index_type base) { return usedBases[base - begin] != 0; });
+    if (modifications >= data->minimumModificationsPerRead) {
+      keptReads[readPosition] = 1;
+      ++nKeptReads;
+    }
+  }
+
+  modificationsFilter = data->minimumModificationsPerRead;
+}
+
+bool
+RingmapWindowView::isReadKept(unsigned readPosition) const noexcept {
+  return keptReads.empty() or keptReads[readPosition] != 0;
+}
+
+unsigned
+RingmapWindowView::filteredRowsSize() const noexcept {
+  return nKeptReads;
+}
+
+const std::vector<unsigned>&
+RingmapWindowView::getFilteredBases() const noexcept {
+  assert(basesFiltered);
+  return filteredBases;
+}
+
+std::vector<double>
+RingmapWindowView::getBaseWeights() const {
+  assert(nKeptReads > 0);
+  /* Coverages are not affected by the read filtering, and every base of the
+   * window has the same one */
+  return std::vector<double>(filteredBases.size(), nTotalReads > 0 ? 1. : 0.);
+}
+
+arma::mat
+RingmapWindowView::covariance() const noexcept(false) {
+  assert(basesFiltered);
+  auto const nCols = static_cast<unsigned>(filteredBases.size());
+  std::vector<unsigned> filteredPositions(cols_size(), nCols);
+  for (unsigned position = 0; position < nCols; ++position)
+    filteredPositions[filteredBases[position]] = position;
+
+  arma::mat out(nCols, nCols, arma::fill::zeros);
+  std::vector<unsigned> readBases;
+  for (unsigned readPosition = 0; readPosition < rows_size(); ++readPosition) {
+    if (not isReadKept(readPosition))
+      continue;
+
+    readBases.clear();
+    for (auto base : readIndices(readPosition)) {
+      auto const position = filteredPositions[base - begin];
+      if (position != nCols)
+        readBases.push_back(position);
+    }
+
+    auto const multiplicity =
+        static_cast<double>(readMultiplicity(readPosition));
+    for (auto rowIter = std::begin(readBases); rowIter < std::end(readBases);
+         ++rowIter) {
+      for (auto colIter = rowIter; colIter < std::end(readBases); ++colIter)
+        out(*rowIter, *colIter) += multiplicity;
+    }
+  }
+
+  auto const baseWeights = getBaseWeights();
+  for (unsigned row = 0; row < nCols; ++row) {
+    for (unsigned col = row; col < nCols; ++col) {
+      double const weight = baseWeights[row] * baseWeights[col];
+      if (weight == 0)
+        out(row, col) = 0.;
+      else
+        out(row, col) /= std::sqrt(weight);
+    }
+  }
+
+  return arma::symmatu(out);
+}
+
+WeightedClusters
+RingmapWindowView::getUnfilteredWeights(const WeightedClusters& weights) const {
+  if (not basesFiltered)
+    return weights;
+
+  assert(weights.getElementsSize() == filteredBases.size());
+  WeightedClusters allWeights(cols_size(), weights.getClustersSize(), false);
+  for (std::size_t position = 0; position < filteredBases.size(); ++position) {
+    auto&& baseWeights = weights[position];
+    auto&& newBaseWeights = allWeights[filteredBases[position]];
+    ranges::copy(baseWeights, ranges::begin(newBaseWeights));
+  }
+
+  return allWeights;
+}
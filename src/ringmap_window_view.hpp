@@ -0,0 +1,79 @@
+#pragma once
+
+#include "ringmap_matrix_interval_index.hpp"
+#include "ringmap_matrix_traits.hpp"
+#include "weighted_clusters.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <range/v3/view/span.hpp>
+#include <string_view>
+#include <vector>
+
+#include <armadillo>
+
+class RingmapData;
+
+/* A window over the reads of a RingmapData, without copying them.
+ *
+ * The view only stores the indices of the reads fully covering
+ * [begin, end), as RingmapData::get_new_range selects them, and the masks
+ * produced by filterBases() and filterReads(), which follow the same rules as
+ * their RingmapData counterparts on the extracted window. The parent data must
+ * outlive the view and must not change in the meantime. */
+class RingmapWindowView {
+public:
+  using index_type = ringmap_matrix::base_index_type;
+  using indices_span = ranges::span<const index_type>;
+
+  RingmapWindowView(const RingmapData& data, unsigned begin,
+                    unsigned end) noexcept(false);
+  RingmapWindowView(const RingmapData& data, unsigned begin, unsigned end,
+                    const RingmapMatrixIntervalIndex& readsIndex) noexcept(false);
+
+  unsigned begin_index() const noexcept;
+  unsigned end_index() const noexcept;
+  unsigned cols_size() const noexcept;
+  unsigned rows_size() const noexcept;
+  std::size_t totalReads() const noexcept;
+  /* Bases of the window, from the sequence of the parent data */
+  std::string_view getSequence() const noexcept;
+
+  /* Indices of the covering reads in the parent data, in increasing order */
+  const std::vector<unsigned>& getReadsIndices() const noexcept;
+  /* Modified bases of the read at the given position, in the coordinates of
+   * the parent data */
+  indices_span readIndices(unsigned readPosition) const noexcept;
+  unsigned readMultiplicity(unsigned readPosition) const noexcept;
+  std::vector<unsigned> getBaseCoverages() const;
+
+  void filterBases() noexcept(false);
+  void filterReads() noexcept(false);
+  bool isReadKept(unsigned readPosition) const noexcept;
+  unsigned filteredRowsSize() const noexcept;
+  /* Window bases left by the filters, in increasing order */
+  const std::vector<unsigned>& getFilteredBases() const noexcept;
+  std::vector<double> getBaseWeights() const;
+
+  /* Same as the covariance of the filtered window RingmapData, accumulated
+   * directly from the reads */
+  arma::mat covariance() const noexcept(false);
+  WeightedClusters getUnfilteredWeights(const WeightedClusters& weights) const;
+
+private:
+  friend class RingmapColumnPermutations;
+
+  std::vector<std::size_t> filteredColumnSums() const;
+
+  const RingmapData* data;
+  unsigned begin;
+  unsigned end;
+  std::vector<unsigned> readsIndices;
+  std::size_t nTotalReads = 0;
+  // Empty until the reads are filtered
+  std::vector<std::uint8_t> keptReads;
+  unsigned nKeptReads = 0;
+  std::vector<unsigned> filteredBases;
+  bool basesFiltered = false;
+  unsigned modificationsFilter = 0;
+};
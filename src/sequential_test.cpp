@@ -0,0 +1,23 @@
+#include "sequential_test.hpp"
+
+#include <algorithm>
+
+namespace sequential_test {
+
+std::size_t
+extremes(PerturbedEigengap const& nullModel, double eigengap,
+         bool lowerTail) noexcept {
+  return static_cast<std::size_t>(std::count_if(
+      std::begin(nullModel), std::end(nullModel), [&](double value) {
+        return lowerTail ? value <= eigengap : value >= eigengap;
+      }));
+}
+
+bool
+settledNonSignificant(std::size_t extremes, unsigned maxPermutations,
+                      double level) noexcept {
+  return static_cast<double>(extremes) + 1. >=
+         level * (static_cast<double>(maxPermutations) + 1.);
+}
+
+} // namespace sequential_test
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "ptba_types.hpp"
+
+#include <cstddef>
+
+/* Besag-Clifford sequential Monte Carlo test of the eigengaps.
+ *
+ * Once enough permutations are at least as extreme as the data, the Monte
+ * Carlo p-value after maxPermutations, (extremes + 1) / (maxPermutations + 1),
+ * cannot go below the level, whatever the remaining permutations are.
+ *
+ * The PTBA decides the eigengaps on the tail of a Weibull fit of the
+ * permutations rather than on the Monte Carlo p-value, so the rule is an
+ * approximation there: it is only applied to eigengaps that the fitted tail
+ * already finds non-significant, or whose permutations do not follow a
+ * Weibull, and it assumes that the fit of the remaining permutations would
+ * not move the p-value below the level. */
+namespace sequential_test {
+
+/* Permutations at least as extreme as the data, on the given tail */
+std::size_t extremes(PerturbedEigengap const& nullModel, double eigengap,
+                     bool lowerTail) noexcept;
+
+bool settledNonSignificant(std::size_t extremes, unsigned maxPermutations,
+                           double level) noexcept;
+
+} // namespace sequential_test
@@ -1,4 +1,5 @@
 #include "spectral_partitioner.hpp"
+#include "eigen_solver.hpp"
 
 #include <cassert>
 #include <cmath>
@@ -40,13 +41,28 @@ SpectralPartitioner::getDecomposition(const arma::mat& normalizedLaplacian) {
   return eigenDecomposition;
 }
 
+std::pair<arma::mat, arma::vec>
+SpectralPartitioner::getDecomposition(const arma::mat& normalizedLaplacian,
+                                      unsigned nEigen,
+                                      const arma::mat& initialSubspace) {
+  auto decomposition =
+      eigen_solver::smallest(normalizedLaplacian, nEigen, initialSubspace);
+  // We accept very small negative values
+  if (arma::any(decomposition.eigenValues < -0.0001))
+    throw std::logic_error("at least one eigenvalue is negative, the input "
+                           "matrix is not a valid adjacency matrix");
+  return {std::move(decomposition.eigenVecs),
+          std::move(decomposition.eigenValues)};
+}
+
 std::array<std::vector<std::size_t>, 2>
 SpectralPartitioner::bipartite(const arma::mat& adjacency) {
   constexpr unsigned maxIterations = 1000;
 
   arma::vec secondEigenVec;
   {
-    auto eigenvecs = getDecomposition(getNormalizedLaplacian(adjacency)).first;
+    auto eigenvecs =
+        getDecomposition(getNormalizedLaplacian(adjacency), 2).first;
     assert(eigenvecs.n_cols >= 2);
     secondEigenVec = eigenvecs.col(1);
   }
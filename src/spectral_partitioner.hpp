@@ -12,4 +12,9 @@ struct SpectralPartitioner {
 
   static std::pair<arma::mat, arma::vec>
   getDecomposition(const arma::mat& normalizedLaplacian);
+  /* Only the nEigen smallest eigenpairs, starting from the eigenvectors of a
+   * similar matrix when available */
+  static std::pair<arma::mat, arma::vec>
+  getDecomposition(const arma::mat& normalizedLaplacian, unsigned nEigen,
+                   const arma::mat& initialSubspace = {});
 };
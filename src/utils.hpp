@@ -5,6 +5,7 @@
 
 #include <array>
 #include <functional>
+#include <iterator>
 #include <range/v3/algorithm.hpp>
 #include <range/v3/core.hpp>
 #include <type_traits>
@@ -117,6 +118,35 @@ count_intersections(InputIt1 first1, InputIt1 last1, InputIt2 first2,
   return count;
 }
 
+/* Like count_intersections, but each common element contributes with its
+ * weight instead of one */
+template <typename InputIt1, typename InputIt2, typename Weight>
+std::size_t
+sum_intersections_weights(InputIt1 first1, InputIt1 last1, InputIt2 first2,
+                          InputIt2 last2, Weight&& weight) {
+  if (first1 == last1 or first2 == last2)
+    return 0;
+
+  std::size_t sum = 0;
+  for (;;) {
+    first1 = ranges::lower_bound(first1, last1, *first2);
+    if (first1 == last1)
+      break;
+
+    first2 = ranges::lower_bound(first2, last2, *first1);
+    if (first2 == last2)
+      break;
+
+    if (*first1 == *first2) {
+      sum += weight(*first1);
+      if (++first1 == last1 or ++first2 == last2)
+        break;
+    }
+  }
+
+  return sum;
+}
+
 namespace arma {
 
 template <typename T>
@@ -163,7 +193,8 @@ count_intersections(InputIt1 first1, InputIt1 last1, InputIt2 first2,
                     InputIt2 last2) {
   return count_intersections(std::move(first1), std::move(last1),
                              std::move(first2), std::move(last2),
-                             std::less<typename InputIt1::value_type>());
+                             std::less<typename std::iterator_traits<
+                                 InputIt1>::value_type>());
 }
 
 /*
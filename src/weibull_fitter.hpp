@@ -2,15 +2,22 @@
 
 #include "ptba_types.hpp"
 
+#include <cstddef>
 #include <functional>
-
-#include <dlib/matrix.h>
+#include <utility>
+#include <vector>
 
 struct WeibullParams {
   double shape;
   double scale;
 };
 
+/* Weibull CDF of a contiguous array of values, written to out. The values
+ * must not be negative. It is computed on SIMD vectors, without the argument
+ * checks of boost::math::cdf, with an absolute error below 1e-14. */
+void weibull_cdf(WeibullParams const& params, double const* values,
+                 double* out, std::size_t size) noexcept;
+
 namespace test {
 struct WeibullFitter;
 } // namespace test
@@ -18,21 +25,25 @@ struct WeibullFitter;
 struct WeibullFitter {
   friend struct test::WeibullFitter;
 
-  using params_type = dlib::matrix<double, 0, 1>;
+  using params_type = WeibullParams;
   using data_iterator = PerturbedEigengap::const_iterator;
 
   WeibullFitter(PerturbedEigengap const& perturbed_eigengap) noexcept;
+  /* Maximum likelihood estimate, with a shape not smaller than min_shape. The
+   * shape solves the profile likelihood equation with a safeguarded Newton
+   * method, starting from the previous fit, and the scale follows in closed
+   * form. */
   WeibullParams fit() noexcept(false);
 
-  static constexpr std::size_t search_points = 30;
-  static constexpr double delta_stop = 1e-7;
-  inline static const params_type min_params{1., 1e-4};
-  inline static const params_type max_params{3., 2.};
+  static constexpr double min_shape = 1.;
+  static constexpr unsigned max_iterations = 100;
+  static constexpr double shape_tolerance = 1e-9;
 
 private:
   struct KExpr {
     double x_k;
     double x_k_log_x;
+    double x_k_log2_x;
   };
 
   double pdf_log_likelihood_slow(params_type const& params) noexcept;
@@ -42,6 +53,10 @@ private:
   void update_k_expressions(std::size_t start_index,
                             KExpr initial_data) noexcept;
   void update_params(double k, double l) noexcept;
+  void update_shape(double k) noexcept;
+  /* Derivative of the profile log-likelihood with respect to the shape,
+   * divided by the number of samples, and its own derivative */
+  std::pair<double, double> profile_log_likelihood_deriv() const noexcept;
 
   std::reference_wrapper<const PerturbedEigengap> perturbed_eigengap;
   std::size_t last_size = 0;
@@ -54,6 +69,7 @@ private:
   double cum_log_x = 0.;
   double cum_x_k = 0.;
   double cum_x_k_log_x = 0.;
+  double cum_x_k_log2_x = 0.;
 };
 
 #include "weibull_fitter_impl.hpp"
@@ -2,10 +2,156 @@
 
 #include "weibull_fitter.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
 #include <numeric>
 
-#include <dlib/optimization.h>
+namespace detail {
+
+/* Explicit SIMD for weibull_cdf, with the vector extensions of GCC and Clang
+ * (lowered to the widest available instructions). The compilers do not
+ * vectorize the libm calls without -ffast-math, so exp and log are computed
+ * here, without branches: the reductions and the polynomials are the fdlibm
+ * ones, with an error below 1 ulp on the ranges used here. */
+
+/* As wide as the vector registers, the functions taking vectors are only
+ * used inline */
+#if defined(__AVX512F__)
+constexpr std::size_t weibull_lanes = 8;
+#elif defined(__AVX__)
+constexpr std::size_t weibull_lanes = 4;
+#else
+constexpr std::size_t weibull_lanes = 2;
+#endif
+using weibull_doubles =
+    double __attribute__((vector_size(weibull_lanes * sizeof(double))));
+using weibull_bits =
+    std::uint64_t __attribute__((vector_size(weibull_lanes * sizeof(double))));
+
+constexpr double weibull_ln2_hi = 6.93147180369123816490e-01;
+constexpr double weibull_ln2_lo = 1.90821492927058770002e-10;
+/* Adding it rounds to an integer, stored in the low bits of the mantissa */
+constexpr double weibull_round_shifter = 0x1.8p52;
+constexpr std::uint64_t weibull_round_shifter_bits = 0x4338000000000000ull;
+
+inline weibull_doubles
+weibull_select(weibull_bits mask, weibull_doubles if_true,
+               weibull_doubles if_false) noexcept {
+  return reinterpret_cast<weibull_doubles>(
+      (mask & reinterpret_cast<weibull_bits>(if_true)) |
+      (~mask & reinterpret_cast<weibull_bits>(if_false)));
+}
+
+inline weibull_doubles
+weibull_clamp(weibull_doubles value, double low, double high) noexcept {
+  weibull_doubles const lows = value - value + low;
+  weibull_doubles const highs = value - value + high;
+  value = weibull_select(reinterpret_cast<weibull_bits>(value < highs), value,
+                         highs);
+  return weibull_select(reinterpret_cast<weibull_bits>(value > lows), value,
+                        lows);
+}
+
+/* Only for values in [-708, 708] */
+inline weibull_doubles
+weibull_exp(weibull_doubles value) noexcept {
+  weibull_doubles const shifted =
+      value * 1.44269504088896338700e+00 + weibull_round_shifter;
+  weibull_doubles const exponent = shifted - weibull_round_shifter;
+  weibull_doubles const reduced =
+      (value - exponent * weibull_ln2_hi) - exponent * weibull_ln2_lo;
+
+  // Taylor expansion, |reduced| <= ln(2) / 2
+  weibull_doubles poly = reduced * (1. / 6227020800.) + 1. / 479001600.;
+  poly = poly * reduced + 1. / 39916800.;
+  poly = poly * reduced + 1. / 3628800.;
+  poly = poly * reduced + 1. / 362880.;
+  poly = poly * reduced + 1. / 40320.;
+  poly = poly * reduced + 1. / 5040.;
+  poly = poly * reduced + 1. / 720.;
+  poly = poly * reduced + 1. / 120.;
+  poly = poly * reduced + 1. / 24.;
+  poly = poly * reduced + 1. / 6.;
+  poly = poly * reduced + 0.5;
+  poly = poly * reduced + 1.;
+  poly = poly * reduced + 1.;
+
+  weibull_bits const scale = (reinterpret_cast<weibull_bits>(shifted) -
+                              weibull_round_shifter_bits + 1023u)
+                             << 52;
+  return poly * reinterpret_cast<weibull_doubles>(scale);
+}
+
+/* For non-negative values: 0 and the subnormal ones give about
+ * log(DBL_MIN) */
+inline weibull_doubles
+weibull_log(weibull_doubles value) noexcept {
+  // value = 2^exponent * mantissa, with mantissa in [sqrt(2) / 2, sqrt(2))
+  auto const bits = reinterpret_cast<weibull_bits>(value);
+  weibull_bits const biased =
+      bits - 0x3fe6a09e667f3bcdull + 0x4000000000000000ull;
+  auto const mantissa = reinterpret_cast<weibull_doubles>(
+      bits - (biased & 0xfff0000000000000ull) + 0x4000000000000000ull);
+  weibull_doubles const exponent = reinterpret_cast<weibull_doubles>(
+                                      0x4330000000000000ull | (biased >> 52)) -
+                                  (0x1p52 + 1024.);
+
+  weibull_doubles const f = mantissa - 1.;
+  weibull_doubles const s = f / (2. + f);
+  weibull_doubles const z = s * s;
+  weibull_doubles const w = z * z;
+  weibull_doubles const t1 =
+      w * (3.999999999940941908e-01 +
+           w * (2.222219843214978396e-01 + w * 1.531383769920937332e-01));
+  weibull_doubles const t2 =
+      z * (6.666666666666735130e-01 +
+           w * (2.857142874366239149e-01 +
+                w * (1.818357216161805012e-01 + w * 1.479819860511658591e-01)));
+  weibull_doubles const hfsq = 0.5 * f * f;
+  return exponent * weibull_ln2_hi -
+         ((hfsq - (s * (hfsq + t1 + t2) + exponent * weibull_ln2_lo)) - f);
+}
+
+inline weibull_doubles
+weibull_cdf(weibull_doubles scaled, double shape) noexcept {
+  auto const exponent =
+      weibull_clamp(shape * weibull_log(scaled), -708., 708.);
+  auto const power = weibull_clamp(weibull_exp(exponent), 0., 708.);
+  // Exactly 0 for a value of 0, through the clamps
+  return 1. - weibull_exp(-power);
+}
+
+} // namespace detail
+
+inline void
+weibull_cdf(WeibullParams const& params, double const* values, double* out,
+            std::size_t size) noexcept {
+  assert(params.shape > 0.);
+  assert(params.scale > 0.);
+
+  using detail::weibull_lanes;
+  double const inv_scale = 1. / params.scale;
+  std::size_t index = 0;
+  for (; index + weibull_lanes <= size; index += weibull_lanes) {
+    detail::weibull_doubles scaled;
+    std::memcpy(&scaled, values + index, sizeof(scaled));
+    auto const cdf = detail::weibull_cdf(scaled * inv_scale, params.shape);
+    std::memcpy(out + index, &cdf, sizeof(cdf));
+  }
+
+  if (index < size) {
+    auto const tail = size - index;
+    detail::weibull_doubles scaled{};
+    std::memcpy(&scaled, values + index, tail * sizeof(double));
+    auto const cdf = detail::weibull_cdf(scaled * inv_scale, params.shape);
+    std::memcpy(out + index, &cdf, tail * sizeof(double));
+  }
+}
 
 inline WeibullFitter::WeibullFitter(
     PerturbedEigengap const& perturbed_eigengap) noexcept
@@ -13,37 +159,16 @@ inline WeibullFitter::WeibullFitter(
 
 inline WeibullParams
 WeibullFitter::fit() noexcept(false) {
-  WeibullParams fit_params;
   auto const& perturbed_eigengap = this->perturbed_eigengap.get();
 
   auto const size = perturbed_eigengap.size();
-  if (size == 0) {
-    fit_params.shape = 0.;
-    fit_params.scale = 0.;
-    return fit_params;
-  }
+  if (size == 0)
+    return {0., 0.};
 
-  bool updated_params = false;
-  {
-    if (last_k == 0.) {
-      last_k = 1.2;
-      log_k = 0.;
-      updated_params = true;
-    }
-
-    if (last_l == 0.) {
-      auto data = perturbed_eigengap;
-      auto const data_begin = std::begin(data);
-      auto median_iter =
-          std::next(data_begin, static_cast<std::ptrdiff_t>(size / 2));
-      std::nth_element(data_begin, median_iter, std::end(data));
-      last_l = *median_iter / std::log(2.);
-      log_l = std::log(last_l);
-      updated_params = true;
-    }
-
-    if (updated_params)
-      l_k_inv = 1. / std::pow(last_l, last_k);
+  bool const first_fit = last_k == 0.;
+  if (first_fit) {
+    last_k = 1.2;
+    log_k = std::log(last_k);
   }
 
   if (size < last_size) {
@@ -52,6 +177,7 @@ WeibullFitter::fit() noexcept(false) {
     cum_log_x = 0.;
     cum_x_k = 0.;
     cum_x_k_log_x = 0.;
+    cum_x_k_log2_x = 0.;
   }
 
   if (last_size != size) {
@@ -72,61 +198,55 @@ WeibullFitter::fit() noexcept(false) {
       cum_log_x += log_x;
       cum_x_k += x_k;
       cum_x_k_log_x += x_k * log_x;
+      cum_x_k_log2_x += x_k * log_x * log_x;
     }
-  }
-
-  if (not updated_params and size == last_size and last_size != 0) {
-    fit_params.shape = last_k;
-    fit_params.scale = last_l;
-    return fit_params;
-  }
+  } else if (not first_fit)
+    return {last_k, last_l};
 
   last_size = size;
-  params_type params{last_k, last_l};
-  auto current_min_params = min_params;
-  auto current_max_params = max_params;
-  for (;;) {
-    try {
-      dlib::find_max_box_constrained(
-          dlib::lbfgs_search_strategy(search_points),
-          dlib::objective_delta_stop_strategy(delta_stop),
-          [this](auto&& params) { return pdf_log_likelihood(params); },
-          [this](auto&& params) { return pdf_log_likelihood_deriv(params); },
-          params, current_min_params, current_max_params);
-    } catch (std::exception const&) {
-      break;
+  if (last_k < min_shape)
+    update_shape(min_shape);
+
+  /* The derivative of the profile log-likelihood is decreasing in the shape,
+   * so the root is kept in a bracket. Newton steps falling outside of it are
+   * replaced by a bisection, or by an expansion while there is no upper
+   * bound. Below min_shape the constrained maximum is min_shape itself. */
+  double lower_k = min_shape;
+  double upper_k = std::numeric_limits<double>::infinity();
+  bool lower_k_evaluated = false;
+  for (unsigned iteration = 0; iteration < max_iterations; ++iteration) {
+    double const k = last_k;
+    auto const [deriv, second_deriv] = profile_log_likelihood_deriv();
+    if (deriv > 0.) {
+      lower_k = k;
+      lower_k_evaluated = true;
+    } else {
+      upper_k = k;
+      if (k <= min_shape)
+        break;
     }
 
-    bool updated_limits = false;
-    for (unsigned param_index = 0; param_index < 2; ++param_index) {
-      double const param = params(param_index);
-      auto&& current_max_param = current_max_params(param_index);
-      auto&& current_min_param = current_min_params(param_index);
-
-      if (std::abs(param - current_max_param) <=
-          current_max_params(param_index) * 0.05) {
-        current_max_param = param * 2.;
-        updated_limits = true;
-      }
-
-      if (std::abs(param - current_min_param) <=
-              current_min_params(param_index) * 0.05 and
-          current_min_params(param_index) > 1.) {
-        current_min_param = param / 2.;
-        updated_limits = true;
-      }
+    double next_k = k - deriv / second_deriv;
+    if (not(next_k > lower_k and next_k < upper_k)) {
+      if (std::isinf(upper_k))
+        next_k = k * 2.;
+      else if (not lower_k_evaluated)
+        next_k = min_shape;
+      else
+        next_k = (lower_k + upper_k) / 2.;
     }
 
-    if (not updated_limits)
+    if (std::abs(next_k - k) <= shape_tolerance * k)
       break;
-
-    current_min_params(0) = std::max(current_min_params(0), 1.);
-    current_max_params(0) = std::max(current_max_params(0), 1.);
+    update_shape(next_k);
   }
 
-  fit_params.shape = params(0);
-  fit_params.scale = params(1);
-  return fit_params;
+  auto const n = static_cast<double>(last_size);
+  last_l = std::pow(cum_x_k / n, 1. / last_k);
+  log_l = std::log(last_l);
+  l_k_inv = n / cum_x_k;
+
+  return {last_k, last_l};
 }
 
 inline void
@@ -141,21 +261,35 @@ WeibullFitter::update_k_expressions(std::size_t start_index,
 
   for (; data_iter < data_end; ++data_iter, ++log_iter) {
     double const x_k = std::pow(*data_iter, last_k);
+    double const log_x = *log_iter;
 
     initial_data.x_k += x_k;
-    initial_data.x_k_log_x += x_k * *log_iter;
+    initial_data.x_k_log_x += x_k * log_x;
+    initial_data.x_k_log2_x += x_k * log_x * log_x;
   }
 
   cum_x_k = initial_data.x_k;
   cum_x_k_log_x = initial_data.x_k_log_x;
+  cum_x_k_log2_x = initial_data.x_k_log2_x;
+}
+
+inline std::pair<double, double>
+WeibullFitter::profile_log_likelihood_deriv() const noexcept {
+  auto const n = static_cast<double>(last_size);
+  double const mean_log_x_k = cum_x_k_log_x / cum_x_k;
+  double const deriv = 1. / last_k + cum_log_x / n - mean_log_x_k;
+  double const second_deriv =
+      -1. / (last_k * last_k) -
+      (cum_x_k_log2_x / cum_x_k - mean_log_x_k * mean_log_x_k);
+  return {deriv, second_deriv};
 }
 
 inline double
 WeibullFitter::pdf_log_likelihood_slow(params_type const& params) noexcept {
   assert(this->perturbed_eigengap.get().size() == last_size);
 
-  double const k = params(0);
-  double const l = params(1);
+  double const k = params.shape;
+  double const l = params.scale;
 
   assert(k > 0.);
   assert(l > 0.);
@@ -186,8 +320,8 @@ inline double
 WeibullFitter::pdf_log_likelihood(params_type const& params) noexcept {
   assert(this->perturbed_eigengap.get().size() == last_size);
 
-  double const k = params(0);
-  double const l = params(1);
+  double const k = params.shape;
+  double const l = params.scale;
   auto const n = static_cast<double>(last_size);
 
   update_params(k, l);
@@ -204,8 +338,8 @@ WeibullFitter::pdf_log_likelihood_deriv(params_type const& params) noexcept
     -> params_type {
   assert(this->perturbed_eigengap.get().size() == last_size);
 
-  double const k = params(0);
-  double const l = params(1);
+  double const k = params.shape;
+  double const l = params.scale;
   auto const n = static_cast<double>(last_size);
 
   update_params(k, l);
@@ -223,10 +357,7 @@ WeibullFitter::update_params(double k, double l) noexcept {
   bool changed_params = false;
 
   if (k != last_k) {
-    assert(k > 0.);
-    last_k = k;
-    log_k = std::log(k);
-    update_k_expressions(0, KExpr{0., 0.});
+    update_shape(k);
     changed_params = true;
   }
 
@@ -245,3 +376,11 @@ WeibullFitter::update_params(double k, double l) noexcept {
       l_k_inv = 1. / l_k;
   }
 }
+
+inline void
+WeibullFitter::update_shape(double k) noexcept {
+  assert(k > 0.);
+  last_k = k;
+  log_k = std::log(k);
+  update_k_expressions(0, KExpr{0., 0., 0.});
+}
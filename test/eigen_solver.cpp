@@ -0,0 +1,143 @@
+#include "eigen_solver.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <random>
+
+#include <armadillo>
+
+/* Normalized Laplacian of a random graph with four denser blocks, so that the
+ * smallest eigenvalues are well separated from the others */
+static arma::mat
+make_laplacian(arma::uword size, std::mt19937& random_gen) {
+  std::uniform_real_distribution<double> dist(0., 1.);
+  arma::mat adjacency(size, size, arma::fill::zeros);
+  for (arma::uword row = 0; row < size; ++row) {
+    for (arma::uword col = row + 1; col < size; ++col) {
+      double const scale = (row * 4 / size == col * 4 / size) ? 3. : 0.3;
+      adjacency(row, col) = adjacency(col, row) =
+          dist(random_gen) * dist(random_gen) * scale;
+    }
+  }
+
+  arma::mat laplacian(size, size);
+  for (arma::uword row = 0; row < size; ++row) {
+    double row_degree = 0.;
+    for (arma::uword col = 0; col < size; ++col)
+      row_degree += adjacency(row, col);
+    for (arma::uword col = 0; col < size; ++col) {
+      double col_degree = 0.;
+      for (arma::uword other = 0; other < size; ++other)
+        col_degree += adjacency(other, col);
+      laplacian(row, col) = (row == col ? 1. : 0.) -
+                            adjacency(row, col) /
+                                std::sqrt(row_degree * col_degree);
+    }
+  }
+
+  return laplacian;
+}
+
+static void
+check_eigenvalues(const eigen_solver::Decomposition& decomposition,
+                  const arma::mat& matrix, unsigned n_eigen) {
+  arma::vec expected;
+  arma::eig_sym(expected, matrix);
+
+  assert(decomposition.eigenValues.n_elem == n_eigen);
+  for (arma::uword index = 0; index < n_eigen; ++index)
+    assert(std::abs(decomposition.eigenValues(index) - expected(index)) < 1e-9);
+}
+
+static void
+test_lobpcg() {
+  std::mt19937 random_gen(42);
+  auto const laplacian = make_laplacian(120, random_gen);
+
+  auto const cold = eigen_solver::smallest(laplacian, 6);
+  assert(not cold.dense);
+  assert(cold.eigenVecs.n_cols == 6);
+  check_eigenvalues(cold, laplacian, 6);
+  for (arma::uword index = 0; index < 6; ++index) {
+    arma::vec const residual =
+        laplacian * cold.eigenVecs.col(index) -
+        cold.eigenValues(index) * cold.eigenVecs.col(index);
+    assert(arma::norm(residual) < 1e-6);
+  }
+
+  // A slightly different matrix converges faster from the previous subspace
+  arma::mat perturbed = laplacian;
+  std::uniform_real_distribution<double> noise(-5e-4, 5e-4);
+  for (arma::uword row = 0; row < perturbed.n_rows; ++row) {
+    for (arma::uword col = row + 1; col < perturbed.n_cols; ++col)
+      perturbed(row, col) = perturbed(col, row) =
+          perturbed(row, col) + noise(random_gen);
+  }
+
+  auto const warm = eigen_solver::smallest(perturbed, 6, cold.subspace);
+  auto const perturbed_cold = eigen_solver::smallest(perturbed, 6);
+  assert(not warm.dense);
+  assert(warm.iterations > 0);
+  assert(warm.iterations < perturbed_cold.iterations);
+  check_eigenvalues(warm, perturbed, 6);
+}
+
+static void
+test_dense() {
+  std::mt19937 random_gen(42);
+  auto const laplacian = make_laplacian(40, random_gen);
+
+  // The block is too large for the matrix
+  auto const values = eigen_solver::smallest(laplacian, 20, {}, false);
+  assert(values.dense);
+  assert(values.eigenVecs.empty());
+  check_eigenvalues(values, laplacian, 20);
+
+  auto const vectors = eigen_solver::smallest(laplacian, 20);
+  assert(vectors.eigenVecs.n_cols == 20);
+
+  // Not enough iterations to converge
+  auto const stalled =
+      eigen_solver::smallest(make_laplacian(120, random_gen), 2, {}, true, 1);
+  assert(stalled.dense);
+  assert(stalled.eigenVecs.n_cols == 2);
+}
+
+static void
+test_uses_lobpcg() {
+  assert(eigen_solver::usesLobpcg(120, 6));
+  assert(not eigen_solver::usesLobpcg(40, 20));
+  assert(not eigen_solver::usesLobpcg(120, 0));
+
+  // Testing all the eigengaps of a window always takes the dense solver
+  for (arma::uword bases = 2; bases <= 1000; ++bases)
+    assert(not eigen_solver::usesLobpcg(
+        bases, static_cast<unsigned>(bases / 2 + 1)));
+
+  // A few clusters at most on a wide window use LOBPCG
+  assert(eigen_solver::usesLobpcg(120, 5 + 1));
+}
+
+static void
+test_subspace() {
+  eigen_solver::EigenSubspace subspace;
+  subspace.vectors = arma::randu<arma::mat>(5, 2);
+  subspace.bases = {10, 12, 14, 16, 18};
+
+  auto const moved = subspace.on({9, 10, 11, 14, 18, 20});
+  assert(moved.n_rows == 6 and moved.n_cols == 2);
+  for (arma::uword col = 0; col < 2; ++col) {
+    assert(moved(0, col) == 0. and moved(2, col) == 0. and moved(5, col) == 0.);
+    assert(moved(1, col) == subspace.vectors(0, col));
+    assert(moved(3, col) == subspace.vectors(2, col));
+    assert(moved(4, col) == subspace.vectors(4, col));
+  }
+}
+
+int
+main() {
+  test_lobpcg();
+  test_dense();
+  test_uses_lobpcg();
+  test_subspace();
+}
@@ -0,0 +1,58 @@
+#include "parallel/memory_budget.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+static constexpr std::size_t maxBytes = 1000;
+static constexpr std::size_t nLoops = 10'000;
+static constexpr std::size_t nThreads = 8;
+
+int
+main() {
+  parallel::memory_budget budget(maxBytes);
+
+  // A request larger than the budget is granted when nothing is in use
+  budget.acquire(maxBytes * 2);
+  assert(budget.in_use() == maxBytes * 2);
+  budget.release(maxBytes * 2);
+  assert(budget.in_use() == 0);
+
+  // The guard releases its bytes even when leaving through an exception
+  try {
+    parallel::memory_budget_guard guard(budget, maxBytes / 2);
+    assert(budget.in_use() == maxBytes / 2);
+    throw std::runtime_error("analysis failed");
+  } catch (const std::runtime_error&) {
+  }
+  assert(budget.in_use() == 0);
+
+  std::atomic<std::size_t> inFlight = 0;
+  std::atomic_bool exceeded = false;
+  std::vector<std::thread> threads;
+  threads.reserve(nThreads);
+  for (std::size_t threadIndex = 0; threadIndex < nThreads; ++threadIndex) {
+    threads.emplace_back([&] {
+      std::mt19937 randomGen(std::random_device{}());
+      std::uniform_int_distribution<std::size_t> randomBytes(1, maxBytes / 2);
+
+      for (std::size_t loop = 0; loop < nLoops; ++loop) {
+        auto const bytes = randomBytes(randomGen);
+        budget.acquire(bytes);
+        if (inFlight.fetch_add(bytes) + bytes > maxBytes)
+          exceeded = true;
+        inFlight.fetch_sub(bytes);
+        budget.release(bytes);
+      }
+    });
+  }
+
+  for (auto& thread : threads)
+    thread.join();
+
+  assert(not exceeded);
+  assert(budget.in_use() == 0);
+}
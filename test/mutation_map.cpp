@@ -0,0 +1,490 @@
+#include <binary_stream.hpp>
+#include <mutation_map.hpp>
+#include <mutation_map_codec.hpp>
+#include <mutation_map_index.hpp>
+#include <mutation_map_writer.hpp>
+
+#include <array>
+#include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <range/v3/algorithm.hpp>
+
+#if __has_include(<filesystem>)
+#include <filesystem>
+namespace fs = std::filesystem;
+#elif __has_include(<experimental/filesystem>)
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#else
+#error "Missing filesystem header"
+#endif
+
+static void
+checkIndex(const std::string& filename) {
+  const std::string indexFilename = filename + "i.draco";
+  assert(fs::exists(indexFilename));
+
+  MutationMapIndex index(indexFilename);
+  assert(index.extended);
+  assert(index.mutationMapSize == fs::file_size(filename));
+
+  MutationMap mutationMap(filename);
+  assert(mutationMap.isIndexed());
+  auto&& entries = mutationMap.getIndexEntries();
+  assert(entries.size() == index.entries.size());
+  for (std::size_t entryIndex = 0; entryIndex < entries.size(); ++entryIndex)
+    assert(entries[entryIndex].chunkOffsets ==
+           index.entries[entryIndex].chunkOffsets);
+
+  std::uint64_t totalSize = 0;
+  auto entryIter = ranges::begin(entries);
+  for (auto&& transcript : mutationMap) {
+    assert(entryIter != ranges::end(entries));
+    assert(entryIter->transcriptId == transcript.getId());
+    assert(entryIter->reads == transcript.getReadsSize());
+    assert(entryIter->sequenceLength == transcript.getSequence().size());
+
+    {
+      std::string upperId = transcript.getId();
+      ranges::transform(upperId, ranges::begin(upperId), [](char c) {
+        return static_cast<char>(std::toupper(c));
+      });
+      auto const foundEntries = mutationMap.findIndexEntries(upperId);
+      assert(ranges::any_of(foundEntries, [&](auto&& foundEntry) {
+        return foundEntry->offset == entryIter->offset;
+      }));
+    }
+
+    transcript.skip();
+    assert(static_cast<std::streamoff>(entryIter->offset) +
+               static_cast<std::streamoff>(entryIter->size) ==
+           static_cast<std::streamoff>(transcript.getEndOffset()));
+    totalSize += entryIter->size;
+    ++entryIter;
+  }
+  assert(entryIter == ranges::end(entries));
+  assert(mutationMap.findIndexEntries("__missing_transcript__").empty());
+  assert(static_cast<std::uint64_t>(static_cast<std::streamoff>(
+             mutationMap.getDataBeginOffset())) +
+             totalSize +
+             MutationMap::eofMarker.size() ==
+         fs::file_size(filename));
+}
+
+static void
+checkCodec() {
+  for (std::int64_t value :
+       std::vector<std::int64_t>{0, 1, -1, 63, -64, 1000000, -1000000}) {
+    assert(mutation_map_codec::zigzagDecode(
+               mutation_map_codec::zigzagEncode(value)) == value);
+
+    std::vector<char> buffer;
+    auto const encoded = mutation_map_codec::zigzagEncode(value);
+    mutation_map_codec::appendVarint(buffer, encoded);
+    const char* data = buffer.data();
+    assert(mutation_map_codec::readVarint(data, data + buffer.size()) ==
+           encoded);
+    assert(data == buffer.data() + buffer.size());
+  }
+
+  std::vector<MutationMapTranscriptRead> reads(3);
+  reads[0].begin = 10;
+  reads[0].end = 20;
+  reads[0].indices = {10, 15, 19};
+  reads[1].begin = 5;
+  reads[1].end = 6;
+  reads[2].begin = 100;
+  reads[2].end = 300;
+  reads[2].indices = {299};
+
+  std::vector<char> block;
+  mutation_map_codec::encodeBlock(block, std::begin(reads), std::end(reads));
+  mutation_map_codec::BlockDecoder decoder(block.data(), block.size());
+  assert(decoder.remainingReads() == reads.size());
+  for (auto&& read : reads) {
+    MutationMapTranscriptRead decoded;
+    decoder.decodeRead(decoded);
+    assert(decoded.begin == read.begin);
+    assert(decoded.end == read.end);
+    assert(decoded.indices == read.indices);
+  }
+  assert(decoder.finished());
+}
+
+static void
+convert(const std::string& source, const std::string& destination,
+        unsigned formatVersion, std::uint32_t blockReads) {
+  MutationMap mutationMap(source);
+  MutationMapWriter writer(destination, formatVersion, blockReads);
+  for (auto&& transcript : mutationMap)
+    writer.addTranscript(transcript);
+  writer.finish();
+}
+
+static void
+checkSameReads(const std::string& filename, const std::string& otherFilename,
+               bool memoryMapped) {
+  MutationMap mutationMap(filename);
+  MutationMap otherMutationMap(otherFilename, memoryMapped);
+
+  auto otherIter = ranges::begin(otherMutationMap);
+  for (auto&& transcript : mutationMap) {
+    assert(otherIter != ranges::end(otherMutationMap));
+    auto&& otherTranscript = *otherIter;
+    assert(transcript.getId() == otherTranscript.getId());
+    assert(transcript.getSequence() == otherTranscript.getSequence());
+    assert(transcript.getReadsSize() == otherTranscript.getReadsSize());
+
+    auto otherReadIter = ranges::begin(otherTranscript);
+    for (auto&& read : transcript) {
+      assert(otherReadIter != ranges::end(otherTranscript));
+      auto&& otherRead = *otherReadIter;
+      assert(read.begin == otherRead.begin);
+      assert(read.end == otherRead.end);
+      assert(read.indices == otherRead.indices);
+      ++otherReadIter;
+    }
+    assert(otherReadIter == ranges::end(otherTranscript));
+    ++otherIter;
+  }
+  assert(otherIter == ranges::end(otherMutationMap));
+}
+
+static void
+checkChunks(const std::string& filename, unsigned readsPerChunk) {
+  MutationMap mutationMap(filename);
+  MutationMap mappedMutationMap(filename, true);
+
+  auto mappedIter = ranges::begin(mappedMutationMap);
+  for (auto&& transcript : mutationMap) {
+    assert(mappedIter != ranges::end(mappedMutationMap));
+    auto&& mappedTranscript = *mappedIter;
+    auto const chunks = mappedTranscript.chunks(readsPerChunk);
+
+    std::vector<MutationMapTranscriptRead> reads;
+    for (auto&& chunk : chunks) {
+      assert(chunk.firstRead == reads.size());
+      mappedTranscript.forEachChunkRead(
+          chunk, [&](unsigned readIndex, auto&& read) {
+            assert(readIndex == reads.size());
+            reads.push_back({read.begin, read.end,
+                             std::vector<unsigned>(ranges::begin(read.indices),
+                                                   ranges::end(read.indices))});
+          });
+    }
+    assert(reads.size() == transcript.getReadsSize());
+
+    auto readIter = ranges::begin(reads);
+    for (auto&& read : transcript) {
+      assert(read.begin == readIter->begin);
+      assert(read.end == readIter->end);
+      assert(read.indices == readIter->indices);
+      ++readIter;
+    }
+
+    transcript.skip();
+    assert(mappedTranscript.getEndOffset() == transcript.getEndOffset());
+    ++mappedIter;
+  }
+  assert(mappedIter == ranges::end(mappedMutationMap));
+}
+
+static void
+checkIndexedChunks(const std::string& filename) {
+  MutationMap mutationMap(filename, true);
+  for (auto&& entry : mutationMap.getIndexEntries()) {
+    MutationMapTranscript scannedTranscript(mutationMap, entry.offset);
+    MutationMapTranscript indexedTranscript(mutationMap, entry);
+
+    for (unsigned readsPerChunk :
+         {MutationMapIndex::chunkReads, MutationMapIndex::chunkReads * 2}) {
+      auto const scannedChunks = scannedTranscript.chunks(readsPerChunk);
+      auto const indexedChunks = indexedTranscript.chunks(readsPerChunk);
+      assert(scannedChunks.size() == indexedChunks.size());
+      for (std::size_t index = 0; index < scannedChunks.size(); ++index) {
+        assert(scannedChunks[index].offset == indexedChunks[index].offset);
+        assert(scannedChunks[index].size == indexedChunks[index].size);
+        assert(scannedChunks[index].firstRead ==
+               indexedChunks[index].firstRead);
+        assert(scannedChunks[index].reads == indexedChunks[index].reads);
+      }
+      assert(scannedTranscript.getEndOffset() ==
+             indexedTranscript.getEndOffset());
+    }
+  }
+}
+
+static void
+checkFormatRoundtrip(const std::string& filename) {
+  const std::string compactFilename = filename + ".v2.mm";
+  const std::string restoredFilename = filename + ".v1.mm";
+
+  convert(filename, compactFilename, 2, 7);
+  {
+    MutationMap compactMutationMap(compactFilename);
+    assert(compactMutationMap.getFormatVersion() == 2);
+    assert(compactMutationMap.getBlockReads() == 7);
+  }
+  checkSameReads(filename, compactFilename, false);
+  checkSameReads(filename, compactFilename, true);
+  checkChunks(compactFilename, 7);
+  checkIndex(compactFilename);
+
+  convert(compactFilename, restoredFilename, 1,
+          mutation_map_codec::defaultBlockReads);
+  {
+    std::ifstream original(filename, std::ios::binary);
+    std::ifstream restored(restoredFilename, std::ios::binary);
+    assert(std::equal(std::istreambuf_iterator<char>(original),
+                      std::istreambuf_iterator<char>(),
+                      std::istreambuf_iterator<char>(restored),
+                      std::istreambuf_iterator<char>()));
+  }
+
+  for (auto&& name : {compactFilename, restoredFilename}) {
+    fs::remove(name);
+    fs::remove(name + "i.draco");
+  }
+}
+
+static void
+checkDuplicatedIds() {
+  const std::string filename =
+      (fs::temp_directory_path() / "draco_mutation_map_ids_test.mm").string();
+  const std::array<std::string, 4> ids{"dup", "other", "DUP", "Dup"};
+  {
+    std::ofstream stream(filename, std::ios::binary);
+    BinaryStream<std::ofstream> binaryStream(stream);
+    for (auto&& id : ids) {
+      binaryStream << static_cast<std::uint16_t>(id.size() + 1);
+      stream.write(id.data(), static_cast<std::streamsize>(id.size()));
+      stream.put('\0');
+      // "ACGT" without reads
+      binaryStream << static_cast<std::uint32_t>(4) << std::uint8_t(0x01)
+                   << std::uint8_t(0x23) << static_cast<std::uint32_t>(0);
+    }
+    for (auto c : MutationMap::eofMarker)
+      binaryStream << c;
+  }
+
+  MutationMap mutationMap(filename);
+  auto&& entries = mutationMap.getIndexEntries();
+  assert(entries.size() == ids.size());
+
+  auto const foundEntries = mutationMap.findIndexEntries("dUp");
+  assert(foundEntries.size() == 3);
+  assert(foundEntries[0] == &entries[0]);
+  assert(foundEntries[1] == &entries[2]);
+  assert(foundEntries[2] == &entries[3]);
+  assert(mutationMap.findIndexEntries("OTHER").size() == 1);
+
+  fs::remove(filename);
+  fs::remove(filename + "i.draco");
+}
+
+static std::string
+readFile(const std::string& filename) {
+  std::ifstream stream(filename, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(stream),
+                     std::istreambuf_iterator<char>());
+}
+
+static void
+checkLegacyIndex(const std::string& filename) {
+  const std::string legacyIndexFilename = filename + 'i';
+  const std::string indexFilename = filename + "i.draco";
+
+  {
+    MutationMap mutationMap(filename);
+    std::ofstream stream(legacyIndexFilename, std::ios::binary);
+    BinaryStream<std::ofstream> binaryStream(stream);
+    for (auto&& entry : mutationMap.getIndexEntries()) {
+      binaryStream << static_cast<std::uint16_t>(entry.transcriptId.size() +
+                                                 1);
+      stream.write(entry.transcriptId.data(),
+                   static_cast<std::streamsize>(entry.transcriptId.size()));
+      stream.put('\0');
+      binaryStream << static_cast<std::uint64_t>(
+          static_cast<std::streamoff>(entry.offset));
+    }
+  }
+  auto const legacyIndex = readFile(legacyIndexFilename);
+
+  // An up-to-date RNA Framework index is used as it is
+  fs::remove(indexFilename);
+  {
+    MutationMap mutationMap(filename);
+    assert(mutationMap.isIndexed());
+    assert(not fs::exists(indexFilename));
+  }
+
+  // A stale one is not replaced, the extended index is written aside
+  fs::last_write_time(legacyIndexFilename,
+                      fs::last_write_time(filename) - std::chrono::hours(1));
+  {
+    MutationMap mutationMap(filename);
+    assert(mutationMap.isIndexed());
+    assert(fs::exists(indexFilename));
+  }
+  assert(readFile(legacyIndexFilename) == legacyIndex);
+
+  fs::remove(legacyIndexFilename);
+}
+
+static void
+checkCorruptedRead(const std::string& filename) {
+  const std::string corruptedFilename = filename + ".corrupted.mm";
+  fs::copy_file(filename, corruptedFilename,
+                fs::copy_options::overwrite_existing);
+
+  std::streamoff readOffset;
+  {
+    MutationMap mutationMap(corruptedFilename);
+    auto&& transcript = *ranges::begin(mutationMap);
+    assert(transcript.getReadsSize() > 0);
+    readOffset = static_cast<std::streamoff>(transcript.getStartOffset());
+  }
+  /* The index is kept up to date, in order to reach the reads */
+  auto const writeTime = fs::last_write_time(corruptedFilename);
+  {
+    /* The number of mutations of the first read runs past the end of file */
+    std::fstream stream(corruptedFilename,
+                        std::ios::in | std::ios::out | std::ios::binary);
+    stream.seekp(readOffset + 8);
+    const char nIndices[] = {'\xff', '\xff', '\xff', '\x0f'};
+    stream.write(nIndices, sizeof(nIndices));
+  }
+  fs::last_write_time(corruptedFilename, writeTime);
+
+  MutationMap mutationMap(corruptedFilename, true);
+  auto&& transcript = *ranges::begin(mutationMap);
+  auto const throws = [](auto&& function) {
+    try {
+      function();
+    } catch (const std::runtime_error&) {
+      return true;
+    }
+    return false;
+  };
+  assert(throws([&] { ranges::begin(transcript.views()); }));
+  assert(throws([&] { transcript.chunks(7); }));
+
+  fs::remove(corruptedFilename);
+  fs::remove(corruptedFilename + "i.draco");
+}
+
+static void
+checkShortBlockTable(const std::string& filename) {
+  const std::string compactFilename = filename + ".short.mm";
+  convert(filename, compactFilename, 2, 7);
+
+  std::streamoff blocksOffset = -1;
+  {
+    MutationMap mutationMap(compactFilename);
+    for (auto&& transcript : mutationMap) {
+      if (transcript.getReadsSize() > 7) {
+        blocksOffset = static_cast<std::streamoff>(transcript.getStartOffset());
+        break;
+      }
+    }
+  }
+  assert(blocksOffset >= 0);
+  /* The index is kept up to date, in order to reach the blocks */
+  auto const writeTime = fs::last_write_time(compactFilename);
+  {
+    /* The last block of the transcript is dropped from the table */
+    std::fstream stream(compactFilename,
+                        std::ios::in | std::ios::out | std::ios::binary);
+    stream.seekg(blocksOffset);
+    std::uint32_t nBlocks;
+    BinaryStream<std::fstream> binaryStream(stream);
+    binaryStream >> nBlocks;
+    assert(nBlocks > 1);
+    stream.seekp(blocksOffset);
+    binaryStream << static_cast<std::uint32_t>(nBlocks - 1);
+  }
+  fs::last_write_time(compactFilename, writeTime);
+
+  MutationMap mutationMap(compactFilename, true);
+  for (auto&& transcript : mutationMap) {
+    if (transcript.getReadsSize() > 7) {
+      bool thrown = false;
+      try {
+        transcript.chunks(7);
+      } catch (const std::runtime_error&) {
+        thrown = true;
+      }
+      assert(thrown);
+      break;
+    }
+  }
+
+  fs::remove(compactFilename);
+  fs::remove(compactFilename + "i.draco");
+}
+
+int
+main(int argc, char* argv[]) {
+  assert(argc == 2);
+  const std::string filename =
+      (fs::temp_directory_path() / "draco_mutation_map_test.mm").string();
+  fs::copy_file(argv[1], filename, fs::copy_options::overwrite_existing);
+  fs::remove(filename + 'i');
+  fs::remove(filename + "i.draco");
+
+  MutationMap streamMutationMap(filename);
+  MutationMap mappedMutationMap(filename, true);
+  assert(not streamMutationMap.isMemoryMapped());
+  assert(mappedMutationMap.isMemoryMapped());
+
+  auto streamIter = ranges::begin(streamMutationMap);
+  auto mappedIter = ranges::begin(mappedMutationMap);
+  for (; streamIter != ranges::end(streamMutationMap);
+       ++streamIter, ++mappedIter) {
+    assert(mappedIter != ranges::end(mappedMutationMap));
+
+    auto&& streamTranscript = *streamIter;
+    auto&& mappedTranscript = *mappedIter;
+    assert(streamTranscript.getId() == mappedTranscript.getId());
+    assert(streamTranscript.getSequence() == mappedTranscript.getSequence());
+    assert(streamTranscript.getReadsSize() == mappedTranscript.getReadsSize());
+
+    auto views = mappedTranscript.views();
+    auto viewIter = ranges::begin(views);
+    unsigned readsCount = 0;
+    for (auto&& read : streamTranscript) {
+      assert(viewIter != ranges::end(views));
+      assert(read.begin == viewIter->begin);
+      assert(read.end == viewIter->end);
+      assert(ranges::equal(read.indices, viewIter->indices));
+
+      ++viewIter;
+      ++readsCount;
+    }
+    assert(viewIter == ranges::end(views));
+    assert(readsCount == mappedTranscript.getReadsSize());
+    assert(streamTranscript.getEndOffset() == mappedTranscript.getEndOffset());
+  }
+  assert(mappedIter == ranges::end(mappedMutationMap));
+
+  checkIndex(filename);
+  checkChunks(filename, 7);
+  checkIndexedChunks(filename);
+  checkCodec();
+  checkFormatRoundtrip(filename);
+  checkDuplicatedIds();
+  checkLegacyIndex(filename);
+  checkCorruptedRead(filename);
+  checkShortBlockTable(filename);
+
+  fs::remove(filename);
+  fs::remove(filename + "i.draco");
+}
@@ -0,0 +1,74 @@
+#include "null_model_library.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+
+static PerturbedEigengaps
+draw_samples(std::size_t n_samples, double shape, double scale,
+             std::mt19937& random_gen) {
+  PerturbedEigengaps samples(2);
+  for (auto& sample : samples) {
+    std::weibull_distribution<double> weibull_dist(shape, scale);
+    sample.resize(n_samples);
+    std::generate(std::begin(sample), std::end(sample),
+                  [&] { return weibull_dist(random_gen); });
+    shape *= 1.5;
+  }
+
+  return samples;
+}
+
+static void
+test_keys() {
+  auto const key = NullModelLibrary::makeKey(2, 100, 1000., 0.01);
+  auto const similar = NullModelLibrary::makeKey(2, 102, 1010., 0.0101);
+  auto const more_bases = NullModelLibrary::makeKey(2, 150, 1000., 0.01);
+  auto const more_eigengaps = NullModelLibrary::makeKey(3, 100, 1000., 0.01);
+
+  assert(not(key < similar) and not(similar < key));
+  assert(key < more_bases or more_bases < key);
+  assert(key < more_eigengaps);
+}
+
+static void
+test_library() {
+  std::mt19937 random_gen(42);
+  NullModelLibrary library;
+  auto const key = NullModelLibrary::makeKey(2, 100, 1000., 0.01);
+
+  assert(not library.find(key, 0));
+  library.add(key, draw_samples(60, 2., 0.5, random_gen), 100);
+  assert(not library.find(key, 100));
+  library.add(key, draw_samples(60, 2., 0.5, random_gen), 100);
+
+  auto const entry = library.find(key, 100);
+  assert(entry);
+  assert(entry->samples.size() == 2);
+  assert(entry->samples[0].size() == 100 and entry->samples[1].size() == 100);
+  assert(entry->params.size() == 2);
+  assert(std::abs(entry->params[0].shape - 2.) < 0.6);
+  assert(std::abs(entry->params[1].shape - 3.) < 0.9);
+
+  // The quantiles of the null models follow them
+  PerturbedEigengaps quantiles(2, PerturbedEigengap(10));
+  for (std::size_t index = 0; index < 2; ++index) {
+    auto const& params = entry->params[index];
+    for (std::size_t rank = 0; rank < 10; ++rank) {
+      double const probability = (static_cast<double>(rank) + 0.5) / 10.;
+      quantiles[index][rank] =
+          params.scale *
+          std::pow(-std::log(1. - probability), 1. / params.shape);
+    }
+  }
+  assert(NullModelLibrary::confirms(*entry, quantiles));
+  assert(not NullModelLibrary::confirms(*entry,
+                                        draw_samples(10, 2., 2., random_gen)));
+}
+
+int
+main() {
+  test_keys();
+  test_library();
+}
@@ -0,0 +1,120 @@
+#include "permutation_batches.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using Value = std::mt19937::result_type;
+
+static constexpr unsigned maxPermutations = 20;
+static constexpr std::mt19937::result_type seed = 42;
+
+/* The first value of each permutation, in the order the batches seed them */
+static std::vector<Value>
+expectedValues() {
+  std::mt19937 generator(seed);
+  std::vector<Value> values(maxPermutations);
+  for (auto& value : values) {
+    std::mt19937 drawGenerator(generator());
+    value = drawGenerator();
+  }
+  return values;
+}
+
+static void
+checkSingleThread() {
+  std::mt19937 generator(seed);
+  std::mt19937 expectedGenerator(seed);
+  PermutationBatches<Value> batches(1);
+  for (unsigned permutation = 0; permutation < maxPermutations;
+       ++permutation) {
+    auto const value =
+        batches.next(generator, maxPermutations - permutation,
+                     [](std::mt19937& generator) { return generator(); });
+    assert(value == expectedGenerator());
+  }
+}
+
+static void
+checkOrder(unsigned threads) {
+  auto const expected = expectedValues();
+  std::mt19937 generator(seed);
+  PermutationBatches<Value> batches(threads);
+  std::atomic<unsigned> draws = 0;
+  for (unsigned permutation = 0; permutation < maxPermutations; ++permutation) {
+    auto const value = batches.next(generator, maxPermutations - permutation,
+                                    [&](std::mt19937& generator) {
+                                      ++draws;
+                                      return generator();
+                                    });
+    assert(value == expected[permutation]);
+    // The batches never draw past the last permutation
+    assert(draws <= maxPermutations);
+    assert(draws < permutation + 1 + threads);
+  }
+  assert(draws == maxPermutations);
+}
+
+static void
+checkStop(unsigned threads) {
+  auto const expected = expectedValues();
+  std::mt19937 generator(seed);
+  PermutationBatches<Value> batches(threads);
+  std::atomic<unsigned> draws = 0;
+
+  // The caller stops after 5 permutations, the rest of the batch is dropped
+  for (unsigned permutation = 0; permutation < 5; ++permutation) {
+    auto const value = batches.next(generator, maxPermutations - permutation,
+                                    [&](std::mt19937& generator) {
+                                      ++draws;
+                                      return generator();
+                                    });
+    assert(value == expected[permutation]);
+  }
+  assert(draws == std::min(((5 + threads - 1) / threads) * threads,
+                           maxPermutations));
+}
+
+static void
+checkException(unsigned threads, unsigned failingPermutation) {
+  auto const expected = expectedValues();
+  std::mt19937 generator(seed);
+  PermutationBatches<Value> batches(threads);
+  auto const draw = [&](std::mt19937& generator) {
+    auto const value = generator();
+    if (value == expected[failingPermutation])
+      throw std::runtime_error("draw failed");
+    return value;
+  };
+
+  // The permutations before the failing one are still handed out
+  for (unsigned permutation = 0; permutation < failingPermutation;
+       ++permutation) {
+    auto const value =
+        batches.next(generator, maxPermutations - permutation, draw);
+    assert(value == expected[permutation]);
+  }
+
+  bool thrown = false;
+  try {
+    batches.next(generator, maxPermutations - failingPermutation, draw);
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+int
+main() {
+  checkSingleThread();
+  for (unsigned threads : {2u, 3u, 8u, 32u}) {
+    checkOrder(threads);
+    checkStop(threads);
+    checkException(threads, 0);
+    checkException(threads, threads / 2);
+    checkException(threads, std::min(threads + 1, maxPermutations - 1));
+  }
+}
@@ -0,0 +1,196 @@
+#include "args.hpp"
+#include "ptba.hpp"
+#include "ptba_cache.hpp"
+#include "ringmap_data.hpp"
+#include "ringmap_matrix_row.hpp"
+#include "ringmap_window_view.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#if __has_include(<filesystem>)
+#include <filesystem>
+namespace fs = std::filesystem;
+#elif __has_include(<experimental/filesystem>)
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#else
+#error "Missing filesystem header"
+#endif
+
+constexpr unsigned sequence_length = 60;
+constexpr unsigned read_size = 40;
+
+static RingmapData
+make_ringmap_data() {
+  RingmapData ringmap_data;
+  std::string sequence(sequence_length, 'N');
+  for (unsigned base = 0; base < sequence_length; ++base)
+    sequence[base] = "ACGT"[base % 4];
+
+  test::RingmapData::m_data(ringmap_data) = RingmapMatrix(sequence_length);
+  test::RingmapData::sequence(ringmap_data) = sequence;
+  test::RingmapData::startIndex(ringmap_data) = 0;
+  test::RingmapData::endIndex(ringmap_data) = sequence_length;
+  test::RingmapData::nSetReads(ringmap_data) = sequence_length;
+
+  for (unsigned read = 0; read < 30; ++read) {
+    RingmapMatrixRow row;
+    row.begin_index = read % (sequence_length - read_size);
+    row.end_index = row.begin_index + read_size;
+    row.multiplicity = 1 + read % 3;
+    for (unsigned base = row.begin_index + read % 4; base < row.end_index;
+         base += 4 + read % 5)
+      row.push_back(base);
+    test::RingmapData::m_data(ringmap_data).addModifiedIndicesRow(row);
+  }
+
+  return ringmap_data;
+}
+
+static Args
+make_args(std::string max_permutations) {
+  // The mutation map is mandatory, but it is never read by the cache
+  std::string program = "ptba_cache";
+  std::string mm_parameter = "--mm";
+  std::string mm_filename = "unused.mm";
+  std::string parameter = "--maxPermutations";
+  std::array<char*, 5> argv{program.data(), mm_parameter.data(),
+                            mm_filename.data(), parameter.data(),
+                            max_permutations.data()};
+  return Args(static_cast<int>(argv.size()), argv.data());
+}
+
+static PtbaResult
+make_result() {
+  PtbaResult result;
+  result.nClusters = 2;
+  result.eigenGaps = arma::vec{0.5, 0.25, 0.125};
+  result.perturbedEigenGaps = PerturbedEigengaps(2);
+  result.perturbedEigenGaps[0] = {0.1, 0.2, 0.3};
+  result.perturbedEigenGaps[1] = {0.4, 0.5, 0.6};
+  result.significantIndices = {0, 1};
+  result.permutations = 42;
+  result.savedPermutations = 300;
+  result.libraryPermutations = 58;
+  return result;
+}
+
+static std::vector<fs::path>
+directory_entries(fs::path const& directory) {
+  std::vector<fs::path> entries;
+  for (auto&& entry : fs::directory_iterator(directory))
+    entries.push_back(entry.path());
+  std::sort(std::begin(entries), std::end(entries));
+  return entries;
+}
+
+static void
+check_round_trip(fs::path const& directory, RingmapData const& ringmap_data) {
+  PtbaCache const cache(directory.string(), make_args("400"));
+  RingmapWindowView const window(ringmap_data, 10, 40);
+
+  assert(not cache.load(window));
+  assert(cache.misses() == 1);
+
+  auto const result = make_result();
+  cache.store(window, result);
+  auto const entries = directory_entries(directory);
+  assert(entries.size() == 1);
+  assert(entries[0].extension() == ".ptba");
+
+  auto const loaded = cache.load(window);
+  assert(loaded);
+  assert(cache.hits() == 1);
+  assert(loaded->nClusters == result.nClusters);
+  assert(arma::approx_equal(loaded->eigenGaps, result.eigenGaps, "absdiff",
+                            0.));
+  assert(loaded->perturbedEigenGaps.size() == result.perturbedEigenGaps.size());
+  for (std::size_t index = 0; index < result.perturbedEigenGaps.size();
+       ++index)
+    assert(loaded->perturbedEigenGaps[index] ==
+           result.perturbedEigenGaps[index]);
+  assert(loaded->significantIndices == result.significantIndices);
+  assert(loaded->permutations == result.permutations);
+  assert(loaded->savedPermutations == result.savedPermutations);
+  assert(loaded->libraryPermutations == result.libraryPermutations);
+
+  // A loaded result only keeps the data used after the analysis
+  assert(loaded->eigenVecs.empty());
+  assert(loaded->adjacency.empty());
+  assert(loaded->filteredToUnfilteredBases.empty());
+}
+
+static void
+check_key_mismatch(fs::path const& directory, RingmapData const& ringmap_data) {
+  PtbaCache const cache(directory.string(), make_args("400"));
+  RingmapWindowView const window(ringmap_data, 10, 40);
+  RingmapWindowView const other_window(ringmap_data, 11, 41);
+  assert(cache.load(window));
+
+  // Another window or other arguments use other entries
+  assert(not cache.load(other_window));
+  PtbaCache const other_cache(directory.string(), make_args("200"));
+  assert(not other_cache.load(window));
+
+  // An entry under the name of another key is not used
+  auto const entries_before = directory_entries(directory);
+  cache.store(other_window, make_result());
+  auto const entries = directory_entries(directory);
+  assert(entries.size() == 2);
+  auto const other_entry =
+      std::find_if(std::begin(entries), std::end(entries), [&](auto&& entry) {
+        return entry != entries_before[0];
+      });
+  assert(other_entry != std::end(entries));
+  assert(cache.load(other_window));
+
+  fs::copy_file(entries_before[0], *other_entry,
+                fs::copy_options::overwrite_existing);
+  assert(not cache.load(other_window));
+  assert(cache.load(window));
+}
+
+static void
+check_store_failure(fs::path const& directory,
+                    RingmapData const& ringmap_data) {
+  fs::remove_all(directory);
+  PtbaCache const cache(directory.string(), make_args("400"));
+  RingmapWindowView const window(ringmap_data, 10, 40);
+  cache.store(window, make_result());
+  auto const entries = directory_entries(directory);
+  assert(entries.size() == 1);
+
+  // A non-empty directory in place of the entry cannot be renamed over
+  fs::remove(entries[0]);
+  fs::create_directory(entries[0]);
+  std::ofstream(entries[0] / "blocker").put('\n');
+
+  cache.store(window, make_result());
+  assert(fs::is_directory(entries[0]));
+  // The temporary file is removed
+  assert(directory_entries(directory) == entries);
+  assert(not cache.load(window));
+}
+
+int
+main() {
+  auto const directory =
+      fs::temp_directory_path() /
+      ("draco_ptba_cache_test_" + std::to_string(::getpid()));
+  fs::remove_all(directory);
+
+  auto const ringmap_data = make_ringmap_data();
+  check_round_trip(directory, ringmap_data);
+  check_key_mismatch(directory, ringmap_data);
+  check_store_failure(directory, ringmap_data);
+
+  fs::remove_all(directory);
+}
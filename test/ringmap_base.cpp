@@ -1,7 +1,10 @@
 #include <ringmap_data.hpp>
 #include <ringmap_matrix.hpp>
+#include <ringmap_matrix_comutations.hpp>
+#include <ringmap_matrix_csr.hpp>
 #include <tokenizer_iterator.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <string>
 #include <cassert>
@@ -112,4 +115,112 @@ int main(int argc, const char* argv[])
                 assert(transposed(row, col) == armaTransposed(row, col));
         }
     }
+
+    /* CSR layout check */
+    {
+        RingmapMatrixCsr csr(matrix);
+        assert(csr.rows_size() == matrix.rows_size());
+        assert(csr.cols_size() == matrix.cols_size());
+        for(unsigned row = 0; row < matrix.rows_size(); ++row)
+        {
+            auto&& indices = matrix.getIndices(row);
+            auto csrRow = csr.row(row);
+            assert(std::equal(csrRow.begin(), csrRow.end(), indices.begin(), indices.end()));
+            assert(csr.begin_index(row) == indices.begin_index);
+            assert(csr.end_index(row) == indices.end_index);
+        }
+
+        auto transposed = matrix.t();
+        auto csrTransposed = csr.t();
+        assert(csrTransposed.rows_size() == matrix.cols_size());
+        for(unsigned row = 0; row < csrTransposed.rows_size(); ++row)
+        {
+            auto&& indices = transposed.getIndices(row);
+            auto csrRow = csrTransposed.row(row);
+            assert(std::equal(csrRow.begin(), csrRow.end(), indices.begin(), indices.end()));
+        }
+    }
+
+    /* Co-mutation kernels check */
+    {
+        RingmapMatrixCsr csr(matrix);
+        auto csrTransposed = csr.t();
+        std::vector<bool> usedBases(matrix.cols_size(), true);
+        for(unsigned base = 0; base < usedBases.size(); base += 3)
+            usedBases[base] = false;
+
+        auto sparse = ringmap_matrix::sparseComutations(csr, csrTransposed, usedBases);
+        auto bitset = ringmap_matrix::bitsetComutations(csr, csrTransposed, usedBases);
+        assert(arma::approx_equal(sparse, bitset, "absdiff", 0));
+        for(unsigned base = 0; base < usedBases.size(); ++base)
+        {
+            if(usedBases[base])
+                assert(sparse(base, base) == static_cast<double>(csrTransposed.row(base).size()));
+            else
+            {
+                for(unsigned other = 0; other < usedBases.size(); ++other)
+                    assert(sparse(base, other) == 0 and sparse(other, base) == 0);
+            }
+        }
+
+        std::vector<double> weights(matrix.cols_size());
+        for(unsigned base = 0; base < weights.size(); ++base)
+            weights[base] = usedBases[base] ? 1. / (1 + base % 5) : 0.;
+
+        using ringmap_matrix::CovarianceKernel;
+        auto expected = matrix.covariance(weights, CovarianceKernel::sparse);
+        assert(arma::approx_equal(matrix.covariance(weights, CovarianceKernel::bitset), expected, "absdiff", 1e-9));
+        assert(arma::approx_equal(matrix.covariance(weights, CovarianceKernel::gemm), expected, "absdiff", 1e-9));
+
+        auto collapsed = matrix;
+        collapsed.collapseDuplicateRows();
+        assert(arma::approx_equal(collapsed.covariance(weights, CovarianceKernel::gemm), expected, "absdiff", 1e-9));
+    }
+
+    /* Collapsed duplicate rows check */
+    {
+        auto duplicated = matrix;
+        duplicated.append(matrix);
+        auto collapsed = duplicated;
+        collapsed.collapseDuplicateRows();
+
+        assert(collapsed.rows_size() <= matrix.rows_size());
+        assert(collapsed.totalReads() == duplicated.rows_size());
+        assert(collapsed.hasMultiplicities());
+        assert(arma::approx_equal(collapsed.sum(), duplicated.sum(), "absdiff", 1e-9));
+        assert(arma::approx_equal(collapsed.mean(), duplicated.mean(), "absdiff", 1e-9));
+        assert(arma::approx_equal(collapsed.covariance(), duplicated.covariance(), "absdiff", 1e-9));
+
+        unsigned colIndex = 0;
+        for(auto&& col : collapsed.cols())
+            assert(col.sum() == duplicated.col(colIndex++).sum());
+
+        auto sharedCollapsed = collapsed;
+        collapsed.expandDuplicateRows();
+        assert(not collapsed.hasMultiplicities());
+        assert(collapsed.rows_size() == duplicated.rows_size());
+        assert(arma::approx_equal(collapsed.covariance(), duplicated.covariance(), "absdiff", 1e-9));
+        assert(sharedCollapsed.hasMultiplicities());
+        assert(sharedCollapsed.totalReads() == duplicated.rows_size());
+    }
+
+    /* Copy-on-write rows check */
+    {
+        auto copy = matrix;
+        assert(copy == matrix);
+        copy.remove_rows(0, 1);
+        assert(copy.rows_size() + 1 == matrix.rows_size());
+
+        auto perturbed = ringmapData;
+        perturbed.perturb();
+        assert(arma::approx_equal(perturbed.data().sum(), matrix.sum(), "absdiff", 0));
+
+        auto filtered = ringmapData;
+        filtered.filter();
+        for(unsigned row = 0; row < matrix.rows_size(); ++row)
+        {
+            for(unsigned col = 0; col < matrix.cols_size(); ++col)
+                assert(matrix(row, col) == armaMatrix(row, col));
+        }
+    }
 }
@@ -1,6 +1,10 @@
+#include "ringmap_column_permutations.hpp"
 #include "ringmap_data.hpp"
 #include "ringmap_matrix_row.hpp"
+#include "ringmap_sliding_comutations.hpp"
+#include "ringmap_window_view.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <random>
@@ -276,9 +280,150 @@ test_window_covariance() {
   }
 }
 
+static void
+test_sliding_comutations() {
+  auto ringmap_data = std::get<1>(generate_random_ringmap());
+  RingmapSlidingComutations comutations(ringmap_data.data(), window_size);
+
+  std::vector<unsigned> start_bases;
+  for (unsigned start_base = 0; start_base < sequence_length - window_size;
+       start_base += 7)
+    start_bases.push_back(start_base);
+  // Moving backwards and jumping past the window rebuild the counts
+  start_bases.push_back(3);
+  start_bases.push_back(3 + window_size);
+
+  for (auto start_base : start_bases) {
+    comutations.slideTo(start_base);
+    auto const ringmap_window =
+        ringmap_data.get_new_range(start_base, start_base + window_size);
+    assert(comutations.windowReads() == ringmap_window.data().rows_size());
+    assert(arma::approx_equal(comutations.counts(),
+                              ringmap_window.data().covariance(), "absdiff",
+                              1e-9));
+
+    auto filtered_window = ringmap_window;
+    filtered_window.filterBases();
+    filtered_window.filterReads();
+    filtered_window.filterBases();
+    assert(arma::approx_equal(
+        comutations.covariance(ringmap_window, filtered_window),
+        filtered_window.data().covariance(filtered_window.getBaseWeights()),
+        "absdiff", 1e-9));
+  }
+}
+
+static void
+test_interval_index() {
+  auto ringmap_data = std::get<1>(generate_random_ringmap());
+  RingmapMatrixIntervalIndex const reads_index(ringmap_data.data());
+  assert(reads_index.rows_size() == ringmap_data.data().rows_size());
+
+  for (unsigned start_base = 0; start_base < sequence_length - window_size;
+       start_base += 9) {
+    unsigned const end_base = start_base + window_size;
+    std::vector<unsigned> scanned_reads;
+    std::vector<unsigned> indexed_reads;
+    auto const scanned =
+        ringmap_data.get_new_range(start_base, end_base, &scanned_reads);
+    auto const indexed = ringmap_data.get_new_range(start_base, end_base,
+                                                    reads_index, &indexed_reads);
+
+    assert(scanned_reads == indexed_reads);
+    assert(scanned.data() == indexed.data());
+    assert(scanned.getBaseCoverages() == indexed.getBaseCoverages());
+  }
+
+  assert(reads_index.coveringRows(0, sequence_length + 1).empty());
+}
+
+static void
+test_window_view() {
+  auto ringmap_data = std::get<1>(generate_random_ringmap());
+  RingmapMatrixIntervalIndex const reads_index(ringmap_data.data());
+  RingmapSlidingComutations comutations(ringmap_data.data(), window_size);
+
+  for (unsigned start_base = 0; start_base < sequence_length - window_size;
+       start_base += 11) {
+    unsigned const end_base = start_base + window_size;
+    std::vector<unsigned> window_reads;
+    auto const ringmap_window =
+        ringmap_data.get_new_range(start_base, end_base, &window_reads);
+    RingmapWindowView window_view(ringmap_data, start_base, end_base,
+                                  reads_index);
+    assert(window_view.getReadsIndices() == window_reads);
+    assert(window_view.getBaseCoverages() == ringmap_window.getBaseCoverages());
+
+    auto filtered_window = ringmap_window;
+    filtered_window.filterBases();
+    filtered_window.filterReads();
+    filtered_window.filterBases();
+    window_view.filterBases();
+    window_view.filterReads();
+    window_view.filterBases();
+
+    assert(window_view.filteredRowsSize() ==
+           filtered_window.data().rows_size());
+    std::vector<unsigned> filtered_bases;
+    for (auto [filtered_index, window_index] :
+         filtered_window.getFilteredToNonFilteredMap())
+      filtered_bases.push_back(window_index);
+    assert(window_view.getFilteredBases() == filtered_bases);
+
+    auto const expected =
+        filtered_window.data().covariance(filtered_window.getBaseWeights());
+    assert(arma::approx_equal(window_view.covariance(), expected, "absdiff",
+                              1e-9));
+
+    comutations.slideTo(start_base);
+    assert(arma::approx_equal(comutations.covariance(window_view), expected,
+                              "absdiff", 1e-9));
+  }
+}
+
+static void
+test_column_permutations() {
+  auto const ringmap_data = std::get<1>(generate_random_ringmap());
+  auto initial_data = ringmap_data.get_new_range(50, 50 + window_size);
+  initial_data.filterBases();
+  RingmapColumnPermutations permutations(initial_data);
+  assert(permutations.cols_size() == initial_data.data().cols_size());
+
+  auto const seed = std::random_device{}();
+  std::mt19937 data_random_gen(seed);
+  std::mt19937 permutations_random_gen(seed);
+  for (unsigned permutation = 0; permutation < 5; ++permutation) {
+    auto perturbed_data = initial_data;
+    perturbed_data.perturb(data_random_gen);
+    perturbed_data.filterBases();
+    perturbed_data.filterReads();
+    permutations.perturb(permutations_random_gen);
+
+    assert(permutations.filteredReads() == perturbed_data.size());
+    auto const expected = RingmapMatrixCsr(perturbed_data.data()).t();
+    auto const& transposed = permutations.transposed();
+    assert(transposed.rows_size() == expected.rows_size());
+    for (unsigned base = 0; base < expected.rows_size(); ++base) {
+      auto const expected_row = expected.row(base);
+      auto const row = transposed.row(base);
+      assert(std::equal(std::begin(row), std::end(row),
+                        std::begin(expected_row), std::end(expected_row)));
+    }
+
+    assert(arma::approx_equal(
+        permutations.covariance(),
+        perturbed_data.data().covariance(perturbed_data.getBaseWeights()),
+        "absdiff", 1e-9));
+  }
+}
+
 int
 main() {
   test_get_window();
   test_filter_window();
   test_window_covariance();
+  test_sliding_comutations();
+  test_interval_index();
+  test_window_view();
+  test_column_permutations();
 }
@@ -0,0 +1,51 @@
+#include "sequential_test.hpp"
+
+#include <cassert>
+#include <cstddef>
+
+static void
+test_extremes() {
+  PerturbedEigengap const null_model{0.1, 0.2, 0.2, 0.3, 0.5};
+
+  assert(sequential_test::extremes(null_model, 0.2, true) == 3);
+  assert(sequential_test::extremes(null_model, 0.2, false) == 4);
+  assert(sequential_test::extremes(null_model, 0.05, true) == 0);
+  assert(sequential_test::extremes(null_model, 0.6, false) == 0);
+  assert(sequential_test::extremes({}, 0.2, false) == 0);
+}
+
+static void
+test_settled() {
+  // (3 + 1) / 401 can still go below 0.01, (4 + 1) / 401 cannot
+  assert(not sequential_test::settledNonSignificant(3, 400, 0.01));
+  assert(sequential_test::settledNonSignificant(4, 400, 0.01));
+  assert(sequential_test::settledNonSignificant(5, 400, 0.01));
+  assert(not sequential_test::settledNonSignificant(1, 400, 0.005));
+  assert(sequential_test::settledNonSignificant(2, 400, 0.005));
+}
+
+/* Once settled, the final Monte Carlo p-value is never below the level, and
+ * the rule settles as soon as it is the case for every remaining draw */
+static void
+test_final_pvalue() {
+  for (unsigned max_permutations : {8u, 50u, 400u, 1000u}) {
+    for (double level : {0.005, 0.01, 0.05, 0.2}) {
+      for (std::size_t extremes = 0; extremes <= max_permutations;
+           ++extremes) {
+        double const lowest_pvalue =
+            (static_cast<double>(extremes) + 1.) /
+            (static_cast<double>(max_permutations) + 1.);
+        assert(sequential_test::settledNonSignificant(
+                   extremes, max_permutations, level) ==
+               (lowest_pvalue >= level));
+      }
+    }
+  }
+}
+
+int
+main() {
+  test_extremes();
+  test_settled();
+  test_final_pvalue();
+}
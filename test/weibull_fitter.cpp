@@ -4,7 +4,10 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <numeric>
 #include <random>
+#include <vector>
 
 #include <boost/math/distributions/weibull.hpp>
 
@@ -75,6 +78,71 @@ test_with_params(double shape, double scale) {
   check_result();
 }
 
+static void
+test_maximum_likelihood(double shape, double scale) {
+  constexpr std::size_t n_data = 500;
+
+  std::mt19937 random_gen(42);
+  std::weibull_distribution<double> weibull_dist(shape, scale);
+
+  PerturbedEigengap data(n_data);
+  std::generate(std::begin(data), std::end(data),
+                [&] { return weibull_dist(random_gen); });
+
+  WeibullFitter fitter(data);
+  auto const result = fitter.fit();
+  assert(result.shape >= WeibullFitter::min_shape);
+
+  auto const log_likelihood = [&](double fit_shape, double fit_scale) {
+    return std::accumulate(
+        std::begin(data), std::end(data), 0., [&](double acc, double x) {
+          return acc + std::log(fit_shape / fit_scale) +
+                 (fit_shape - 1.) * std::log(x / fit_scale) -
+                 std::pow(x / fit_scale, fit_shape);
+        });
+  };
+
+  // No better parameters around the fitted ones
+  double const fitted = log_likelihood(result.shape, result.scale);
+  for (double shape_delta : {-1e-3, 0., 1e-3}) {
+    for (double scale_factor : {1. - 1e-4, 1., 1. + 1e-4}) {
+      double const other_shape = result.shape + shape_delta;
+      if (other_shape < WeibullFitter::min_shape)
+        continue;
+      assert(log_likelihood(other_shape, result.scale * scale_factor) <=
+             fitted + 1e-9);
+    }
+  }
+}
+
+static void
+test_cdf(double shape, double scale) {
+  WeibullParams const params{shape, scale};
+  boost::math::weibull_distribution<double> distribution(params.shape,
+                                                         params.scale);
+
+  // From 0 to far in the tail, with every length of the last partial vector
+  std::mt19937 random_gen(42);
+  std::uniform_real_distribution<double> exponent_dist(-30., 6.);
+  for (std::size_t size = 0; size < 1000; size += (size < 20 ? 1 : 97)) {
+    std::vector<double> values(size);
+    for (auto& value : values)
+      value = scale * std::exp2(exponent_dist(random_gen));
+    if (size > 0)
+      values[0] = 0.;
+
+    std::vector<double> cdf(values.size());
+    weibull_cdf(params, values.data(), cdf.data(), values.size());
+
+    for (std::size_t index = 0; index < values.size(); ++index) {
+      double const expected = boost::math::cdf(distribution, values[index]);
+      assert(std::abs(cdf[index] - expected) < 1e-14);
+    }
+    if (size > 0)
+      assert(cdf[0] == 0.);
+  }
+}
+
 int
 main() {
   test_pdf_log_likelihood(1.42, 0.8);
@@ -90,4 +158,14 @@ main() {
   test_with_params(3.5, 2.5);
   test_with_params(1.2, 0.00008);
   test_with_params(3.5, 0.00008);
+
+  test_maximum_likelihood(1.42, 0.8);
+  test_maximum_likelihood(12., 1.5);
+  // The shape is constrained
+  test_maximum_likelihood(0.6, 1.);
+
+  test_cdf(1.42, 0.8);
+  test_cdf(0.3, 2.5);
+  test_cdf(3.5, 0.00008);
+  test_cdf(30., 1.5);
 }